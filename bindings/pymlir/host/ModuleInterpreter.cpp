@@ -8,18 +8,278 @@
 //===----------------------------------------------------------------------===//
 
 #include "ModuleInterpreter.h"
+#include "cnpy.h"
 #include "progressbar.hpp"
+#include "tpu_mlir/Interfaces/FlopsInterface.h"
 #include "tpu_mlir/Support/Float8.h"
 #include "tpu_mlir/Support/GmemAllocator.h"
 #include "tpu_mlir/Support/MathUtils.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/SaveAndRestore.h"
+#include "omp.h"
 #include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
 #define DEBUG_TYPE "interpreter"
 
 static const int64_t MAX_COUNT_LIMIT = 0x100000000ll;
+// tensors queued for writing by invoke_to_disk before compute waits
+static const size_t SPILL_PENDING_BYTES = 1ull << 30;
+// in elements, keeps arena tensors 64 bytes aligned
+static const int64_t ARENA_ALIGNMENT = 16;
+// calls kept for the trace of a profile, totals go on after it
+static const size_t MAX_TRACE_EVENTS = 1 << 22;
 namespace tpu_mlir {
 using namespace tpu;
+
+// appends tensors to an npz from a background thread, so that writing one
+// overlaps with computing the next ones
+class SpillWriter {
+public:
+  using express_fn = std::function<void(std::vector<float> &)>;
+
+  SpillWriter(const std::string &filename, size_t max_pending_bytes)
+      : stream(filename), max_pending_bytes(max_pending_bytes) {
+    worker = std::thread([this] { run(); });
+  }
+
+  ~SpillWriter() {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      done = true;
+    }
+    cv.notify_all();
+    worker.join();
+    stream.close();
+  }
+
+  // data is released once written; express, if any, converts it first
+  void push(std::string name, std::shared_ptr<std::vector<float>> data,
+            std::vector<size_t> shape, express_fn express) {
+    size_t bytes = data->size() * sizeof(float);
+    // checked here, the writer thread can't report it; a page is left for
+    // the npy header
+    if (bytes > cnpy::npz_stream::max_entry_bytes - 4096) {
+      llvm::errs() << "Can't write " << name << " to disk, " << bytes
+                   << " bytes is over the npz entry limit of 4GiB\n";
+      llvm_unreachable("Error, invoke_to_disk failed");
+    }
+    std::unique_lock<std::mutex> lock(mtx);
+    cv.wait(lock, [&] {
+      return pending_bytes == 0 || pending_bytes + bytes <= max_pending_bytes;
+    });
+    pending_bytes += bytes;
+    jobs.push_back(
+        {std::move(name), std::move(data), std::move(shape), std::move(express)});
+    cv.notify_all();
+  }
+
+private:
+  struct Job {
+    std::string name;
+    std::shared_ptr<std::vector<float>> data;
+    std::vector<size_t> shape;
+    express_fn express;
+  };
+
+  void run() {
+    while (true) {
+      Job job;
+      {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, [&] { return done || !jobs.empty(); });
+        if (jobs.empty()) {
+          return;
+        }
+        job = std::move(jobs.front());
+        jobs.pop_front();
+      }
+      if (job.express) {
+        job.express(*job.data);
+      }
+      stream.add(job.name, job.data->data(), job.shape);
+      size_t bytes = job.data->size() * sizeof(float);
+      job.data.reset();
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        pending_bytes -= bytes;
+      }
+      cv.notify_all();
+    }
+  }
+
+  cnpy::npz_stream stream;
+  size_t max_pending_bytes;
+  size_t pending_bytes = 0;
+  bool done = false;
+  std::deque<Job> jobs;
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::thread worker;
+};
+
+// times InferenceInterface calls; ops of invoke_parallel record from
+// several threads
+class OpProfiler {
+public:
+  enum Phase { INIT = 0, INFERENCE = 1, DEINIT = 2 };
+  using clock = std::chrono::steady_clock;
+
+  OpProfiler() : start(clock::now()) {}
+
+  void record(Operation *op, Phase phase, clock::time_point begin,
+              clock::time_point end) {
+    using us = std::chrono::duration<double, std::micro>;
+    double ts = us(begin - start).count();
+    double dur = us(end - begin).count();
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = op_index.find(op);
+    if (it == op_index.end()) {
+      it = op_index.emplace(op, stats.size()).first;
+      stats.push_back(describe(op));
+    }
+    auto &stat = stats[it->second];
+    switch (phase) {
+    case INIT:
+      stat.num_init++;
+      stat.init_us += dur;
+      break;
+    case INFERENCE:
+      stat.num_inference++;
+      stat.inference_us += dur;
+      break;
+    case DEINIT:
+      stat.num_deinit++;
+      stat.deinit_us += dur;
+      break;
+    }
+    if (events.size() < MAX_TRACE_EVENTS) {
+      auto tid = threads.emplace(std::this_thread::get_id(), threads.size());
+      events.push_back({it->second, phase, tid.first->second, ts, dur});
+    }
+  }
+
+  std::vector<OpProfile> get() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return stats;
+  }
+
+  LogicalResult dump_trace(const std::string &filename) {
+    static const char *phase_names[] = {"init", "inference", "deinit"};
+    std::error_code ec;
+    llvm::raw_fd_ostream os(filename, ec);
+    if (ec) {
+      llvm::errs() << "Can't open " << filename << ": " << ec.message()
+                   << "\n";
+      return failure();
+    }
+    std::lock_guard<std::mutex> lock(mtx);
+    llvm::json::OStream json(os);
+    json.object([&] {
+      json.attributeArray("traceEvents", [&] {
+        for (auto &e : events) {
+          auto &stat = stats[e.index];
+          json.object([&] {
+            json.attribute("name", stat.name);
+            json.attribute("cat", phase_names[e.phase]);
+            json.attribute("ph", "X");
+            json.attribute("ts", e.ts);
+            json.attribute("dur", e.dur);
+            json.attribute("pid", 0);
+            json.attribute("tid", e.tid);
+            json.attributeObject("args", [&] {
+              json.attribute("type", stat.type);
+              if (e.phase == INFERENCE) {
+                json.attribute("flops", stat.flops);
+                json.attribute("bytes_in", stat.bytes_in);
+                json.attribute("bytes_out", stat.bytes_out);
+              }
+            });
+          });
+        }
+      });
+      json.attribute("displayTimeUnit", "ms");
+    });
+    return success();
+  }
+
+private:
+  struct Event {
+    int index;
+    Phase phase;
+    int tid;
+    double ts, dur;
+  };
+
+  static OpProfile describe(Operation *op) {
+    OpProfile stat;
+    stat.name = module::getName(op).str();
+    stat.type = op->getName().getStringRef().str();
+    if (auto flops_op = dyn_cast<FlopsInterface>(op)) {
+      stat.flops = flops_op.getFLOPs();
+    }
+    for (auto v : op->getOperands()) {
+      if (!module::isNone(v)) {
+        stat.bytes_in += module::getNumElements(v) * sizeof(float);
+      }
+    }
+    for (auto v : op->getResults()) {
+      if (!module::isNone(v)) {
+        stat.bytes_out += module::getNumElements(v) * sizeof(float);
+      }
+    }
+    return stat;
+  }
+
+  clock::time_point start;
+  std::mutex mtx;
+  std::vector<OpProfile> stats;
+  std::unordered_map<Operation *, int> op_index;
+  std::unordered_map<std::thread::id, int> threads;
+  std::vector<Event> events;
+};
+
+// float weights shared by the interpreters of the process, see
+// set_shared_weights. A weight stays while an interpreter holds it
+class WeightStore {
+public:
+  using weight_t = std::shared_ptr<std::vector<float>>;
+
+  static weight_t get(const std::string &key,
+                      const std::function<weight_t()> &read) {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      if (auto data = weights[key].lock()) {
+        return data;
+      }
+    }
+    // read unlocked, interpreters loading at the same time do not wait on
+    // each other; the first one stored wins
+    auto data = read();
+    std::lock_guard<std::mutex> lock(mtx);
+    auto &entry = weights[key];
+    if (auto stored = entry.lock()) {
+      return stored;
+    }
+    entry = data;
+    return data;
+  }
+
+private:
+  static inline std::mutex mtx;
+  static inline std::unordered_map<std::string,
+                                   std::weak_ptr<std::vector<float>>>
+      weights;
+};
+
 ModuleInterpreter::ModuleInterpreter(ModuleOp module) : module(module) {
-  module::init(module);
+  // the interpreter only reads the weight file
+  session = module::createSession(module, true);
+  module::SessionGuard guard(session.get());
   if (!module::isState(module::State::TOP_F32) &&
       !module::isState(module::State::TPU_LOWERED)) {
     llvm_unreachable("mlir state not support");
@@ -43,16 +303,19 @@ ModuleInterpreter::ModuleInterpreter(ModuleOp module) : module(module) {
 }
 
 ModuleInterpreter::~ModuleInterpreter() {
+  module::SessionGuard guard(session.get());
   for (auto func : module.getOps<FuncOp>()) {
     func.walk([&](Operation *op) {
       if (auto infer_op = llvm::dyn_cast<InferenceInterface>(op)) {
         auto name = module::getName(op).str();
-        if (inference_map.find(name) != inference_map.end()) {
-          infer_op.deinit(*inference_map[name]);
+        if (inference_map.find(name) != inference_map.end() &&
+            pending_init.count(name) == 0) {
+          op_deinit(infer_op, *inference_map[name]);
         }
       }
     });
   }
+  release_bound_ops();
 }
 
 bool ModuleInterpreter::is_no_mem_op(Operation *op) {
@@ -63,7 +326,233 @@ bool ModuleInterpreter::is_no_mem_op(Operation *op) {
       op);
 }
 
+bool ModuleInterpreter::is_native_weight(Value v) {
+  if (!isa_and_nonnull<top::WeightOp>(v.getDefiningOp()) || v.use_empty()) {
+    return false;
+  }
+  auto stype = module::getStorageType(v);
+  if (!stype.isInteger(8) && !stype.isInteger(4)) {
+    return false;
+  }
+  // only users that widen the weight themselves
+  for (auto &use : v.getUses()) {
+    if (!isa<tpu::A16MatMulOp>(use.getOwner()) || use.getOperandNumber() != 1) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::shared_ptr<std::vector<float>>
+ModuleInterpreter::read_weight(top::WeightOp op) {
+  // one copy out of the weight file mapping, when it can be viewed
+  auto bytes = op.view();
+  bool native = is_native_weight(op.getOutput());
+  if (!native && (bytes.empty() || !module::getStorageType(op.getOutput()).isF32())) {
+    return op.read_as_float();
+  }
+  std::shared_ptr<std::vector<uint8_t>> data;
+  if (bytes.empty()) {
+    data = op.read_as_byte();
+    bytes = llvm::ArrayRef<char>((const char *)data->data(), data->size());
+  }
+  auto mem = std::make_shared<std::vector<float>>(
+      align_up(bytes.size(), sizeof(float)) / sizeof(float));
+  memcpy(mem->data(), bytes.data(), bytes.size());
+  return mem;
+}
+
+void ModuleInterpreter::set_native_inputs(Operation *op,
+                                          InferenceParameter &p) {
+  for (auto [i, v] : llvm::enumerate(op->getOperands())) {
+    if (is_native_weight(v)) {
+      p.native_inputs.resize(op->getNumOperands(), false);
+      p.native_inputs[i] = true;
+    }
+  }
+}
+
+void ModuleInterpreter::alloc_weight(top::WeightOp op,
+                                     const std::string &name) {
+  if (lazy_weight_budget < 0 && shared_weights) {
+    if (weight_file_id.empty()) {
+      weight_file_id = module::getWeightFileId();
+    }
+    auto key = weight_file_id + ":" + name +
+               (is_native_weight(op.getOutput()) ? ":native" : "");
+    mem_map[name] = WeightStore::get(key, [&]() { return read_weight(op); });
+    return;
+  }
+  if (lazy_weight_budget < 0) {
+    mem_map[name] = read_weight(op);
+    return;
+  }
+  // filled by load_lazy_weight, in place so that aliases see it
+  mem_map[name] = std::make_shared<std::vector<float>>();
+  lazy_weights.emplace(name, op);
+}
+
+bool ModuleInterpreter::has_lazy_weight(Operation *op) {
+  for (auto v : op->getOperands()) {
+    if (module::isNone(v) || v.isa<BlockArgument>()) {
+      continue;
+    }
+    if (lazy_weights.count(module::getName(v).str())) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ModuleInterpreter::load_lazy_weight(const std::string &name) {
+  auto it = lazy_weights.find(name);
+  if (it == lazy_weights.end()) {
+    return false;
+  }
+  auto weight = it->second;
+  auto key = module::getName(weight.getOutput()).str();
+  auto pos = lazy_loaded.find(key);
+  if (pos != lazy_loaded.end()) {
+    lazy_lru.splice(lazy_lru.begin(), lazy_lru, pos->second);
+    return true;
+  }
+  auto &mem = *mem_map.at(key);
+  mem = std::move(*read_weight(weight));
+  lazy_weight_bytes += mem.size() * sizeof(float);
+  lazy_lru.push_front(key);
+  lazy_loaded[key] = lazy_lru.begin();
+  return true;
+}
+
+void ModuleInterpreter::prepare_op(Operation *op, const std::string &name) {
+  if (lazy_weight_budget < 0) {
+    return;
+  }
+  auto &param = *inference_map.at(name);
+  for (auto [i, v] : llvm::enumerate(op->getOperands())) {
+    if (module::isNone(v) || v.isa<BlockArgument>()) {
+      continue;
+    }
+    auto v_name = module::getName(v).str();
+    if (load_lazy_weight(v_name)) {
+      param.inputs[i] = mem_map[v_name]->data();
+    }
+  }
+  if (pending_init.erase(name) == 0) {
+    return;
+  }
+  LLVM_DEBUG(llvm::dbgs() << "init: '" << name << "'\n");
+  if (failed(op_init(cast<InferenceInterface>(op), param))) {
+    op->dump();
+    llvm_unreachable("op inferece init failed");
+  }
+}
+
+void ModuleInterpreter::release_op(Operation *op) {
+  auto infer_op = dyn_cast<InferenceInterface>(op);
+  if (!infer_op) {
+    return;
+  }
+  auto name = module::getName(op).str();
+  auto it = inference_map.find(name);
+  if (it == inference_map.end() || pending_init.count(name)) {
+    return;
+  }
+  op_deinit(infer_op, *it->second);
+  pending_init.insert(name);
+}
+
+InferenceParameter &ModuleInterpreter::bind_op(InferenceInterface op,
+                                               const std::string &name,
+                                               InferenceParameter &p) {
+  auto &param = bound_params[name];
+  if (param == nullptr) {
+    param = std::make_shared<InferenceParameter>();
+    param->inputs = std::move(p.inputs);
+    param->outputs = std::move(p.outputs);
+    set_native_inputs(op, *param);
+    if (failed(op_init(op, *param))) {
+      op.dump();
+      llvm_unreachable("init failed!!");
+    }
+    return *param;
+  }
+  if (param->inputs == p.inputs && param->outputs == p.outputs) {
+    return *param;
+  }
+  param->inputs = std::move(p.inputs);
+  param->outputs = std::move(p.outputs);
+  if (param->setup_in_inference) {
+    // the next inference takes the new buffers
+  } else if (param->rebind) {
+    param->rebind(*param);
+  } else if (param->handle != nullptr) {
+    // no handle means init kept nothing of the buffers
+    op_deinit(op, *param);
+    if (failed(op_init(op, *param))) {
+      op.dump();
+      llvm_unreachable("init failed!!");
+    }
+  }
+  return *param;
+}
+
+void ModuleInterpreter::release_bound_ops() {
+  if (bound_params.empty()) {
+    return;
+  }
+  for (auto func : module.getOps<FuncOp>()) {
+    func.walk([&](InferenceInterface infer_op) {
+      auto it = bound_params.find(module::getName(infer_op).str());
+      if (it != bound_params.end()) {
+        op_deinit(infer_op, *it->second);
+      }
+    });
+  }
+  bound_params.clear();
+}
+
+void ModuleInterpreter::evict_lazy_weights() {
+  if (lazy_weight_budget <= 0) {
+    return;
+  }
+  while (lazy_weight_bytes > lazy_weight_budget && !lazy_lru.empty()) {
+    auto key = lazy_lru.back();
+    lazy_lru.pop_back();
+    lazy_loaded.erase(key);
+    // users hold pointers into the weight since init
+    for (auto user : lazy_weights.at(key).getOutput().getUsers()) {
+      release_op(user);
+      if (is_no_mem_op(user)) {
+        for (auto alias_user : user->getResult(0).getUsers()) {
+          release_op(alias_user);
+        }
+      }
+    }
+    auto &mem = *mem_map.at(key);
+    lazy_weight_bytes -= mem.size() * sizeof(float);
+    std::vector<float>().swap(mem);
+  }
+}
+
+void ModuleInterpreter::set_lazy_weight(int64_t budget_bytes) {
+  lazy_weight_budget = budget_bytes;
+  module::setWeightFileLazy(session.get(), budget_bytes >= 0);
+}
+
 void ModuleInterpreter::allocate_resources() {
+  module::SessionGuard guard(session.get());
+  needs_run.clear();
+  results_valid = false;
+  lazy_weights.clear();
+  lazy_lru.clear();
+  lazy_loaded.clear();
+  pending_init.clear();
+  release_bound_ops();
+  weight_file_id.clear();
+  lazy_weight_bytes = 0;
+  activation_offset.clear();
+  arena_pinned.clear();
   switch (mem_mode) {
   case mem_mode_t::ALL_TENSOR_IN_MEM:
     allocate_all_tensor_in_mem();
@@ -77,160 +566,324 @@ void ModuleInterpreter::allocate_resources() {
   case mem_mode_t::PART_SMALL_TENSOR_IN_MEM:
     allocate_small_tensor_in_mem();
     break;
-  case mem_mode_t::ALL_TENSOR_IN_REUSED_MEM:
-    allocate_tensor_in_reused_mem();
+  case mem_mode_t::ALL_TENSOR_IN_ARENA:
+    allocate_tensor_in_arena();
     break;
   }
+  tensor_index.clear();
+  tensor_index.reserve(all_tensor_names.size());
+  for (int i = 0; i < all_tensor_names.size(); ++i) {
+    tensor_index.emplace(all_tensor_names[i], i);
+  }
+  compile_plan();
+  link_blocked_outputs();
 }
 
-void ModuleInterpreter::allocate_tensor_in_reused_mem() {
-  all_tensor_names.clear();
-  value_map.clear();
-  mem_map.clear();
-  num_infer_op = 0;
-  for (auto func : module.getOps<FuncOp>()) {
-    func.walk([&](Operation *op) {
-      if (op == func.getOperation() || isa<top::NoneOp>(op)) {
-      } else if (isa<ReturnOp>(op)) {
-        for (auto v : op->getOperands()) {
-          auto name = module::getName(v).str();
-          output_names.push_back(name);
-        }
-      } else if (auto in_op = dyn_cast<top::InputOp>(op)) {
-        auto v = in_op.getOutput();
-        auto name = module::getName(v).str();
-        input_names.push_back(name);
-        value_map[name] = v;
-        all_tensor_names.push_back(name);
-      } else if (auto wOp = dyn_cast<top::WeightOp>(op)) {
-        auto v = wOp.getOutput();
-        auto name = module::getName(v).str();
-        value_map[name] = v;
-        mem_map[name] = wOp.read_as_float();
-        all_weight_names.push_back(name);
-      } else {
-        for (auto v : op->getResults()) {
-          if (module::getNumElements(v) == 0)
-            continue;
-          auto name = module::getName(v).str();
-          all_tensor_names.push_back(name);
-          value_map[name] = v;
-        }
+void ModuleInterpreter::link_blocked_outputs() {
+  for (auto &[name, param] : blocked_tensors) {
+    param->keep_blocked_output = false;
+  }
+  blocked_tensors.clear();
+  for (auto &step : plan) {
+    if (step.param) {
+      step.param->blocked_input = nullptr;
+    }
+  }
+  // lazy weights deinit ops, which frees the memories handed over
+  if (!blocked_layout || plan.empty() || lazy_weight_budget >= 0) {
+    return;
+  }
+  std::unordered_set<std::string> outputs(output_names.begin(),
+                                          output_names.end());
+  for (auto &step : plan) {
+    if (!step.op || step.param->blocked_output == nullptr ||
+        step.op->getNumResults() != 1) {
+      continue;
+    }
+    auto v = step.op->getResult(0);
+    auto name = module::getName(v).str();
+    if (v.use_empty() || outputs.count(name)) {
+      continue;
+    }
+    std::vector<InferenceParameter *> users;
+    for (auto &use : v.getUses()) {
+      auto it = inference_map.find(module::getName(use.getOwner()).str());
+      if (use.getOperandNumber() != 0 || it == inference_map.end() ||
+          !it->second->reads_blocked_input) {
+        users.clear();
+        break;
       }
-    });
+      users.push_back(it->second.get());
+    }
+    if (users.empty()) {
+      continue;
+    }
+    for (auto user : users) {
+      user->blocked_input = step.param->blocked_output;
+    }
+    step.param->keep_blocked_output = true;
+    blocked_tensors.emplace(name, step.param);
   }
+}
 
-  module::detachWeightFile(); // free weight mem
+void ModuleInterpreter::sync_blocked(const std::string &name, bool to_plain) {
+  auto it = blocked_tensors.find(name);
+  if (it != blocked_tensors.end()) {
+    it->second->sync_output(to_plain);
+  }
+}
 
-  uint32_t loc = 0;
-  int64_t alignment = 0;
-  int64_t start_addr = 0;
-  std::map<ValueInfo, TensorLive> liveRange;
-  std::map<Operation *, uint32_t> ops_loc;
-  std::vector<ValueInfo> common_ops;
-  // std::vector<ValueInfo> inplace_ops;
-  std::vector<Operation *> infer_ops;
-  std::map<ValueInfo, int64_t> gaddrMap;
-  std::map<ValueInfo, std::string> vNameMap;
-  uint64_t gmemUsed = 0;
+void ModuleInterpreter::compile_plan() {
+  plan.clear();
+  dequant_plan.clear();
+  // other modes run ops from transient buffers
+  if (mem_mode != mem_mode_t::ALL_TENSOR_IN_MEM &&
+      mem_mode != mem_mode_t::ALL_TENSOR_IN_ARENA) {
+    return;
+  }
+  if (module::isState(module::State::TPU_LOWERED)) {
+    for (auto &name : all_tensor_names) {
+      auto value = value_map.at(name);
+      if (is_no_mem_op(value.getDefiningOp()) || !hasTensorMem(name)) {
+        continue;
+      }
+      DequantStep step = {};
+      if (module::isUniformQuantized(value)) {
+        auto qtype = module::getUniformQuantizedType(value);
+        step.zero_point = (float)qtype.getZeroPoint();
+        step.scale = (float)qtype.getScale();
+      } else if (module::isCalibratedType(value) &&
+                 module::getStorageType(value).isFloat8E4M3FN()) {
+        step.is_f8 = true;
+        step.max = module::getCalibratedType(value).getMax();
+      } else {
+        continue;
+      }
+      step.data = tensor_data(name, step.size);
+      dequant_plan.push_back(step);
+    }
+  }
+  if (!is_flat_graph()) {
+    return;
+  }
+  llvm::DenseMap<Operation *, int> op_index;
   for (auto func : module.getOps<FuncOp>()) {
-    func.walk([&](Operation *op) {
-      if (llvm::dyn_cast<InferenceInterface>(op)) {
-        num_infer_op++;
-        ops_loc[op] = loc;
-        loc++;
-        infer_ops.emplace_back(op);
-      } else if (llvm::dyn_cast<top::InputOp>(op) || isa<ReturnOp>(op)) {
-        ops_loc[op] = loc;
-        loc++;
-        infer_ops.emplace_back(op);
+    func.walk<WalkOrder::PreOrder>([&](Operation *op) {
+      PlanStep step;
+      if (auto in_op = dyn_cast<top::InputOp>(op)) {
+        step.name = module::getName(in_op.getOutput()).str();
+      } else if (auto infer_op = dyn_cast<InferenceInterface>(op)) {
+        step.op = infer_op;
+        step.name = module::getName(op).str();
+        step.param = inference_map.at(step.name).get();
+        op_index[op] = plan.size();
+      } else {
+        return;
       }
+      plan.push_back(std::move(step));
     });
   }
-  for (Operation *infer_op : infer_ops) {
-    if (!isa<ReturnOp>(infer_op)) {
-      // int num_results = infer_op->getNumResults();
-      int index = 0;
-      for (auto v : infer_op->getResults()) {
-        // auto iter = infer_ops.end();
-        if (!module::isNone(v)) {
-          ValueInfo v_info(infer_op, index);
-          TensorLive v_live(ops_loc[infer_op], ops_loc[infer_op],
-                            module::getNumElements(v));
-          common_ops.emplace_back(v_info);
-          liveRange[v_info] = v_live;
-
-          for (auto successor_op : v.getUsers()) {
-            if (ops_loc.count(successor_op) > 0) {
-              liveRange[v_info].end =
-                  (liveRange[v_info].end > ops_loc[successor_op])
-                      ? liveRange[v_info].end
-                      : ops_loc[successor_op];
-            }
-          }
-          liveRange[v_info].end++;
-          vNameMap[v_info] = module::getName(v).str();
-        }
-        index++;
+  for (int i = 0; i < plan.size(); ++i) {
+    if (!plan[i].op) {
+      continue;
+    }
+    llvm::SmallPtrSet<Operation *, 4> preds;
+    for (auto v : plan[i].op->getOperands()) {
+      auto def = v.getDefiningOp();
+      if (!def) {
+        continue;
+      }
+      auto it = op_index.find(def);
+      if (it != op_index.end() && preds.insert(def).second) {
+        plan[it->second].users.push_back(i);
+        plan[i].num_preds++;
       }
     }
   }
-  if (!common_ops.empty()) {
-    GmemAllocator::sortOpByLiveStart(common_ops, liveRange);
-    GmemAllocator allocator(gaddrMap, alignment);
-    gmemUsed = allocator.assignGaddr(common_ops, liveRange, true, start_addr);
-    std::cout << "reused mem is " << gmemUsed << ", all mem is " << total_count
-              << std::endl;
-  }
-  auto gMem = std::make_shared<std::vector<float>>(gmemUsed);
-  // float* ptr = gMem->data();
-  for (auto pair : gaddrMap) {
-    auto name = vNameMap[pair.first];
-    auto memLoc = pair.second;
-    auto size = liveRange[pair.first].tensor_size;
-    mem_map[name] = gMem;
-    activation_offset[name] = std::make_pair(memLoc, size);
-    // std::cout << name << " start_addr " << ptr << " cur_addr " << (float
-    // *)(mem_map[name]->data()) - ptr << std::endl;
-  }
-  for (Operation *op : infer_ops) {
-    if (auto infer_op = llvm::dyn_cast<InferenceInterface>(op)) {
-      std::string op_name = module::getName(op).str();
-      auto param = std::make_shared<InferenceParameter>();
-      for (auto result : op->getResults()) {
-        if (result.getType().isa<NoneType>())
-          param->outputs.push_back(nullptr);
-        else {
-          auto r_name = module::getName(result).str();
-          auto r_memLoc = activation_offset[r_name].first;
-          param->outputs.push_back(mem_map[r_name]->data() + r_memLoc);
+}
+
+void ModuleInterpreter::allocate_tensor_in_arena() {
+  if (!is_flat_graph()) {
+    // if/loop bodies read tensors through block arguments
+    allocate_all_tensor_in_mem();
+    return;
+  }
+  all_tensor_names.clear();
+  value_map.clear();
+  mem_map.clear();
+  num_infer_op = 0;
+  auto func = *module.getOps<FuncOp>().begin();
+  std::vector<Operation *> ops;
+  func.walk([&](Operation *op) {
+    if (op != func.getOperation() && !isa<top::NoneOp>(op)) {
+      ops.push_back(op);
+    }
+  });
+
+  // live range of each activation in op order, [its op, its last user + 1)
+  uint32_t num_loc = ops.size();
+  std::map<ValueInfo, TensorLive> liveRange;
+  std::vector<ValueInfo> values;
+  // activation -> value owning its memory
+  std::unordered_map<std::string, ValueInfo> owner;
+  std::unordered_set<std::string> pinned = pinned_tensors;
+  for (uint32_t loc = 0; loc < num_loc; ++loc) {
+    auto op = ops[loc];
+    for (auto v : op->getOperands()) {
+      if (module::isNone(v)) {
+        continue;
+      }
+      auto it = owner.find(module::getName(v).str());
+      if (it != owner.end()) {
+        auto &live = liveRange[it->second];
+        live.end = std::max(live.end, loc + 1);
+      }
+    }
+    if (isa<ReturnOp>(op)) {
+      for (auto v : op->getOperands()) {
+        auto name = module::getName(v).str();
+        output_names.push_back(name);
+        pinned.insert(name);
+      }
+    } else if (auto wOp = dyn_cast<top::WeightOp>(op)) {
+      auto v = wOp.getOutput();
+      auto name = module::getName(v).str();
+      alloc_weight(wOp, name);
+      all_weight_names.push_back(name);
+      value_map[name] = v;
+    } else if (is_no_mem_op(op)) {
+      auto v = op->getResult(0);
+      auto name = module::getName(v).str();
+      auto in = module::getName(op->getOperand(0)).str();
+      auto it = owner.find(in);
+      if (it != owner.end()) {
+        owner.emplace(name, it->second);
+      } else {
+        // alias of a weight
+        mem_map[name] = mem_map[in];
+        if (lazy_weights.count(in)) {
+          lazy_weights.emplace(name, lazy_weights.at(in));
         }
       }
-      for (auto input : op->getOperands()) {
-        if (module::isNone(input)) {
-          param->inputs.push_back(nullptr);
+      all_tensor_names.push_back(name);
+      value_map[name] = v;
+    } else {
+      if (isa<top::InputOp>(op)) {
+        auto name = module::getName(op->getResult(0)).str();
+        input_names.push_back(name);
+        pinned.insert(name);
+      }
+      for (auto [i, v] : llvm::enumerate(op->getResults())) {
+        auto count = module::getNumElements(v);
+        if (module::isNone(v) || count == 0) {
           continue;
         }
-        auto input_name = module::getName(input).str();
+        auto name = module::getName(v).str();
+        ValueInfo v_info(op, i);
+        liveRange[v_info] =
+            TensorLive(loc, loc + 1, align_up(count, ARENA_ALIGNMENT));
+        values.push_back(v_info);
+        owner.emplace(name, v_info);
+        all_tensor_names.push_back(name);
+        value_map[name] = v;
+      }
+    }
+  }
+  if (lazy_weight_budget < 0) {
+    module::detachWeightFile(); // to free weight memory
+  }
+  std::set<ValueInfo> pinned_values;
+  for (auto &name : pinned) {
+    auto it = owner.find(name);
+    if (it != owner.end()) {
+      pinned_values.insert(it->second);
+      liveRange[it->second] =
+          TensorLive(0, num_loc, liveRange[it->second].tensor_size);
+    }
+  }
+  arena_pinned.clear();
+  for (auto &[name, v_info] : owner) {
+    if (pinned_values.count(v_info)) {
+      arena_pinned.insert(name);
+    }
+  }
 
-        if (mem_map.find(input_name) == mem_map.end()) {
-          input.dump();
-          llvm_unreachable("input operands not allocated");
-        } else {
-          auto input_memLoc = activation_offset[input_name].first;
-          param->inputs.push_back(mem_map[input_name]->data() + input_memLoc);
-        }
+  std::map<ValueInfo, int64_t> gaddrMap;
+  int64_t arena_size = 0;
+  if (!values.empty()) {
+    GmemAllocator::sortOpByLiveStart(values, liveRange);
+    GmemAllocator allocator(gaddrMap, ARENA_ALIGNMENT);
+    arena_size = allocator.assignGaddr(values, liveRange, true, 0);
+  }
+  LLVM_DEBUG(llvm::dbgs() << "arena size: " << arena_size * sizeof(float) / 1024
+                          << " KB, without reuse: "
+                          << total_count * sizeof(float) / 1024 << " KB\n");
+  auto arena = std::make_shared<std::vector<float>>(arena_size);
+  for (auto &[name, v_info] : owner) {
+    mem_map[name] = arena;
+    activation_offset[name] = std::make_pair(
+        gaddrMap.at(v_info), module::getNumElements(value_map.at(name)));
+  }
+
+  for (auto op : ops) {
+    auto infer_op = dyn_cast<InferenceInterface>(op);
+    if (!infer_op) {
+      continue;
+    }
+    num_infer_op++;
+    auto name = module::getName(op).str();
+    auto param = std::make_shared<InferenceParameter>();
+    size_t size;
+    for (auto result : op->getResults()) {
+      if (result.getType().isa<NoneType>()) {
+        param->outputs.push_back(nullptr);
+      } else {
+        param->outputs.push_back(
+            tensor_data(module::getName(result).str(), size));
+      }
+    }
+    for (auto input : op->getOperands()) {
+      if (module::isNone(input)) {
+        param->inputs.push_back(nullptr);
+        continue;
       }
-      LLVM_DEBUG(llvm::dbgs() << "init: '" << op_name << "'\n");
-      if (failed(infer_op.init(*param))) {
+      auto input_name = module::getName(input).str();
+      if (mem_map.find(input_name) == mem_map.end()) {
+        input.dump();
+        llvm_unreachable("input operands not allocated");
+      }
+      param->inputs.push_back(tensor_data(input_name, size));
+    }
+    set_native_inputs(op, *param);
+    if (has_lazy_weight(op)) {
+      // init once its weights are read, see prepare_op
+      pending_init.insert(name);
+    } else {
+      LLVM_DEBUG(llvm::dbgs() << "init: '" << name << "'\n");
+      if (failed(op_init(infer_op, *param))) {
         op->dump();
         llvm_unreachable("op inferece init failed");
       }
-      inference_map[op_name] = param;
     }
+    inference_map[name] = param;
   }
 }
 
+float *ModuleInterpreter::tensor_data(const std::string &name, size_t &size) {
+  auto &mem = mem_map.at(name);
+  auto it = activation_offset.find(name);
+  if (it == activation_offset.end()) {
+    size = mem->size();
+    return mem->data();
+  }
+  size = it->second.second;
+  return mem->data() + it->second.first;
+}
+
+void ModuleInterpreter::pin_tensor(const std::string &name) {
+  pinned_tensors.insert(name);
+}
+
 bool ModuleInterpreter::check_op_in_mem(Operation *op) {
   for (auto r : op->getResults()) {
     if (module::isNone(r)) {
@@ -301,7 +954,7 @@ void ModuleInterpreter::allocate_part_tensor_in_mem() {
         auto v = wOp.getOutput();
         auto name = module::getName(v).str();
         value_map[name] = v;
-        mem_map[name] = wOp.read_as_float();
+        alloc_weight(wOp, name);
         all_weight_names.push_back(name);
       } else {
         for (auto r : op->getResults()) {
@@ -315,7 +968,9 @@ void ModuleInterpreter::allocate_part_tensor_in_mem() {
         idx++;
       }
     });
-    module::detachWeightFile(); // to free weight memory
+    if (lazy_weight_budget < 0) {
+      module::detachWeightFile(); // to free weight memory
+    }
     // input output buffers for ops
     func.walk([&](InferenceInterface infer_op) {
       num_infer_op++;
@@ -339,10 +994,16 @@ void ModuleInterpreter::allocate_part_tensor_in_mem() {
             param->inputs.push_back(mem_map[i_name]->data());
           }
         }
-        LLVM_DEBUG(llvm::dbgs() << "init: '" << name << "'\n");
-        if (failed(infer_op.init(*param))) {
-          infer_op->dump();
-          llvm_unreachable("op inferece init failed");
+        set_native_inputs(infer_op, *param);
+        if (has_lazy_weight(infer_op)) {
+          // init once its weights are read, see prepare_op
+          pending_init.insert(name);
+        } else {
+          LLVM_DEBUG(llvm::dbgs() << "init: '" << name << "'\n");
+          if (failed(op_init(infer_op, *param))) {
+            infer_op->dump();
+            llvm_unreachable("op inferece init failed");
+          }
         }
         inference_map[name] = param;
       }
@@ -381,7 +1042,7 @@ void ModuleInterpreter::allocate_all_tensor_in_disk() {
           }
           value_map[name] = result;
           if (auto wOp = llvm::dyn_cast<top::WeightOp>(op)) {
-            mem_map[name] = wOp.read_as_float();
+            alloc_weight(wOp, name);
             all_weight_names.push_back(name);
           } else if (is_input) {
             mem_map[name] = std::make_shared<std::vector<float>>(count);
@@ -390,7 +1051,9 @@ void ModuleInterpreter::allocate_all_tensor_in_disk() {
         }
       }
     });
-    module::detachWeightFile(); // to free weight memory
+    if (lazy_weight_budget < 0) {
+      module::detachWeightFile(); // to free weight memory
+    }
   }
 }
 void ModuleInterpreter::allocate_all_tensor_in_mem() {
@@ -417,7 +1080,7 @@ void ModuleInterpreter::allocate_all_tensor_in_mem() {
       } else if (auto wOp = dyn_cast<top::WeightOp>(op)) {
         auto v = wOp.getOutput();
         auto name = module::getName(v).str();
-        mem_map[name] = wOp.read_as_float();
+        alloc_weight(wOp, name);
         all_weight_names.push_back(name);
         value_map[name] = v;
       } else if (is_no_mem_op(op)) {
@@ -425,6 +1088,9 @@ void ModuleInterpreter::allocate_all_tensor_in_mem() {
         auto name = module::getName(v).str();
         auto in = module::getName(op->getOperand(0)).str();
         mem_map[name] = mem_map[in];
+        if (lazy_weights.count(in)) {
+          lazy_weights.emplace(name, lazy_weights.at(in));
+        }
         all_tensor_names.push_back(name);
         value_map[name] = v;
       } else {
@@ -433,7 +1099,9 @@ void ModuleInterpreter::allocate_all_tensor_in_mem() {
         }
       }
     });
-    module::detachWeightFile(); // to free weight memory
+    if (lazy_weight_budget < 0) {
+      module::detachWeightFile(); // to free weight memory
+    }
 
     // input output buffers for all ops
     func.walk([&](Operation *op) {
@@ -474,10 +1142,16 @@ void ModuleInterpreter::allocate_all_tensor_in_mem() {
             param->inputs.push_back(mem_map[input_name]->data());
           }
         }
-        LLVM_DEBUG(llvm::dbgs() << "init: '" << name << "'\n");
-        if (failed(infer_op.init(*param))) {
-          op->dump();
-          llvm_unreachable("op inferece init failed");
+        set_native_inputs(op, *param);
+        if (has_lazy_weight(op)) {
+          // init once its weights are read, see prepare_op
+          pending_init.insert(name);
+        } else {
+          LLVM_DEBUG(llvm::dbgs() << "init: '" << name << "'\n");
+          if (failed(op_init(infer_op, *param))) {
+            op->dump();
+            llvm_unreachable("op inferece init failed");
+          }
         }
         inference_map[name] = param;
       }
@@ -509,7 +1183,7 @@ void ModuleInterpreter::allocate_small_tensor_in_mem() {
       } else if (auto wOp = dyn_cast<top::WeightOp>(op)) {
         auto v = wOp.getOutput();
         auto name = module::getName(v).str();
-        mem_map[name] = wOp.read_as_float();
+        alloc_weight(wOp, name);
         all_weight_names.push_back(name);
         value_map[name] = v;
       } else if (is_no_mem_op(op)) {
@@ -517,6 +1191,9 @@ void ModuleInterpreter::allocate_small_tensor_in_mem() {
         auto name = module::getName(v).str();
         auto in = module::getName(op->getOperand(0)).str();
         mem_map[name] = mem_map[in];
+        if (lazy_weights.count(in)) {
+          lazy_weights.emplace(name, lazy_weights.at(in));
+        }
         all_tensor_names.push_back(name);
         value_map[name] = v;
       } else {
@@ -531,7 +1208,9 @@ void ModuleInterpreter::allocate_small_tensor_in_mem() {
         }
       }
     });
-    module::detachWeightFile(); // to free weight memory
+    if (lazy_weight_budget < 0) {
+      module::detachWeightFile(); // to free weight memory
+    }
 
     // input output buffers for all ops
     func.walk([&](Operation *op) {
@@ -562,10 +1241,16 @@ void ModuleInterpreter::allocate_small_tensor_in_mem() {
               param->inputs.push_back(mem_map[input_name]->data());
             }
           }
-          LLVM_DEBUG(llvm::dbgs() << "init: '" << name << "'\n");
-          if (failed(infer_op.init(*param))) {
-            op->dump();
-            llvm_unreachable("op inferece init failed");
+          set_native_inputs(op, *param);
+          if (has_lazy_weight(op)) {
+            // init once its weights are read, see prepare_op
+            pending_init.insert(name);
+          } else {
+            LLVM_DEBUG(llvm::dbgs() << "init: '" << name << "'\n");
+            if (failed(op_init(infer_op, *param))) {
+              op->dump();
+              llvm_unreachable("op inferece init failed");
+            }
           }
           inference_map[name] = param;
         }
@@ -575,7 +1260,7 @@ void ModuleInterpreter::allocate_small_tensor_in_mem() {
 }
 
 void ModuleInterpreter::fake_quant_weight() {
-  module::init(module);
+  module::SessionGuard guard(session.get());
   LLVM_DEBUG(llvm::errs() << "start fake_quant_weight\n");
   std::vector<std::string> not_quant_weight_names;
   for (auto func : module.getOps<FuncOp>()) {
@@ -594,21 +1279,30 @@ void ModuleInterpreter::fake_quant_weight() {
                    name)) {
       continue;
     }
+    if (shared_weights) {
+      llvm::errs() << "Weight " << name << " is shared by interpreters\n";
+      llvm_unreachable("Error, fake_quant_weight failed");
+    }
 
-    auto mem = *mem_map.at(name);
+    load_lazy_weight(name);
+    auto &mem = *mem_map.at(name);
     auto max_value =
         std::max(std::abs(*std::max_element(mem.begin(), mem.end())),
                  std::abs(*std::min_element(mem.begin(), mem.end())));
     for (auto &data : mem) {
       data = std::round(data * 127 / max_value) * max_value / 127;
     }
+    auto v = value_map.at(name);
+    mark_users(v);
+    bump_weight_version(v);
   }
 }
 
 void ModuleInterpreter::invoke(bool express_type) {
+  ThreadBudget budget;
   switch (mem_mode) {
   case mem_mode_t::ALL_TENSOR_IN_MEM:
-  case mem_mode_t::ALL_TENSOR_IN_REUSED_MEM:
+  case mem_mode_t::ALL_TENSOR_IN_ARENA:
     invoke_all_in_mem(express_type);
     break;
   case mem_mode_t::PART_TENSOR_IN_MEM:
@@ -623,7 +1317,61 @@ void ModuleInterpreter::invoke(bool express_type) {
 }
 
 void ModuleInterpreter::invoke_all_in_mem(bool express_type) {
-  module::init(module);
+  module::SessionGuard guard(session.get());
+  llvm::SaveAndRestore<bool> invoking(in_invoke, true);
+  if (can_invoke_parallel()) {
+    invoke_parallel();
+  } else if (!plan.empty()) {
+    invoke_plan();
+  } else {
+    invoke_sequential();
+  }
+  needs_run.clear();
+  results_valid = true;
+  llvm::errs() << "\n";
+  if (express_type && module::isState(module::State::TPU_LOWERED)) {
+    // results no longer in storage type
+    results_valid = false;
+    for (auto &step : dequant_plan) {
+      float *mem = step.data;
+      if (step.is_f8) {
+        for (size_t i = 0; i < step.size; i++)
+          mem[i] = (mem[i] * step.max / get_f8e4m3_max());
+      } else {
+        for (size_t i = 0; i < step.size; i++) {
+          mem[i] = (mem[i] - step.zero_point) * step.scale;
+        }
+      }
+    }
+  }
+}
+
+void ModuleInterpreter::invoke_plan() {
+  progressbar bar(num_infer_op);
+  bool has_hooks = !before_hooks.empty() || !after_hooks.empty();
+  for (auto &step : plan) {
+    if (step.op) {
+      bar.update();
+    }
+    if (has_hooks) {
+      call_before_hook(step.name);
+    }
+    if (step.op) {
+      LLVM_DEBUG(llvm::dbgs() << "compute: '" << step.op << "'\n");
+      prepare_op(step.op, step.name);
+      if (failed(op_inference(step.op, *step.param))) {
+        step.op.dump();
+        llvm_unreachable("invoke failed!!");
+      }
+      evict_lazy_weights();
+    }
+    if (has_hooks) {
+      call_after_hook(step.name);
+    }
+  }
+}
+
+void ModuleInterpreter::invoke_sequential() {
   progressbar bar(num_infer_op);
   int flag = 0;
   std::string if_name, loop_name;
@@ -651,18 +1399,16 @@ void ModuleInterpreter::invoke_all_in_mem(bool express_type) {
         return WalkResult::advance();
       }
       if (isa<tpu::IfOp, top::IfOp>(op)) {
-        std::optional<RegisteredOperationName> info =
-            op->getName().getRegisteredInfo();
         if_name = name;
-        auto *inferInterface =
-            info->getInterface<tpu_mlir::InferenceInterface>();
         call_before_hook(name);
-        if (failed(inferInterface->inference(inferInterface, op,
-                                             *inference_map[name]))) {
+        prepare_op(op, name);
+        if (failed(op_inference(cast<InferenceInterface>(op),
+                                *inference_map[name]))) {
           flag = 2; // else branch
         } else {
           flag = 1; // then branch
         }
+        evict_lazy_weights();
         call_after_hook(name);
         return WalkResult::advance();
       } else if (isa<top::LoopOp, tpu::LoopOp>(op)) {
@@ -740,10 +1486,13 @@ void ModuleInterpreter::invoke_all_in_mem(bool express_type) {
               }
               LLVM_DEBUG(llvm::dbgs() << "compute: '" << op_ << "'\n");
               call_before_hook(name);
-              if (failed(infer_op.inference(*inference_map[op_name]))) {
+              prepare_op(op_, op_name);
+              if (failed(
+                      op_inference(infer_op, *inference_map[op_name]))) {
                 infer_op.dump();
                 llvm_unreachable("invoke failed!!");
               }
+              evict_lazy_weights();
               call_after_hook(name);
             }
 
@@ -850,7 +1599,8 @@ void ModuleInterpreter::invoke_all_in_mem(bool express_type) {
 
         auto restore_data =
             [&](NEW_TYPE &backup,
-                std::map<std::string, std::shared_ptr<InferenceParameter>>
+                std::unordered_map<std::string,
+                                   std::shared_ptr<InferenceParameter>>
                     &inference_map) {
               // restore the data
               for (int kk = 0; kk < backup.size(); kk++) {
@@ -952,18 +1702,22 @@ void ModuleInterpreter::invoke_all_in_mem(bool express_type) {
         bar.update();
         auto infer_op = dyn_cast<InferenceInterface>(op);
         call_before_hook(name);
-        if (failed(infer_op.inference(*inference_map[name]))) {
+        prepare_op(op, name);
+        if (failed(op_inference(infer_op, *inference_map[name]))) {
           infer_op.dump();
           llvm_unreachable("invoke failed!!");
         }
+        evict_lazy_weights();
         call_after_hook(name);
       } else if (flag && op->getParentRegion()->getRegionNumber() == flag - 1) {
         if (auto infer_op = dyn_cast<InferenceInterface>(op)) {
           call_before_hook(name);
-          if (failed(infer_op.inference(*inference_map[name]))) {
+          prepare_op(op, name);
+          if (failed(op_inference(infer_op, *inference_map[name]))) {
             infer_op.dump();
             llvm_unreachable("invoke failed!!");
           }
+          evict_lazy_weights();
           call_after_hook(name);
         }
 
@@ -982,51 +1736,178 @@ void ModuleInterpreter::invoke_all_in_mem(bool express_type) {
       return WalkResult::advance();
     });
   }
-  llvm::errs() << "\n";
-  if (express_type && module::isState(module::State::TPU_LOWERED)) {
-    for (auto &name : all_tensor_names) {
-      auto value = value_map.at(name);
-      if (is_no_mem_op(value.getDefiningOp())) {
-        continue;
+}
+
+bool ModuleInterpreter::can_invoke_parallel() {
+  // hooks observe ops in program order; in the arena, ops that are not
+  // ordered by data dependency may still share buffers
+  if (parallel_workers < 2 || !before_hooks.empty() || !after_hooks.empty() ||
+      mem_mode != mem_mode_t::ALL_TENSOR_IN_MEM || lazy_weight_budget >= 0) {
+    return false;
+  }
+  // if/loop bodies are driven by the sequential walk, see compile_plan
+  return !plan.empty();
+}
+
+bool ModuleInterpreter::is_flat_graph() {
+  auto funcs = module.getOps<FuncOp>();
+  if (std::distance(funcs.begin(), funcs.end()) != 1) {
+    return false;
+  }
+  bool has_region = false;
+  (*funcs.begin()).walk([&](Operation *op) {
+    if (!isa<FuncOp>(op) && op->getNumRegions() > 0) {
+      has_region = true;
+    }
+  });
+  return !has_region;
+}
+
+bool ModuleInterpreter::can_invoke_incremental() {
+  // skipped ops must keep their results in their own buffers, and hooks
+  // expect every op from the start one on
+  return results_valid && mem_mode == mem_mode_t::ALL_TENSOR_IN_MEM &&
+         before_hooks.empty() && after_hooks.empty() && !plan.empty();
+}
+
+void ModuleInterpreter::mark_users(Value v) {
+  for (auto user : v.getUsers()) {
+    needs_run.insert(user);
+  }
+}
+
+void ModuleInterpreter::bump_weight_version(Value v) {
+  for (auto user : v.getUsers()) {
+    if (is_no_mem_op(user)) {
+      bump_weight_version(user->getResult(0));
+      continue;
+    }
+    auto it = inference_map.find(module::getName(user).str());
+    if (it != inference_map.end()) {
+      it->second->weight_version++;
+    }
+  }
+}
+
+void ModuleInterpreter::invoke_parallel() {
+  int num_step = plan.size();
+  int num_op = 0;
+  std::vector<int> num_pending(num_step, 0);
+  for (int i = 0; i < num_step; ++i) {
+    if (plan[i].op) {
+      num_op++;
+      num_pending[i] = plan[i].num_preds;
+    }
+  }
+
+  progressbar bar(num_infer_op);
+  std::mutex mutex;
+  std::condition_variable cond;
+  std::deque<int> ready;
+  int num_done = 0;
+  for (int i = 0; i < num_step; ++i) {
+    if (plan[i].op && num_pending[i] == 0) {
+      ready.push_back(i);
+    }
+  }
+  // every op gets the team size of this invoke, as in a sequential one:
+  // kernels whose reduction order follows the thread count (dnnl gemm and
+  // conv among them) then give the same bits. Overlapping ops oversubscribe
+  // the cores
+  int num_threads = omp_get_max_threads();
+  auto worker = [&]() {
+    omp_set_num_threads(num_threads);
+    module::SessionGuard guard(session.get());
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      cond.wait(lock, [&]() { return !ready.empty() || num_done == num_op; });
+      if (ready.empty()) {
+        break;
       }
-      auto mem = mem_map.at(name);
-      if (module::isUniformQuantized(value)) {
-        auto qtype = module::getUniformQuantizedType(value);
-        for (auto &data : *mem) {
-          data = (data - (float)qtype.getZeroPoint()) * (float)qtype.getScale();
+      int i = ready.front();
+      ready.pop_front();
+      lock.unlock();
+      auto &step = plan[i];
+      LLVM_DEBUG(llvm::dbgs() << "compute: '" << step.op << "'\n");
+      if (failed(op_inference(step.op, *step.param))) {
+        step.op.dump();
+        llvm_unreachable("invoke failed!!");
+      }
+      lock.lock();
+      bar.update();
+      num_done++;
+      for (auto u : plan[i].users) {
+        if (--num_pending[u] == 0) {
+          ready.push_back(u);
         }
-      } else if (module::isCalibratedType(value) &&
-                 module::getStorageType(value).isFloat8E4M3FN()) {
-        auto qtype = module::getCalibratedType(value);
-        for (auto &data : *mem)
-          data = (data * qtype.getMax() / get_f8e4m3_max());
       }
+      cond.notify_all();
     }
+  };
+  std::vector<std::thread> threads;
+  for (int i = 1; i < parallel_workers; ++i) {
+    threads.emplace_back(worker);
   }
+  worker();
+  for (auto &t : threads) {
+    t.join();
+  }
+}
+
+void ModuleInterpreter::set_shared_weights(bool enable) {
+  shared_weights = enable;
+}
+
+void ModuleInterpreter::set_parallel_workers(int num) {
+  parallel_workers = num;
 }
 
-void ModuleInterpreter::value_to_disk(const std::string &filename,
+void ModuleInterpreter::value_to_disk(SpillWriter &writer,
                                       const std::string &name,
-                                      std::vector<float> &data,
+                                      std::shared_ptr<std::vector<float>> data,
                                       bool express_type) {
-  // auto value = value_map.at(name);
-  // if (express_type && module::isState(module::State::TPU_LOWERED)) {
-  //   if (module::isUniformQuantized(value)) {
-  //     auto qtype = module::getUniformQuantizedType(value);
-  //     for (auto &d : data) {
-  //       d = (d - (float)qtype.getZeroPoint()) * (float)qtype.getScale();
-  //     }
-  //   }
-  // }
-  // cnpy::npz_save(filename, name, data, "a");
-  llvm_unreachable("Not Implemented");
+  auto value = value_map.at(name);
+  SpillWriter::express_fn express;
+  if (express_type && module::isState(module::State::TPU_LOWERED)) {
+    if (module::isUniformQuantized(value)) {
+      auto qtype = module::getUniformQuantizedType(value);
+      float zp = qtype.getZeroPoint();
+      float scale = qtype.getScale();
+      express = [zp, scale](std::vector<float> &data) {
+        for (auto &d : data) {
+          d = (d - zp) * scale;
+        }
+      };
+    } else if (module::isCalibratedType(value) &&
+               module::getStorageType(value).isFloat8E4M3FN()) {
+      float scale = module::getCalibratedType(value).getMax() /
+                    get_f8e4m3_max();
+      express = [scale](std::vector<float> &data) {
+        for (auto &d : data) {
+          d = d * scale;
+        }
+      };
+    }
+  }
+  std::vector<size_t> shape;
+  size_t count = 1;
+  for (auto s : module::getShape(value)) {
+    shape.push_back(s);
+    count *= s;
+  }
+  if (shape.empty() || count != data->size()) {
+    shape = {data->size()};
+  }
+  writer.push(name, std::move(data), std::move(shape), std::move(express));
 }
 
 void ModuleInterpreter::invoke_to_disk(const std::string &filename,
                                        bool express_type) {
-  module::init(module);
+  ThreadBudget budget;
+  module::SessionGuard guard(session.get());
+  SpillWriter writer(filename, SPILL_PENDING_BYTES);
   progressbar bar(num_infer_op);
-  std::map<std::string, int> mem_uses;
+  std::unordered_map<std::string, int> mem_uses;
   for (auto func : module.getOps<FuncOp>()) {
     func.walk([&](InferenceInterface infer_op) {
       bar.update();
@@ -1038,6 +1919,7 @@ void ModuleInterpreter::invoke_to_disk(const std::string &filename,
           continue;
         }
         auto name = module::getName(in).str();
+        load_lazy_weight(name);
         if (mem_map.find(name) == mem_map.end()) {
           in.dump();
           llvm_unreachable("input operands not allocated");
@@ -1074,42 +1956,41 @@ void ModuleInterpreter::invoke_to_disk(const std::string &filename,
           to_free.push_back(name);
         }
       }
-      if (failed(infer_op.init(p))) {
-        infer_op.dump();
-        llvm_unreachable("init failed!!");
-      }
+      auto &param = bind_op(infer_op, module::getName(infer_op).str(), p);
       LLVM_DEBUG(llvm::dbgs() << "compute: '" << infer_op << "'\n");
-      if (failed(infer_op.inference(p))) {
+      if (failed(op_inference(infer_op, param))) {
         infer_op.dump();
         llvm_unreachable("invoke failed!!");
       }
       for (auto &m : to_free) {
-        value_to_disk(filename, m, *mem_map[m], express_type);
+        value_to_disk(writer, m, mem_map[m], express_type);
         mem_map.erase(m);
       }
-      infer_op.deinit(p);
+      evict_lazy_weights();
     });
   }
   llvm::errs() << "\n";
   for (auto &m : all_tensor_names) {
-    value_to_disk(filename, m, *mem_map[m], express_type);
+    value_to_disk(writer, m, mem_map[m], express_type);
   }
 }
 
 void ModuleInterpreter::invoke_part_in_mem(bool express_type) {
-  module::init(module);
+  module::SessionGuard guard(session.get());
   progressbar bar(num_infer_op);
-  std::map<std::string, int> mem_uses;
+  std::unordered_map<std::string, int> mem_uses;
   for (auto func : module.getOps<FuncOp>()) {
     func.walk([&](InferenceInterface infer_op) {
       bar.update();
       auto name = module::getName(infer_op).str();
       LLVM_DEBUG(llvm::dbgs() << "compute: '" << infer_op << "'\n");
       if (inference_map.find(name) != inference_map.end()) {
-        if (failed(infer_op.inference(*inference_map[name]))) {
+        prepare_op(infer_op, name);
+        if (failed(op_inference(infer_op, *inference_map[name]))) {
           infer_op.dump();
           llvm_unreachable("invoke failed!!");
         }
+        evict_lazy_weights();
       } else {
         tpu_mlir::InferenceParameter p;
         std::vector<std::string> to_free;
@@ -1119,6 +2000,7 @@ void ModuleInterpreter::invoke_part_in_mem(bool express_type) {
             continue;
           }
           auto name = module::getName(in).str();
+          load_lazy_weight(name);
           if (mem_map.find(name) == mem_map.end() ||
               mem_map[name].use_count() == 0) {
             in.dump();
@@ -1159,19 +2041,15 @@ void ModuleInterpreter::invoke_part_in_mem(bool express_type) {
             to_free.push_back(name);
           }
         }
-        if (failed(infer_op.init(p))) {
-          infer_op.dump();
-          llvm_unreachable("init failed!!");
-        }
-        LLVM_DEBUG(llvm::dbgs() << "compute: '" << infer_op << "'\n");
-        if (failed(infer_op.inference(p))) {
+        auto &param = bind_op(infer_op, name, p);
+        if (failed(op_inference(infer_op, param))) {
           infer_op.dump();
           llvm_unreachable("invoke failed!!");
         }
         for (auto &m : to_free) {
           mem_map.erase(m);
         }
-        infer_op.deinit(p);
+        evict_lazy_weights();
       }
     });
   }
@@ -1202,7 +2080,10 @@ void ModuleInterpreter::invoke_part_in_mem(bool express_type) {
 
 std::shared_ptr<std::vector<float>>
 ModuleInterpreter::invoke_at(const std::string op_name) {
-  module::init(module);
+  ThreadBudget budget;
+  module::SessionGuard guard(session.get());
+  // the result is read before its slot can be reused
+  llvm::SaveAndRestore<bool> invoking(in_invoke, true);
   if (value_map.find(op_name) == value_map.end()) {
     llvm::errs() << "Can't find op:" << op_name << "\n";
     llvm_unreachable("invoke_at op_name error");
@@ -1216,31 +2097,49 @@ ModuleInterpreter::invoke_at(const std::string op_name) {
   auto infer_op = cast<InferenceInterface>(op);
   LLVM_DEBUG(llvm::dbgs() << "invoke at: '" << infer_op << "'\n");
   call_before_hook(op_name);
-  if (failed(infer_op.inference(*inference_map[op_name]))) {
+  prepare_op(op, op_name);
+  if (failed(op_inference(infer_op, *inference_map[op_name]))) {
     infer_op.dump();
     llvm_unreachable("infer_op.inference failed!!");
   }
+  evict_lazy_weights();
   call_after_hook(op_name);
+  needs_run.erase(op);
+  for (auto r : op->getResults()) {
+    mark_users(r);
+  }
   return getTensor(op_name);
 }
 
 void ModuleInterpreter::invoke_from(const std::string op_name) {
-  module::init(module);
+  ThreadBudget budget;
+  module::SessionGuard guard(session.get());
+  llvm::SaveAndRestore<bool> invoking(in_invoke, true);
+  // after op_name, only ops whose inputs changed since they last ran
+  bool incremental = can_invoke_incremental();
   bool start_run = false;
   for (auto func : module.getOps<FuncOp>()) {
     func.walk([&](InferenceInterface infer_op) {
       auto name = module::getName(infer_op).str();
       if (name == op_name) {
         start_run = true;
+      } else if (incremental && needs_run.count(infer_op.getOperation()) == 0) {
+        return;
       }
       LLVM_DEBUG(llvm::dbgs() << "invoke: '" << infer_op << "'\n");
       if (start_run) {
         call_before_hook(name);
-        if (failed(infer_op.inference(*inference_map[name]))) {
+        prepare_op(infer_op, name);
+        if (failed(op_inference(infer_op, *inference_map[name]))) {
           infer_op.dump();
           llvm_unreachable("invoke failed!!");
         }
+        evict_lazy_weights();
         call_after_hook(name);
+        needs_run.erase(infer_op.getOperation());
+        for (auto r : infer_op->getResults()) {
+          mark_users(r);
+        }
       }
     });
   }
@@ -1254,7 +2153,8 @@ void ModuleInterpreter::backward_weight_at(const std::string op_name,
                                            const int dst_grd_len,
                                            const void *weight_grd,
                                            const int weight_grd_len) {
-  module::init(module);
+  ThreadBudget budget;
+  module::SessionGuard guard(session.get());
   if (value_map.find(op_name) == value_map.end()) {
     llvm::errs() << "Can't find op:" << op_name << "\n";
     llvm_unreachable("invoke_at op_name error");
@@ -1290,6 +2190,8 @@ void ModuleInterpreter::backward_weight_at(const std::string op_name,
     }
   }
   back_param->outputs.push_back((float *)weight_grd);
+  // the backward pass reads the plain input
+  sync_blocked(module::getName(op->getOperand(0)).str(), true);
 
   if (op == nullptr || false == isa<InferenceInterface>(op)) {
     llvm::errs() << "Op :" << op_name << " can't do backward";
@@ -1297,6 +2199,9 @@ void ModuleInterpreter::backward_weight_at(const std::string op_name,
   }
   auto infer_op = cast<InferenceInterface>(op);
   LLVM_DEBUG(llvm::dbgs() << "backward at: '" << op_name << "'\n");
+  // only weight_grd is written, the caller updates the filter with setTensor,
+  // which bumps weight_version so that the next forward sets up again
+  prepare_op(op, op_name);
   if (failed(infer_op.backward_weight(*inference_map[op_name], *back_param))) {
     infer_op.dump();
     llvm_unreachable("infer_op.backward failed!!");
@@ -1306,24 +2211,26 @@ void ModuleInterpreter::backward_weight_at(const std::string op_name,
 
 void ModuleInterpreter::setTensor(const std::string &name, const void *data,
                                   size_t size, bool is_integer) {
-  module::init(module);
+  module::SessionGuard guard(session.get());
   auto it = mem_map.find(name);
   if (it == mem_map.end()) {
     llvm::errs() << "Can't find op name: " << name << "\n";
     llvm_unreachable("Error, setTensor failed");
   }
-  bool is_activation =
-      std::find(all_tensor_names.begin(), all_tensor_names.end(), name) !=
-      all_tensor_names.end();
-  auto act = it->second;
-  auto tensor_size =
-      (mem_mode == mem_mode_t::ALL_TENSOR_IN_REUSED_MEM && is_activation)
-          ? activation_offset[name].second
-          : act->size();
-  auto offset =
-      (mem_mode == mem_mode_t::ALL_TENSOR_IN_REUSED_MEM && is_activation)
-          ? activation_offset[name].first
-          : 0;
+  auto v_it = value_map.find(name);
+  if (shared_weights && v_it != value_map.end() &&
+      isa_and_nonnull<top::WeightOp>(v_it->second.getDefiningOp())) {
+    llvm::errs() << "Weight " << name << " is shared by interpreters\n";
+    llvm_unreachable("Error, setTensor failed");
+  }
+  if (v_it != value_map.end()) {
+    mark_users(v_it->second);
+    if (isa_and_nonnull<top::WeightOp>(v_it->second.getDefiningOp())) {
+      bump_weight_version(v_it->second);
+    }
+  }
+  size_t tensor_size;
+  float *dst = tensor_data(name, tensor_size);
   if (tensor_size * sizeof(float) != size) {
     llvm::errs() << "Tensor " << name
                  << " data need size: " << tensor_size * sizeof(float)
@@ -1337,21 +2244,21 @@ void ModuleInterpreter::setTensor(const std::string &name, const void *data,
     for (uint32_t i = 0; i < tensor_size; i++) {
       float d =
           p[i] * (float)(1 / qtype.getScale()) + (float)qtype.getZeroPoint();
-      *(&(act->at(i)) + offset) = qtype.isSigned() ? to_int8(d) : to_uint8(d);
+      dst[i] = qtype.isSigned() ? to_int8(d) : to_uint8(d);
     }
     // std::cout << "is interger" << std::endl;
   } else if (is_integer == false && module::isCalibratedType(value) &&
              module::getStorageType(value).isFloat8E4M3FN()) {
     double scale = module::getCalibratedType(value).getMax() / get_f8e4m3_max();
-    F8E4M3((const float *)data, act->data() + offset, tensor_size, 1 / scale,
-           true);
+    F8E4M3((const float *)data, dst, tensor_size, 1 / scale, true);
   } else if (is_integer == false && module::isCalibratedType(value) &&
              module::getStorageType(value).isFloat8E4M3FN()) {
-    F8E5M2((const float *)data, act->data() + offset, tensor_size, 1., true);
+    F8E5M2((const float *)data, dst, tensor_size, 1., true);
 
   } else {
-    memcpy(act->data() + offset, data, size);
+    memcpy(dst, data, size);
   }
+  sync_blocked(name, false);
 }
 
 bool ModuleInterpreter::hasTensorMem(const std::string &name) {
@@ -1359,73 +2266,93 @@ bool ModuleInterpreter::hasTensorMem(const std::string &name) {
   if (it == mem_map.end() || it->second.use_count() == 0) {
     return false;
   }
-  return true;
+  return activation_offset.count(name) == 0 || arena_pinned.count(name) != 0;
+}
+
+void ModuleInterpreter::check_arena_tensor(const std::string &name) {
+  if (in_invoke || activation_offset.count(name) == 0 ||
+      arena_pinned.count(name) != 0) {
+    return;
+  }
+  llvm::errs() << "Tensor " << name
+               << " is not kept after invoke in arena mode, pin it or use "
+                  "value_mem\n";
+  llvm_unreachable("Error, arena tensor read after invoke");
 }
 
 std::shared_ptr<std::vector<float>>
 ModuleInterpreter::getTensor(const std::string &name, bool express_type) {
+  module::SessionGuard guard(session.get());
+  load_lazy_weight(name);
   auto it = mem_map.find(name);
-  if (it == mem_map.end() || mem_map[name].use_count() == 0) {
+  if (it == mem_map.end() || it->second.use_count() == 0) {
     llvm::errs() << "Can't find op name: " << name << "\n";
     llvm_unreachable("Error, getTensor failed");
   }
-  bool is_activation =
-      std::find(all_tensor_names.begin(), all_tensor_names.end(), name) !=
-      all_tensor_names.end();
-  auto act = it->second;
-  auto tensor_size =
-      (mem_mode == mem_mode_t::ALL_TENSOR_IN_REUSED_MEM && is_activation)
-          ? activation_offset[name].second
-          : act->size();
-  auto offset =
-      (mem_mode == mem_mode_t::ALL_TENSOR_IN_REUSED_MEM && is_activation)
-          ? activation_offset[name].first
-          : 0;
+  check_arena_tensor(name);
+  sync_blocked(name, true);
+  size_t tensor_size;
+  const float *src = tensor_data(name, tensor_size);
 
   if (express_type && module::isState(module::State::TPU_LOWERED)) {
     auto value = value_map.at(name);
     if (module::isUniformQuantized(value)) {
-      int i = 0;
-      auto mem = mem_map.at(name);
       auto data_fp32 = std::make_shared<std::vector<float>>(tensor_size);
       auto qtype = module::getUniformQuantizedType(value);
-      // for (auto &data : *mem) {
-      //   data_fp32->data()[i++] =
-      //       (data - (float)qtype.getZeroPoint()) * (float)qtype.getScale();
-      // }
-      for (i = 0; i < tensor_size; i++) {
-        data_fp32->data()[i] =
-            (*(mem->data() + offset + i) - (float)qtype.getZeroPoint()) *
-            (float)qtype.getScale();
+      for (size_t i = 0; i < tensor_size; i++) {
+        data_fp32->data()[i] = (src[i] - (float)qtype.getZeroPoint()) *
+                               (float)qtype.getScale();
       }
       return std::move(data_fp32);
     } else if (module::isCalibratedType(value) &&
                module::getStorageType(value).isFloat8E4M3FN()) {
-      int i = 0;
-      auto mem = mem_map.at(name);
       auto data_fp32 = std::make_shared<std::vector<float>>(tensor_size);
       auto qtype = module::getCalibratedType(value);
       double scale = qtype.getMax();
-      for (i = 0; i < tensor_size; i++) {
-        data_fp32->data()[i] =
-            (*(mem->data() + offset + i) * (float)scale / get_f8e4m3_max());
+      for (size_t i = 0; i < tensor_size; i++) {
+        data_fp32->data()[i] = (src[i] * (float)scale / get_f8e4m3_max());
       }
       return std::move(data_fp32);
     }
   }
-  // bool is_activation =
-  // std::find(all_tensor_names.begin(),all_tensor_names.end(), name) !=
-  // all_tensor_names.end(); auto act = it->second; auto tensor_size = (mem_mode
-  // == mem_mode_t::ALL_TENSOR_IN_REUSED_MEM && is_activation)?
-  // activation_offset[name].second:act->size(); auto offset =(mem_mode ==
-  // mem_mode_t::ALL_TENSOR_IN_REUSED_MEM && is_activation)?
-  // activation_offset[name].first:0; std::shared_ptr<std::vector<float>>
-  // tmp(act->data()+offset,act->data()+offset+tensor_size);
-  auto tmp = std::make_shared<std::vector<float>>(
-      act->data() + offset, act->data() + offset + tensor_size);
+  auto tmp = std::make_shared<std::vector<float>>(src, src + tensor_size);
   return std::move(tmp);
 }
 
+std::shared_ptr<std::vector<float>>
+ModuleInterpreter::getTensorView(const std::string &name, size_t &offset,
+                                 size_t &size) {
+  auto it = mem_map.find(name);
+  if (it == mem_map.end() || it->second.use_count() == 0) {
+    llvm::errs() << "Can't find op name: " << name << "\n";
+    llvm_unreachable("Error, getTensorView failed");
+  }
+  if (load_lazy_weight(name)) {
+    // eviction frees the buffer in place, the view gets its own
+    offset = 0;
+    size = it->second->size();
+    return std::make_shared<std::vector<float>>(*it->second);
+  }
+  check_arena_tensor(name);
+  sync_blocked(name, true);
+  offset = tensor_data(name, size) - it->second->data();
+  return it->second;
+}
+
+int ModuleInterpreter::getTensorIndex(const std::string &name) {
+  auto it = tensor_index.find(name);
+  return it == tensor_index.end() ? -1 : it->second;
+}
+
+std::shared_ptr<std::vector<float>>
+ModuleInterpreter::getTensor(int index, bool express_type) {
+  if (index < 0 || index >= all_tensor_names.size()) {
+    llvm::errs() << "Tensor index out of range: " << index << "\n";
+    llvm_unreachable("Error, getTensor failed");
+  }
+  return getTensor(all_tensor_names[index], express_type);
+}
+
 bool ModuleInterpreter::getTensorQuantInfo(const std::string name,
                                            std::string &dtype, float &scale,
                                            int &zp) {
@@ -1537,8 +2464,92 @@ void ModuleInterpreter::clear_hooks() {
   before_hooks.clear();
 }
 
+void ModuleInterpreter::set_profile(bool enable) {
+  profiler.reset(enable ? new OpProfiler() : nullptr);
+}
+
+std::vector<OpProfile> ModuleInterpreter::get_profile() {
+  return profiler ? profiler->get() : std::vector<OpProfile>();
+}
+
+LogicalResult
+ModuleInterpreter::dump_profile_trace(const std::string &filename) {
+  if (!profiler) {
+    llvm::errs() << "dump_profile_trace needs set_profile(true)\n";
+    return failure();
+  }
+  return profiler->dump_trace(filename);
+}
+
+LogicalResult ModuleInterpreter::op_init(InferenceInterface op,
+                                         InferenceParameter &p) {
+  p.blocked_layout = blocked_layout;
+  if (!profiler) {
+    return op.init(p);
+  }
+  auto begin = OpProfiler::clock::now();
+  auto ret = op.init(p);
+  profiler->record(op, OpProfiler::INIT, begin, OpProfiler::clock::now());
+  return ret;
+}
+
+LogicalResult ModuleInterpreter::op_inference(InferenceInterface op,
+                                              InferenceParameter &p) {
+  if (!profiler) {
+    return op.inference(p);
+  }
+  auto begin = OpProfiler::clock::now();
+  auto ret = op.inference(p);
+  profiler->record(op, OpProfiler::INFERENCE, begin,
+                   OpProfiler::clock::now());
+  return ret;
+}
+
+void ModuleInterpreter::op_deinit(InferenceInterface op,
+                                  InferenceParameter &p) {
+  if (!profiler) {
+    op.deinit(p);
+    return;
+  }
+  auto begin = OpProfiler::clock::now();
+  op.deinit(p);
+  profiler->record(op, OpProfiler::DEINIT, begin, OpProfiler::clock::now());
+}
+
 void ModuleInterpreter::set_mem_mode(std::string mem_mode_str) {
-  if (mem_mode_str == "reused_mem" || mem_mode_str.empty())
-    mem_mode = mem_mode_t::ALL_TENSOR_IN_REUSED_MEM;
+  if (mem_mode_str.empty()) {
+    // keeps the mode chosen by the size of the module
+    return;
+  }
+  if (mem_mode_str == "arena" || mem_mode_str == "reused_mem") {
+    mem_mode = mem_mode_t::ALL_TENSOR_IN_ARENA;
+  } else if (mem_mode_str == "value_mem") {
+    if (total_count >= MAX_COUNT_LIMIT) {
+      llvm::errs() << "Module too large for value_mem, keeps "
+                   << (mem_mode == mem_mode_t::ALL_TENSOR_IN_ARENA
+                           ? "arena"
+                           : "part of the tensors in memory")
+                   << "\n";
+      return;
+    }
+    mem_mode = mem_mode_t::ALL_TENSOR_IN_MEM;
+  } else if (mem_mode_str == "disk") {
+    mem_mode = mem_mode_t::ALL_TENSOR_IN_DISK;
+  } else {
+    llvm::errs() << "Unknown mem mode: " << mem_mode_str << "\n";
+    llvm_unreachable("Error, set_mem_mode failed");
+  }
+}
+
+void ModuleInterpreter::set_blocked_layout(bool enable) {
+  blocked_layout = enable;
+  // ops read it at their next inference
+  for (auto &[name, param] : inference_map) {
+    param->blocked_layout = enable;
+  }
+  for (auto &[name, param] : bound_params) {
+    param->blocked_layout = enable;
+  }
+  link_blocked_outputs();
 }
 } // namespace tpu_mlir
@@ -16,17 +16,40 @@
 
 #include "mlir/IR/BuiltinOps.h"
 #include "mlir/IR/MLIRContext.h"
+#include "tpu_mlir/Dialect/Top/IR/TopOps.h"
 #include "tpu_mlir/Interfaces/InferenceInterface.h"
 #include "llvm/Support/Debug.h"
 
 #include <fstream>
 #include <iostream>
+#include <list>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
 
 #define DEBUG_TYPE "interpreter"
 using namespace mlir;
 namespace tpu_mlir {
 
+class SpillWriter;
+class OpProfiler;
+namespace module {
+struct Session;
+}
+
+// per op totals of the interpreter, see set_profile
+struct OpProfile {
+  std::string name;
+  std::string type;
+  // from FlopsInterface, 0 for ops without it
+  int64_t flops = 0;
+  // float data the host kernel reads and writes per inference
+  int64_t bytes_in = 0;
+  int64_t bytes_out = 0;
+  int64_t num_init = 0, num_inference = 0, num_deinit = 0;
+  double init_us = 0, inference_us = 0, deinit_us = 0;
+};
+
 class CallBack {
 public:
   virtual ~CallBack() {}
@@ -37,35 +60,57 @@ class ModuleInterpreter {
 public:
   enum class mem_mode_t {
     // if mem size > 16GB, then use ALL_TENSOR_IN_DISK or PART_TENSOR_IN_MEM
-    // else use ALL_TENSOR_IN_MEM
+    // else use ALL_TENSOR_IN_MEM; ALL_TENSOR_IN_ARENA is set by set_mem_mode
     ALL_TENSOR_IN_MEM,
     ALL_TENSOR_IN_DISK,
     PART_TENSOR_IN_MEM,
     PART_SMALL_TENSOR_IN_MEM,
-    ALL_TENSOR_IN_REUSED_MEM
+    // activations share one buffer, placed by their live ranges. A tensor
+    // holds its value from its op until its last user ran; inputs, outputs
+    // and pinned tensors for the whole invoke
+    ALL_TENSOR_IN_ARENA
   };
   // Interpret the given MLIR module expressed in MLIR TPU IR dialect
   explicit ModuleInterpreter(ModuleOp module);
   virtual ~ModuleInterpreter();
   void allocate_resources();
   void invoke(bool express_type = true);
+  // ALL_TENSOR_IN_DISK: every activation is written to the npz filename as
+  // soon as its last user ran, outputs stay readable by getTensor
   void invoke_to_disk(const std::string &filename, bool express_type = true);
   void fake_quant_weight();
   std::shared_ptr<std::vector<float>> invoke_at(std::string name);
+  // runs op_name and the ops after it; once a full invoke has left all
+  // results in place (ALL_TENSOR_IN_MEM, no hooks), ops after op_name whose
+  // inputs were not set or recomputed since are skipped
   void invoke_from(const std::string op_name);
   void backward_weight_at(std::string name, const void *dst_grd,
                           const int dst_grd_len, const void *weight_grd,
                           const int weight_grd_len);
   void setTensor(const std::string &name, const void *data, size_t size,
                  bool is_integer = false);
+  // false for arena tensors that are not pinned, as their memory is reused.
+  // getTensor of such a tensor fails outside of the invoke (and its hooks)
   bool hasTensorMem(const std::string &name);
 
   std::shared_ptr<std::vector<float>> getTensor(const std::string &name,
                                                 bool express_type = false);
+  // tensor without copy: returns the buffer holding it, sets offset and size
+  // in elements of the tensor in it. Data is stored type, the next invoke
+  // overwrites it
+  std::shared_ptr<std::vector<float>>
+  getTensorView(const std::string &name, size_t &offset, size_t &size);
+  // index of an activation in all_tensor_names, -1 if not an activation
+  int getTensorIndex(const std::string &name);
+  std::shared_ptr<std::vector<float>> getTensor(int index,
+                                                bool express_type = false);
   bool getTensorQuantInfo(const std::string name, std::string &dtype,
                           float &scale, int &zp);
   llvm::ArrayRef<int64_t> getTensorShape(const std::string &name);
   bool is_no_mem_op(Operation *op);
+  // int8/int4 weights consumed only by ops that widen them themselves (in
+  // their init) are kept in storage type; getTensor returns their raw bytes
+  bool is_native_weight(Value v);
   // void add_before_forward(CallBack* hook);
   void clear_hooks();
 
@@ -74,15 +119,64 @@ private:
   void allocate_all_tensor_in_mem();
   void allocate_all_tensor_in_disk();
   void allocate_small_tensor_in_mem();
-  void allocate_tensor_in_reused_mem();
+  void allocate_tensor_in_arena();
   bool check_op_in_mem(Operation *op);
+  // fails for an unpinned arena tensor read outside of an invoke
+  void check_arena_tensor(const std::string &name);
   void invoke_part_in_mem(bool express_type = true);
   void invoke_all_in_mem(bool express_type = true);
-  void value_to_disk(const std::string &filename, const std::string &name,
-                     std::vector<float> &data, bool express_type = true);
+  void invoke_sequential();
+  // ALL_TENSOR_IN_MEM and ALL_TENSOR_IN_ARENA: ops and dequant steps are
+  // compiled once by allocate_resources, so that invoke runs them from
+  // vectors instead of walking the IR and looking up names
+  void compile_plan();
+  void invoke_plan();
+  // run ops whose inputs are ready concurrently, see set_parallel_workers
+  bool can_invoke_parallel();
+  void invoke_parallel();
+  // single function without if/loop ops
+  bool is_flat_graph();
+  // invoke_from may skip ops not in needs_run
+  bool can_invoke_incremental();
+  void mark_users(Value v);
+  // after the weight v was written in place: bumps weight_version of the ops
+  // reading it, directly or through aliases
+  void bump_weight_version(Value v);
+  void value_to_disk(SpillWriter &writer, const std::string &name,
+                     std::shared_ptr<std::vector<float>> data,
+                     bool express_type = true);
   void collect_tensor(Value v);
+  // start of the tensor in its buffer and its size in elements
+  float *tensor_data(const std::string &name, size_t &size);
+  std::shared_ptr<std::vector<float>> read_weight(top::WeightOp op);
+  void set_native_inputs(Operation *op, InferenceParameter &p);
+  void alloc_weight(top::WeightOp op, const std::string &name);
+  bool has_lazy_weight(Operation *op);
+  // read a lazy weight if not resident, false if name is not a lazy weight
+  bool load_lazy_weight(const std::string &name);
+  // page in the weights of an op from inference_map, init it if deferred
+  void prepare_op(Operation *op, const std::string &name);
+  void release_op(Operation *op);
+  // ops run from transient buffers (disk and part in mem modes) are inited on
+  // their first run and kept; later runs move them to the buffers given in p
+  // through rebind, or deinit and init again if the op has no rebind. Ops
+  // that set up in inference only get the new buffers
+  InferenceParameter &bind_op(InferenceInterface op, const std::string &name,
+                              InferenceParameter &p);
+  void release_bound_ops();
+  // blocked layout: lets producers keep their result in blocked_output when
+  // every user reads it from there, see InferenceParameter
+  void link_blocked_outputs();
+  // plain copy of a tensor kept blocked, to_plain before it is read and back
+  // after it is written
+  void sync_blocked(const std::string &name, bool to_plain);
+  void evict_lazy_weights();
   void call_before_hook(std::string layer_name);
   void call_after_hook(std::string layer_name);
+  // InferenceInterface calls, timed while profiling
+  LogicalResult op_init(InferenceInterface op, InferenceParameter &p);
+  LogicalResult op_inference(InferenceInterface op, InferenceParameter &p);
+  void op_deinit(InferenceInterface op, InferenceParameter &p);
 
 public:
   std::vector<std::string> input_names;
@@ -92,18 +186,112 @@ public:
   std::vector<std::string> all_weight_names; // weight tensor
   std::vector<std::shared_ptr<tpu_mlir::CallBack>> before_hooks;
   std::vector<std::shared_ptr<tpu_mlir::CallBack>> after_hooks;
+  // "value_mem" (default, refused for modules too large for it), "arena"
+  // (or "reused_mem"), "disk"; "" keeps the current mode
   void set_mem_mode(std::string mem_mmode);
+  // conv kernels of this interpreter run in dnnl blocked layouts. Between
+  // adjacent convs of a flat graph the result stays blocked, its plain (nchw)
+  // tensor is only written when read through getTensor
+  void set_blocked_layout(bool enable);
+  // threads executing independent ops, < 2 means sequential; ignored in
+  // arena mode, while hooks are installed or with if/loop ops. Each op runs
+  // with the thread budget of the invoke, results equal a sequential invoke
+  void set_parallel_workers(int num);
+  // before allocate_resources: weights are read from the mapped weight file
+  // when an op first uses them, and ops holding them are initialized then.
+  // budget_bytes > 0 evicts least recently used weights above it, 0 keeps
+  // them all, < 0 reads all weights up front
+  void set_lazy_weight(int64_t budget_bytes);
+  // time every init, inference and deinit of ops from now on, false drops
+  // what was recorded. Inits done by allocate_resources are only seen if
+  // enabled before it
+  void set_profile(bool enable);
+  // totals per op, in the order ops were first called
+  std::vector<OpProfile> get_profile();
+  // recorded calls as complete events of the chrome trace format, for
+  // chrome://tracing or perfetto. Fails without set_profile(true) or if the
+  // file can't be written
+  LogicalResult dump_profile_trace(const std::string &filename);
+  // before allocate_resources: in ALL_TENSOR_IN_ARENA, keep the tensor for
+  // the whole invoke so that it can be read after it
+  void pin_tensor(const std::string &name);
+  // before allocate_resources: weights are shared, read only, with the other
+  // interpreters of the process reading the same weight file. Not with lazy
+  // weights, which are paged per interpreter
+  void set_shared_weights(bool enable);
 
 private:
   ModuleOp module;
+  // module state of this interpreter, bound to the threads running it so
+  // that interpreters of other modules can run at the same time
+  std::shared_ptr<module::Session> session;
+  bool shared_weights = false;
+  // module::getWeightFileId, key of the shared weights
+  std::string weight_file_id;
   int64_t num_infer_op;
   mem_mode_t mem_mode;
+  int parallel_workers = 0;
+  bool blocked_layout = false;
+  // tensors left in the blocked_output of their producer
+  std::unordered_map<std::string, InferenceParameter *> blocked_tensors;
+  int64_t lazy_weight_budget = -1;
+  std::unique_ptr<OpProfiler> profiler;
+  int64_t lazy_weight_bytes = 0;
+  // weight name (or alias of it) -> op to read it from
+  std::unordered_map<std::string, top::WeightOp> lazy_weights;
+  // resident lazy weights, most recently used first
+  std::list<std::string> lazy_lru;
+  std::unordered_map<std::string, std::list<std::string>::iterator>
+      lazy_loaded;
+  // ops in inference_map whose init waits for their weights
+  std::unordered_set<std::string> pending_init;
+  // every op result is what running it on its current inputs gives, except
+  // for ops in needs_run (inputs set or recomputed since)
+  bool results_valid = false;
+  std::unordered_set<Operation *> needs_run;
   int64_t total_count;
-  std::map<std::string, Value> value_map;
-  std::map<std::string, std::shared_ptr<InferenceParameter>> inference_map;
-  std::map<std::string, std::shared_ptr<std::vector<float>>> mem_map;
-  // std::vector<float> gMem;
-  std::map<std::string, std::pair<uint64_t, uint32_t>> activation_offset;
+  std::unordered_map<std::string, Value> value_map;
+  std::unordered_map<std::string, std::shared_ptr<InferenceParameter>>
+      inference_map;
+  // params of ops kept by bind_op, not in inference_map
+  std::unordered_map<std::string, std::shared_ptr<InferenceParameter>>
+      bound_params;
+  std::unordered_map<std::string, std::shared_ptr<std::vector<float>>> mem_map;
+  // position of each activation in all_tensor_names, built once by
+  // allocate_resources
+  std::unordered_map<std::string, int> tensor_index;
+  // ALL_TENSOR_IN_ARENA: offset and size of each activation in the arena,
+  // aliases of no mem ops share the ones of their input
+  std::unordered_map<std::string, std::pair<uint64_t, uint64_t>>
+      activation_offset;
+  std::unordered_set<std::string> pinned_tensors;
+  // activations kept valid for the whole invoke
+  std::unordered_set<std::string> arena_pinned;
+  // ops are running: arena tensors are read in their live range
+  bool in_invoke = false;
+  // one step per input and op of a flat graph, in program order; empty
+  // otherwise
+  struct PlanStep {
+    // null for inputs, which only call the hooks
+    InferenceInterface op;
+    InferenceParameter *param = nullptr;
+    std::string name;
+    // steps of the ops using the results, and number of ops producing the
+    // inputs
+    std::vector<int> users;
+    int num_preds = 0;
+  };
+  std::vector<PlanStep> plan;
+  // express_type of TPU_LOWERED modules, results from storage type in place
+  struct DequantStep {
+    float *data;
+    size_t size;
+    // f8: v * max / f8 max, else (v - zero_point) * scale
+    bool is_f8;
+    float zero_point, scale;
+    double max;
+  };
+  std::vector<DequantStep> dequant_plan;
 };
 
 } // namespace tpu_mlir
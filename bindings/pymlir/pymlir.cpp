@@ -8,6 +8,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "pymodule.h"
+#include "tpu_mlir/Support/MathUtils.h"
 
 #ifdef USE_CUDA
 #include "pycuda.h"
@@ -15,6 +16,23 @@
 
 void set_mem_mode(std::string mem_mode) { py_module::set_mem_mode(mem_mode); }
 
+void set_lazy_weight(int64_t budget_mb) {
+  py_module::set_lazy_weight(budget_mb);
+}
+
+void pin_tensors(std::vector<std::string> names) {
+  py_module::pin_tensors(names);
+}
+
+void set_shared_weights(bool enable) { py_module::set_shared_weights(enable); }
+
+void convert_weight(std::string src, std::string dst) {
+  if (failed(mlir::TensorFile::convert(src, dst))) {
+    throw std::runtime_error("convert_weight " + src + " to " + dst +
+                             " failed");
+  }
+}
+
 void debug_only(std::vector<std::string> debug_types) {
   llvm::DebugFlag = true;
   std::vector<const char *> c_debug;
@@ -74,8 +92,36 @@ PYBIND11_MODULE(pymlir, m) {
   m.def("debug", &debug, py::arg("enable") = true,
         "enable debugging information");
   m.def("debug", &debug_only, "configure debugging information");
-  m.def("set_mem_mode", &set_mem_mode, "set_Gmem_mode_str");
+  m.def("set_mem_mode", &set_mem_mode,
+        "for modules loaded after: \"value_mem\" (default) keeps every "
+        "tensor, \"arena\" reuses activation memory (only inputs, outputs "
+        "and pinned tensors are readable after invoke), \"disk\" for "
+        "invoke_to_disk");
+  m.def("pin_tensors", &pin_tensors, py::arg("names"),
+        "for modules loaded after in arena mode: keep these tensors readable "
+        "after invoke, besides inputs and outputs");
+  m.def("set_lazy_weight", &set_lazy_weight, py::arg("budget_mb") = 0,
+        "for modules loaded after: read weights on first use from the mapped "
+        "weight file, evict above budget_mb (0: no limit, < 0: off)");
+  m.def("set_shared_weights", &set_shared_weights, py::arg("enable") = true,
+        "for modules loaded after: modules of the same weight file share one "
+        "read-only copy of the weights, set_tensor on weights is refused; "
+        "ignored with set_lazy_weight");
+  m.def("convert_weight", &convert_weight, py::arg("src"), py::arg("dst"),
+        "convert a weight file between npz and the mapped weight pack "
+        "(.mlirw), by the extension of dst");
   m.def("run_pass_pipeline", &run_pass_pipeline, "run_pass_pipeline");
+  m.def("set_num_threads", &tpu_mlir::set_num_threads, py::arg("num"),
+        "total cpu threads shared by concurrent invokes, 0 restores the "
+        "default (TPUMLIR_NUM_THREADS, else OMP_NUM_THREADS)");
+  m.def("get_num_threads", &tpu_mlir::get_num_threads,
+        "total cpu threads shared by concurrent invokes");
+  m.def("set_concurrent_invokes", &tpu_mlir::set_concurrent_invokes,
+        py::arg("num"),
+        "number of threads invoking modules at the same time, each invoke "
+        "runs with get_num_threads() / num threads");
+  m.def("get_concurrent_invokes", &tpu_mlir::get_concurrent_invokes,
+        "number of threads declared to invoke modules at the same time");
   py::class_<quant_brief_info>(m, "q_info", "simple tensor quant info")
       .def_readwrite("dtype", &quant_brief_info::dtype)
       .def_readwrite("shape", &quant_brief_info::shape)
@@ -84,14 +130,26 @@ PYBIND11_MODULE(pymlir, m) {
   // clang-format off
   py::class_<py_module>(m, "module", "MLIR Module")
       .def(py::init<>())
-      .def("load", &py_module::load, "load module from IR")
+      .def("load", &py_module::load, py::arg("filename"), py::arg("profile")=false, "load module from IR, profile: time the op inits of load too")
       .def("set_mem_mode", &py_module::set_mem_mode)
+      .def("set_blocked_layout", &py_module::set_blocked_layout, py::arg("enable")=true, "run conv in dnnl blocked layout")
+      .def("set_parallel_workers", &py_module::set_parallel_workers, "run independent ops on num threads, off in arena mem mode or while hooks are installed")
+      .def("set_profile", &py_module::set_profile, py::arg("enable")=true, "time every op from now on, false drops the records; load(profile=True) also times the inits of load")
+      .def("get_profile", &py_module::get_profile, "per op totals: time of init/inference/deinit in us, flops, bytes")
+      .def("dump_profile_trace", &py_module::dump_profile_trace, py::arg("filename"), "write recorded op calls as chrome trace json")
       .def("set_tensor", &py_module::set_tensor)
       .def("set_tensor_from_int", &py_module::set_tensor_from_int)
       .def("get_tensor", &py_module::get_tensor, "get one tensor data")
       .def("get_fp32_tensor", &py_module::get_fp32_tensor, "get one fp32 tensor data")
+      .def("get_tensor_view", &py_module::get_tensor_view, "read-only tensor data without copy, valid until next invoke")
+      .def("get_tensor_index", &py_module::get_tensor_index, "index of tensor in all_tensor_names, -1 if none")
+      .def("get_tensor_by_index", &py_module::get_tensor_by_index, "get one tensor data by its index in all_tensor_names")
       .def("get_all_tensor", &py_module::getAllTensor, "dump all tensor data")
       .def("invoke", &py_module::invoke, py::arg("fixed_to_float")=true)
+      .def("invoke_to_disk", &py_module::invoke_to_disk, py::arg("filename"), py::arg("fixed_to_float")=true,
+           "with set_mem_mode(\"disk\"): invoke and write all tensors to the npz filename")
+      .def("invoke_batch", &py_module::invoke_batch, py::arg("inputs"), py::arg("fixed_to_float")=true,
+           py::arg("outputs")=std::vector<std::string>(), "invoke once per sample of N, returns outputs stacked along dim 0")
       .def("fake_quant_weight", &py_module::fake_quant_weight)
       .def("invoke_at", &py_module::invoke_at, "invote at specified layer")
       .def("backward_weight_at", &py_module::backward_weight_at, "invoke the backward weight function of conv op")
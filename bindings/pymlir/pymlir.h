@@ -52,7 +52,11 @@ namespace py = pybind11;
 class PyCallBack : public CallBack {
 public:
   explicit PyCallBack(py::function &func) : run_(func) {}
-  void run(std::string layer_name) { run_(layer_name); }
+  void run(std::string layer_name) {
+    // invoke runs without the gil
+    py::gil_scoped_acquire acquire;
+    run_(layer_name);
+  }
   py::function run_;
 };
 
@@ -15,6 +15,9 @@
 
 std::string py_module::version = MLIR_VERSION;
 std::string py_module::gmem_mode_str_ = "";
+int64_t py_module::glazy_weight_budget_ = -1;
+std::vector<std::string> py_module::gpinned_tensors_;
+bool py_module::gshared_weights_ = false;
 
 py_module::~py_module() {
   interpreter_.reset();
@@ -25,7 +28,15 @@ py_module::~py_module() {
   context_.reset();
 }
 
-void py_module::load(std::string filename) {
+std::unique_lock<std::mutex> py_module::lock_module() {
+  // waits without the GIL: python threads go on meanwhile, and hooks of the
+  // invoke holding the lock can take the GIL
+  py::gil_scoped_release release;
+  return std::unique_lock<std::mutex>(mutex_);
+}
+
+void py_module::load(std::string filename, bool profile) {
+  auto lock = lock_module();
   if (context_) {
     context_.reset();
   }
@@ -41,9 +52,20 @@ void py_module::load(std::string filename) {
     interpreter_.reset();
   }
 
-  interpreter_ = std::make_unique<ModuleInterpreter>(module_.get());
-  interpreter_->set_mem_mode(gmem_mode_str_);
-  interpreter_->allocate_resources();
+  {
+    // modules of other python threads load and run meanwhile
+    py::gil_scoped_release release;
+    interpreter_ = std::make_unique<ModuleInterpreter>(module_.get());
+    interpreter_->set_mem_mode(gmem_mode_str_);
+    interpreter_->set_lazy_weight(glazy_weight_budget_);
+    interpreter_->set_shared_weights(gshared_weights_);
+    // before allocate_resources, which runs the inits
+    interpreter_->set_profile(profile);
+    for (auto &name : gpinned_tensors_) {
+      interpreter_->pin_tensor(name);
+    }
+    interpreter_->allocate_resources();
+  }
   for (auto &name : interpreter_->input_names) {
     input_names.append(name);
   }
@@ -90,6 +112,55 @@ void py_module::set_mem_mode(std::string mem_mode) {
   py_module::gmem_mode_str_ = mem_mode;
 }
 
+void py_module::set_lazy_weight(int64_t budget_mb) {
+  py_module::glazy_weight_budget_ =
+      budget_mb < 0 ? -1 : budget_mb * 1024 * 1024;
+}
+
+void py_module::pin_tensors(std::vector<std::string> names) {
+  py_module::gpinned_tensors_ = std::move(names);
+}
+
+void py_module::set_shared_weights(bool enable) {
+  py_module::gshared_weights_ = enable;
+}
+
+void py_module::set_blocked_layout(bool enable) {
+  interpreter_->set_blocked_layout(enable);
+}
+
+void py_module::set_parallel_workers(int num) {
+  interpreter_->set_parallel_workers(num);
+}
+
+void py_module::set_profile(bool enable) { interpreter_->set_profile(enable); }
+
+py::list py_module::get_profile() {
+  py::list py_ret;
+  for (auto &p : interpreter_->get_profile()) {
+    py::dict op;
+    op["name"] = p.name;
+    op["type"] = p.type;
+    op["flops"] = p.flops;
+    op["bytes_in"] = p.bytes_in;
+    op["bytes_out"] = p.bytes_out;
+    op["num_init"] = p.num_init;
+    op["num_inference"] = p.num_inference;
+    op["num_deinit"] = p.num_deinit;
+    op["init_us"] = p.init_us;
+    op["inference_us"] = p.inference_us;
+    op["deinit_us"] = p.deinit_us;
+    py_ret.append(op);
+  }
+  return py_ret;
+}
+
+void py_module::dump_profile_trace(const std::string &filename) {
+  if (failed(interpreter_->dump_profile_trace(filename))) {
+    throw std::runtime_error("dump_profile_trace to " + filename + " failed");
+  }
+}
+
 void py_module::set_tensor(
     std::string name,
     py::array_t<float, py::array::c_style | py::array::forcecast> data) {
@@ -117,6 +188,30 @@ py::array py_module::get_fp32_tensor(std::string name) {
   return getPyArray(std::move(tensor), shape);
 }
 
+py::array py_module::get_tensor_view(std::string name) {
+  size_t offset, size;
+  auto mem = interpreter_->getTensorView(name, offset, size);
+  auto shape = interpreter_->getTensorShape(name);
+  auto holder = new std::shared_ptr<std::vector<float>>(std::move(mem));
+  py::capsule free_holder(holder, [](void *ptr) {
+    delete reinterpret_cast<std::shared_ptr<std::vector<float>> *>(ptr);
+  });
+  py::array_t<float> view(shape, (*holder)->data() + offset, free_holder);
+  view.attr("setflags")(py::arg("write") = false);
+  return view;
+}
+
+int py_module::get_tensor_index(std::string name) {
+  return interpreter_->getTensorIndex(name);
+}
+
+py::array py_module::get_tensor_by_index(int index) {
+  auto tensor = interpreter_->getTensor(index);
+  auto shape =
+      interpreter_->getTensorShape(interpreter_->all_tensor_names[index]);
+  return getPyArray(std::move(tensor), shape);
+}
+
 struct quant_brief_info py_module::format_tensor_qinfo(std::string name) {
   struct quant_brief_info q_info;
   if (!interpreter_->getTensorQuantInfo(name, q_info.dtype, q_info.scale,
@@ -139,12 +234,112 @@ struct quant_brief_info py_module::format_tensor_qinfo(std::string name) {
 }
 
 void py_module::invoke(bool fixed_to_float) {
+  auto lock = lock_module();
+  py::gil_scoped_release release;
   interpreter_->invoke(fixed_to_float);
 }
+
+void py_module::invoke_to_disk(const std::string &filename,
+                               bool fixed_to_float) {
+  auto lock = lock_module();
+  py::gil_scoped_release release;
+  interpreter_->invoke_to_disk(filename, fixed_to_float);
+}
+
+py::dict py_module::invoke_batch(py::dict inputs, bool fixed_to_float,
+                                 std::vector<std::string> outputs) {
+  using array_t = py::array_t<float, py::array::c_style | py::array::forcecast>;
+  auto lock = lock_module();
+  if (outputs.empty()) {
+    outputs = interpreter_->output_names;
+  }
+  auto tensor_size = [&](const std::string &name) {
+    size_t size = 1;
+    for (auto dim : interpreter_->getTensorShape(name)) {
+      size *= dim;
+    }
+    return size;
+  };
+  std::vector<std::string> in_names;
+  std::vector<array_t> in_datas;
+  std::vector<size_t> in_sizes;
+  int64_t batch = -1;
+  for (auto item : inputs) {
+    auto name = item.first.cast<std::string>();
+    array_t data;
+    if (py::isinstance<py::list>(item.second) ||
+        py::isinstance<py::tuple>(item.second)) {
+      data = py::module::import("numpy")
+                 .attr("stack")(item.second)
+                 .cast<array_t>();
+    } else {
+      data = item.second.cast<array_t>();
+    }
+    auto size = tensor_size(name);
+    int64_t num = data.size() / size;
+    if (data.size() % size != 0 || (batch >= 0 && num != batch)) {
+      throw py::value_error("Tensor " + name + " sample size: " +
+                            std::to_string(size) + " , but set size: " +
+                            std::to_string(data.size()) +
+                            ", inputs must hold the same number of samples");
+    }
+    batch = num;
+    in_names.push_back(name);
+    in_datas.push_back(std::move(data));
+    in_sizes.push_back(size);
+  }
+  batch = std::max<int64_t>(batch, 0);
+
+  std::vector<array_t> out_datas;
+  std::vector<size_t> out_sizes;
+  for (auto &name : outputs) {
+    std::vector<int64_t> shape = interpreter_->getTensorShape(name);
+    shape.insert(shape.begin(), batch);
+    out_datas.emplace_back(shape);
+    out_sizes.push_back(tensor_size(name));
+  }
+  std::vector<const float *> in_ptrs;
+  std::vector<float *> out_ptrs;
+  for (auto &data : in_datas) {
+    in_ptrs.push_back(data.data());
+  }
+  for (auto &data : out_datas) {
+    out_ptrs.push_back(data.mutable_data());
+  }
+  // a loop of single invokes, the module is not rerun with a larger batch
+  // dim; ops keep their primitives and buffers between samples, so only set
+  // inputs, run and gather outputs per sample
+  {
+    py::gil_scoped_release release;
+    for (int64_t b = 0; b < batch; ++b) {
+      for (size_t i = 0; i < in_names.size(); ++i) {
+        interpreter_->setTensor(in_names[i], in_ptrs[i] + b * in_sizes[i],
+                                in_sizes[i] * sizeof(float), false);
+      }
+      interpreter_->invoke(fixed_to_float);
+      for (size_t i = 0; i < outputs.size(); ++i) {
+        auto tensor = interpreter_->getTensor(outputs[i]);
+        memcpy(out_ptrs[i] + b * out_sizes[i], tensor->data(),
+               out_sizes[i] * sizeof(float));
+      }
+    }
+  }
+  py::dict py_ret;
+  for (size_t i = 0; i < outputs.size(); ++i) {
+    py_ret[py::str(outputs[i])] = out_datas[i];
+  }
+  return py_ret;
+}
+
 void py_module::fake_quant_weight() { interpreter_->fake_quant_weight(); }
 
 py::array py_module::invoke_at(const std::string name) {
-  auto tensor = interpreter_->invoke_at(name);
+  auto lock = lock_module();
+  std::shared_ptr<std::vector<float>> tensor;
+  {
+    py::gil_scoped_release release;
+    tensor = interpreter_->invoke_at(name);
+  }
   auto shape = interpreter_->getTensorShape(name);
   return getPyArray(std::move(tensor), shape);
 }
@@ -165,5 +360,7 @@ py::array py_module::backward_weight_at(
 }
 
 void py_module::invoke_from(const std::string name) {
+  auto lock = lock_module();
+  py::gil_scoped_release release;
   interpreter_->invoke_from(name);
 }
@@ -8,12 +8,14 @@
 //===----------------------------------------------------------------------===//
 
 #include "pymlir.h"
+#include <mutex>
 
 class py_module {
 public:
   py_module() {}
   ~py_module();
-  void load(std::string filename);
+  // profile: as set_profile(true), inits done by load are timed too
+  void load(std::string filename, bool profile = false);
 
   py::dict getAllTensor();
 
@@ -24,6 +26,16 @@ public:
   void clear_hooks();
 
   static void set_mem_mode(std::string mem_mode);
+  static void set_lazy_weight(int64_t budget_mb);
+  static void pin_tensors(std::vector<std::string> names);
+  static void set_shared_weights(bool enable);
+  void set_blocked_layout(bool enable);
+  void set_parallel_workers(int num);
+
+  // per op wall time of init/inference/deinit, with flops and bytes
+  void set_profile(bool enable);
+  py::list get_profile();
+  void dump_profile_trace(const std::string &filename);
 
   void set_tensor(
       std::string name,
@@ -39,9 +51,26 @@ public:
   // Tip: not using copy in python, since independent mem
   py::array get_fp32_tensor(std::string name);
 
+  // No copy: read-only array on interpreter memory, holding a reference to
+  // it. Values are not dequantized and change on the next invoke
+  py::array get_tensor_view(std::string name);
+
+  // index of name in all_tensor_names, -1 if not an activation
+  int get_tensor_index(std::string name);
+  py::array get_tensor_by_index(int index);
+
   struct quant_brief_info format_tensor_qinfo(std::string name);
 
   void invoke(bool fixed_to_float);
+  void invoke_to_disk(const std::string &filename, bool fixed_to_float);
+
+  // convenience loop: one invoke per sample, back to back, without the
+  // python round trips in between. The module still runs with the batch
+  // size it was compiled for. Each input is an array stacked along a new
+  // leading dim or a list of N arrays; returns outputs stacked the same way.
+  // Raises ValueError when inputs do not hold the same number of samples
+  py::dict invoke_batch(py::dict inputs, bool fixed_to_float,
+                        std::vector<std::string> outputs);
   void fake_quant_weight();
 
   py::array invoke_at(const std::string name);
@@ -59,8 +88,15 @@ public:
   py::list output_names;
   static std::string version;
   static std::string gmem_mode_str_;
+  static int64_t glazy_weight_budget_;
+  static std::vector<std::string> gpinned_tensors_;
+  static bool gshared_weights_;
 
 private:
+  // load and the invokes of one module from several python threads run one
+  // at a time, other modules are not blocked
+  std::unique_lock<std::mutex> lock_module();
+  std::mutex mutex_;
   std::unique_ptr<mlir::MLIRContext> context_;
   OwningOpRef<ModuleOp> module_;
   std::string weightFilePath_;
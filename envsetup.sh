@@ -36,6 +36,10 @@ export PYTHONPATH=$PROJECT_ROOT/python:$PYTHONPATH
 export PYTHONPATH=$PROJECT_ROOT/third_party/customlayer/python:$PYTHONPATH
 
 export OMP_NUM_THREADS=4
+# cpu threads of the interpreter, split evenly among the concurrent invokes
+# declared by pymlir.set_concurrent_invokes; falls back to OMP_NUM_THREADS,
+# can be changed by pymlir.set_num_threads
+# export TPUMLIR_NUM_THREADS=4
 
 # CCache configuration
 export CCACHE_REMOTE_STORAGE=redis://10.132.3.118:6379
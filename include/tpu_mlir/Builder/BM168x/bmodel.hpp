@@ -12,6 +12,7 @@
 
 #include <stdint.h>
 #include <fstream>
+#include <functional>
 #include <map>
 #include <string>
 #include <vector>
@@ -63,6 +64,12 @@ public:
   virtual ~ModelGen();
   flatbuffers::FlatBufferBuilder &Builder();
   Binary WriteBinary(size_t size, uint8_t *data);
+  // binary not held in memory: fill is called when the model is saved, and
+  // hands the size bytes to the writer in order, piece by piece. Binaries
+  // with the same size and key (e.g. a hash of the data) are stored once
+  typedef std::function<void(const uint8_t *data, size_t size)> Writer;
+  typedef std::function<void(const Writer &writer)> Filler;
+  Binary WriteBinary(size_t size, const std::string &key, Filler fill);
 
   // add model elements
   void AddChip(const std::string &arch_name);
@@ -110,11 +117,22 @@ private:
     Binary binary;
   } CPUOP_MODULE_T;
 
+  // binaries in file order, in binary_ at mem_start or filled at save
+  typedef struct {
+    uint64_t start;
+    uint64_t size;
+    uint64_t mem_start;
+    std::string key;
+    Filler fill;
+  } BINARY_PIECE_T;
+  void WritePieces(const Writer &writer);
+
   std::string chip_;
   int num_device_;
   flatbuffers::FlatBufferBuilder builder_;
   std::vector<uint8_t> binary_;
-  std::vector<Binary> binary_vector_;
+  std::vector<BINARY_PIECE_T> pieces_;
+  uint64_t binary_size_;
   std::vector<NET_INFO_T> net_vector_;
   std::vector<flatbuffers::Offset<bmodel::Net>> nets_;
   uint64_t max_neuron_size_;
@@ -10,12 +10,41 @@
 #pragma once
 
 #include "mlir/IR/OpDefinition.h"
+#include <functional>
+#include <vector>
 
 namespace tpu_mlir {
 struct InferenceParameter {
   std::vector<float *> inputs;
   std::vector<float *> outputs;
   void *handle = nullptr;
+  // native_inputs[i]: inputs[i] holds the weight in its storage type (e.g.
+  // packed int8/int4 bytes) instead of float; empty means all float
+  std::vector<bool> native_inputs;
+  // set by init when the handle can follow inputs/outputs moved to other
+  // buffers of the same shape, without deinit and init again
+  std::function<void(InferenceParameter &)> rebind;
+  // set by init when the handle keeps no buffer of p: inference() sets up
+  // with inputs/outputs each time, so moving them needs no rebind or init
+  bool setup_in_inference = false;
+  // dnnl kernels run in blocked layouts (e.g. nChw16c), set by the
+  // interpreter before init and inference
+  bool blocked_layout = false;
+  // blocked layout handoff between adjacent dnnl ops. init sets
+  // blocked_output to the dnnl::memory the op can leave outputs[0] in, with
+  // sync_output copying it to outputs[0] (to_plain) or back, and
+  // reads_blocked_input if inputs[0] can come from such a memory
+  const void *blocked_output = nullptr;
+  std::function<void(bool to_plain)> sync_output;
+  bool reads_blocked_input = false;
+  // set by the interpreter when every user reads outputs[0] through
+  // blocked_output, which then is the only up to date copy of it
+  bool keep_blocked_output = false;
+  // set by the interpreter: blocked_output of the producer of inputs[0]
+  const void *blocked_input = nullptr;
+  // bumped by the interpreter each time a weight in inputs is written in
+  // place, handles that keep a copy of their weights set up again on change
+  uint64_t weight_version = 0;
 };
 
 } // namespace tpu_mlir
@@ -94,6 +94,12 @@ public:
   }
 
   void setup();
+  // same shapes as setup() on other buffers
+  inline void rebind(void *lhs, void *rhs, void *dst) {
+    lhs_mem.set_data_handle(lhs);
+    rhs_mem.set_data_handle(rhs);
+    dst_mem.set_data_handle(dst);
+  }
   void run();
 
 private:
@@ -101,7 +107,6 @@ private:
   bool do_relu_ = false;
   double relu_limit_ = -1;
   algorithm algorithm_;
-  stream engine_stream;
   primitive binary_prim;
   memory lhs_mem;
   memory rhs_mem;
@@ -29,7 +29,6 @@ public:
   ~Concat() = default;
 private:
   engine eng;
-  stream eng_stream;
   primitive concat_prim;
   std::unordered_map<int, memory> concat_args;
   std::vector<float *> p_inputs;
@@ -20,8 +20,35 @@ public:
   void filter_init(float *weight, conv_attr_t &attr);
   void setup(float *input, float *weight, float *bias, float *output,
              conv_attr_t attr);
+  // integer path for int8 models: input holds s8 (u8 if input_unsigned) and
+  // weight s8 values, the conv is done in s8/u8 x s8 -> s32 without bias.
+  // run() leaves the exact sums in acc() and their f32 copy in output.
+  // Returns false when dnnl can not be exact, setup() should be used then.
+  bool setup_int8(float *input, float *weight, float *output,
+                  conv_attr_t attr, bool input_unsigned);
+  // s32 sums of the last run() of the integer path, nullptr otherwise
+  const int32_t *acc() const { return acc_i32 ? acc_i32->data() : nullptr; }
   void run();
 
+  // dnnl picks blocked layouts (e.g. nChw16c): weights are reordered once by
+  // setup, activations at the boundary of the conv. Applies from the next
+  // setup()
+  void set_blocked_layout(bool enable) { blocked = enable; }
+  // blocked layout, to hand the result to the next conv: run() leaves it in
+  // blocked_dst() only, sync_dst() copies it to output (to_plain) or back
+  void keep_blocked_dst(bool keep) { keep_dst = keep; }
+  const memory *blocked_dst() const { return &prim_dst_mem; }
+  void sync_dst(bool to_plain);
+  // blocked layout: setup() reads the source from src, the blocked_dst() of
+  // the producing conv, instead of input. Only for convs that do not
+  // materialize a padded input, see reads_blocked_src
+  void set_blocked_src(const memory *src) { blocked_src = src; }
+  static bool reads_blocked_src(const conv_attr_t &attr);
+  // weight and bias are copied (reordered, zero point) by setup: a new
+  // version makes the next setup() build again after they were written in
+  // place
+  void set_weight_version(uint64_t version) { weight_version = version; }
+
   void diff_filter_init(memory::dims &filter_shape);
   void diff_bias_init(memory::dims &bias_shape);
   void diff_dst_init(memory::dims &dst_shape);
@@ -29,20 +56,34 @@ public:
 private:
   void activation_init(float *input, conv_attr_t &attr);
   void backward_weights_setup();
+  // primitive is built once per shape and weight version, later setup() with
+  // the same key only rebinds input and output so that each invoke executes
+  // the primitive
+  std::vector<int64_t> cache_key(float *weight, float *bias,
+                                 const conv_attr_t &attr);
+  void rebind(float *input, float *output);
 
 private:
   engine eng;
-  stream eng_stream;
   convolution_forward::primitive_desc conv_prim_desc;
   primitive prim;
   std::shared_ptr<std::vector<float>> bias0;
   memory src_mem, filter_mem, bias_mem, dst_mem;
+  // blocked layout: reorder(src) + conv + reorder(dst)
+  std::vector<primitive> net;
+  std::vector<std::unordered_map<int, memory>> net_args;
+  memory prim_filter_mem, prim_dst_mem;
+  bool blocked = false, keep_dst = false;
+  const memory *blocked_src = nullptr;
+  uint64_t weight_version = 0;
   memory::dims src_shape;
   memory::dims dst_shape;
   float *p_input, *p_weight;
   float *origin_input, *origin_weight;
   std::shared_ptr<std::vector<float>> input_after_pad, weight_after_zp;
+  std::shared_ptr<std::vector<int32_t>> acc_i32;
   conv_attr_t _attr;
+  std::vector<int64_t> prim_key;
 
   bool backw_init;
   std::vector<primitive> net_bw;
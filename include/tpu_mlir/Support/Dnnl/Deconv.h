@@ -23,16 +23,21 @@ public:
              const deconv_attr_t &attr, int izp = 0);
 
   void run();
+  // the filter is rotated and reordered by setup: a new version makes the
+  // next setup() build again after weight or bias were written in place
+  void set_weight_version(uint64_t version) { weight_version = version; }
 
 private:
   void pad_init(float *input, deconv_attr_t &attr, int izp);
+  std::vector<int64_t> cache_key(float *input, float *weight, float *bias,
+                                 float *output, const deconv_attr_t &attr,
+                                 int izp);
 
 public:
   int kd, kh, kw;
 
 private:
   engine eng;
-  stream eng_stream;
   std::vector<primitive> net;
   std::vector<std::unordered_map<int, memory>> net_args;
   deconvolution_forward::primitive_desc deconv_prim_desc;
@@ -47,6 +52,8 @@ private:
   std::shared_ptr<std::vector<float>> weight_rotated;
   deconv_attr_t _attrs;
   int _izp;
+  std::vector<int64_t> prim_key;
+  uint64_t weight_version = 0;
 };
 
 std::optional<llvm::SmallVector<float, 4>>
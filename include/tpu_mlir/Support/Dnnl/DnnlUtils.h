@@ -14,4 +14,13 @@ using namespace dnnl;
 namespace tpu_mlir {
 
 void post_relu(primitive_attr &attr, bool &do_relu, double &relu_limit);
+
+// cpu engine shared by all dnnl kernels of the process
+const engine &dnnl_engine();
+// in-order stream on dnnl_engine(), one per calling thread
+stream &dnnl_stream();
+
+// whether the s8/u8 x s8 -> s32 kernels of dnnl are exact on this cpu: without
+// vnni they sum u8*s8 pairs in s16 (vpmaddubsw), which may saturate
+bool dnnl_exact_int8();
 } // namespace tpu_mlir
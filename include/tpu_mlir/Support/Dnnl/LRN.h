@@ -63,7 +63,6 @@ private:
   float alpha_, beta_, bias_;
   algorithm algorithm_;
   int64_t size_;
-  stream engine_stream;
   primitive lrn_prim;
   memory src_mem;
   memory dst_mem;
@@ -34,14 +34,36 @@ public:
              int64_t input_zp, bool right_transpose, bool input_transpose,
              bool output_transpose, bool hdim_is_batch, const std::vector<int64_t> &L_shape={},
              const std::vector<int64_t> &R_shape={}, int dims_merge_2_M=0);
+  // integer path for the next setup(): left holds s8 (u8 if left_unsigned)
+  // and right s8 values, the product is done in s8/u8 x s8 -> s32 with
+  // input_zp as dnnl zero point, bias and relu are added in s32 by run().
+  // setup() keeps f32 where that can not be exact, see acc().
+  // right_const: right is a weight, reordered to s8 once by setup() (and by
+  // rebind() to another buffer) instead of every run()
+  void set_int8(bool enable, bool left_unsigned = false,
+                bool right_const = false);
+  // same shapes as setup() on other buffers; bias nullptr keeps the zeros
+  void rebind(float *left, float *right, float *bias, float *output);
+  // s32 results of the last run() of the integer path, nullptr otherwise
+  const int32_t *acc() const { return acc_i32 ? acc_i32->data() : nullptr; }
   void run();
 
 private:
+  // transpose (if any) and reorder of a constant right into prim_weight_mem
+  void reorder_right();
   engine eng;
-  stream engine_stream;
   primitive prim;
   dnnl::memory src_mem, weight_mem, bias_mem, dst_mem;
   std::shared_ptr<std::vector<float>> bias0;
+  // integer path: reorder(src) + reorder(weight) + matmul into acc_i32, the
+  // weight reorder is left out of net for a constant right
+  std::vector<primitive> net;
+  std::vector<std::unordered_map<int, memory>> net_args;
+  dnnl::memory src_zp_mem, prim_weight_mem;
+  std::shared_ptr<std::vector<int32_t>> acc_i32;
+  float *p_bias = nullptr;
+  bool int8_ = false, int8_unsigned_ = false, do_relu_ = false;
+  bool right_const_ = false, right_reordered_ = false;
   float *p_right, *p_input;
   float *origin_input, *origin_right, *origin_output;
   std::shared_ptr<std::vector<float>> right_after_init;
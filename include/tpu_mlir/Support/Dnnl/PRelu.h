@@ -46,7 +46,6 @@ public:
   void run();
 private:
   engine eng;
-  stream eng_stream;
   memory::dims src_shape;
   memory::dims dst_shape;
   primitive prelu_prim;
@@ -21,6 +21,8 @@ public:
   ~Pooling();
   void setup(float *input, float *output, pool_attr_t attr, bool is_avg,
              int izp = 0);
+  // same shapes as setup() on other buffers
+  void rebind(float *input, float *output);
   void run();
 
 private:
@@ -31,7 +33,6 @@ public:
 
 private:
   engine eng;
-  stream eng_stream;
   primitive prim;
   memory src_mem, dst_mem;
   memory::dims src_shape;
@@ -29,7 +29,6 @@ public:
   ~Softmax() = default;
 private:
   engine eng;
-  stream eng_stream;
   primitive softmax_prim;
   std::unordered_map<int, memory> softmax_args;
   float *p_input;
@@ -0,0 +1,59 @@
+//===----------------------------------------------------------------------===//
+//
+// Copyright (C) 2022 Sophgo Technologies Inc.  All rights reserved.
+//
+// TPU-MLIR is licensed under the 2-Clause BSD License except for the
+// third-party components.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+#include "tpu_mlir/Support/AttrStruct.h"
+#include "tpu_mlir/Support/Dnnl/MatMul.h"
+
+namespace tpu_mlir {
+
+// Winograd F(2x2, 3x3) conv as run by the BM1684 int8 kernels. weight holds
+// the oc x ic 3x3 filters followed by their 4x4 transformed ones; output gets
+// the sums before bias and requant.
+// Workspace lives in the object, setup() with the same shape and weight version
+// only takes the new input and output so that each invoke only runs the
+// transforms and gemms.
+class Winograd {
+public:
+  void setup(float *input, float *weight, float *output, conv_attr_t attr);
+  void run();
+  // the filters are transposed by setup: a new version makes the next setup()
+  // take them again after the weight was written in place
+  void set_weight_version(uint64_t version) { weight_version = version; }
+
+private:
+  // B^T @ d @ B of every 4x4 tile of one padded image
+  void input_transform(const float *image);
+  // per tile element, tiles [row_num, ic] @ filters [ic, oc]
+  void tile_gemm();
+  // 2x2 results of the tiles back to the output of one image
+  void output_fold(float *output);
+
+private:
+  conv_attr_t _attr;
+  std::vector<int64_t> prim_key;
+  uint64_t weight_version = 0;
+  float *p_input, *p_output;
+  bool need_pad;
+  int64_t pih, piw, window_h, window_w, row_num;
+  // padded image, borders are written once by setup()
+  std::vector<float> padded;
+  // [row_num, ic, 16]
+  std::vector<float> tiles;
+  // B^T @ d of a tile row, [threads, 4, piw]
+  std::vector<float> rows;
+  // transformed filters, [ic, oc, 16]
+  std::vector<float> filter;
+  // [row_num, oc, 16]
+  std::vector<float> prod;
+  // A^T @ prod @ A, [row_num, oc, 4]
+  std::vector<float> result;
+  std::shared_ptr<MatMul> output_matmul;
+};
+} // namespace tpu_mlir
@@ -0,0 +1,56 @@
+//===----------------------------------------------------------------------===//
+//
+// Copyright (C) 2022 Sophgo Technologies Inc.  All rights reserved.
+//
+// TPU-MLIR is licensed under the 2-Clause BSD License except for the
+// third-party components.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include "tpu_mlir/Support/Float16.h"
+#include "tpu_mlir/Support/Float8.h"
+#include "tpu_mlir/Support/MathUtils.h"
+
+namespace tpu_mlir {
+
+// =======================
+// instruction set of the bulk conversions
+// =======================
+typedef enum {
+  CONVERT_SCALAR = 0,  // per element reference functions
+  CONVERT_GENERIC = 1, // lane kernels for the baseline of the build
+  CONVERT_AVX2 = 2,
+  CONVERT_AVX512 = 3,
+} ConvertISA;
+
+// best instruction set supported by the running cpu
+ConvertISA supported_convert_isa();
+// instruction set used by the bulk conversions, the supported one by default
+ConvertISA convert_isa();
+// use isa (capped by the supported one), for tests and benchmarks
+void set_convert_isa(ConvertISA isa);
+
+/*
+convert f32 to f16/bf16/f8 and back to f32 with the given rounding mode,
+per element reference
+*/
+float F16(float src, RoundingMode round_mode);
+float BF16(float src, RoundingMode round_mode);
+float F8E4M3(float src, float step, bool satu, RoundingMode round_mode);
+// satu is ignored as f32_to_f8e5m2
+float F8E5M2(float src, float step, bool satu, RoundingMode round_mode);
+
+/*
+bulk versions of the above, bit identical with the reference for every
+rounding mode, in place is allowed
+*/
+void F16(float *p_src, float *p_dst, int num, RoundingMode round_mode);
+void BF16(float *p_src, float *p_dst, int num, RoundingMode round_mode);
+void F8E4M3(const float *p_src, float *p_dst, int num, float step, bool satu,
+            RoundingMode round_mode);
+void F8E5M2(const float *p_src, float *p_dst, int num, float step, bool satu,
+            RoundingMode round_mode);
+
+} // namespace tpu_mlir
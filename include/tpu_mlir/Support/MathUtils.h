@@ -64,6 +64,29 @@ static inline auto align_up(U x, V a) -> decltype(x + a) {
 // =======================
 int omp_schedule(int count);
 
+// Total threads the cpu kernels (openmp loops and dnnl) may use. Defaults to
+// env TPUMLIR_NUM_THREADS, or OMP_NUM_THREADS when that is not set; 0 resets.
+void set_num_threads(int num);
+int get_num_threads();
+
+// Number of threads the caller declares to invoke concurrently, 1 by default.
+void set_concurrent_invokes(int num);
+int get_concurrent_invokes();
+
+// Held by an interpreter for the duration of one invoke: runs it with a fixed
+// share of get_num_threads(), divided by get_concurrent_invokes(), so several
+// python workers do not each fork a full openmp team and an invoke gets the
+// same team size whatever else runs. The team size of the calling thread is
+// restored on destruction.
+class ThreadBudget {
+public:
+  ThreadBudget();
+  ~ThreadBudget();
+
+private:
+  int saved_threads;
+};
+
 void function_relu(float *src, float *dst, int64_t size, float relu_limit = 0.f,
                    mlir::Type elem_type = nullptr);
 
@@ -129,6 +152,40 @@ int64_t applyMultiplierAndRShift(
     tpu::RequantMode qmode = tpu::RequantMode::MultiplierShift,
     RoundingMode rmode = ROUNDING_HALF_UP);
 
+// requant of a buffer of ints held in floats:
+//   dst[i] = saturate(requant((int64_t)(src[i] + in_offset)) + out_zp)
+// where requant is applyMultiplierAndRShift for MultiplierShift/OnlyShift,
+// and MultiplyByQuantizedMultiplier(x, multiplier, shift) for QDM/TFLite.
+// Mode, rounding and output range are resolved once by get_requant_kernel,
+// results match the scalar functions bit for bit.
+// The int32 overload takes s32 accumulators of the integer dnnl kernels, the
+// offset is added in int64 there.
+struct RequantKernel {
+  typedef void (*fn_t)(const float *src, float *dst, int64_t len,
+                       float in_offset, int64_t multiplier, int64_t shift,
+                       int64_t out_zp, int64_t lo, int64_t hi);
+  typedef void (*fn_i32_t)(const int32_t *src, float *dst, int64_t len,
+                           int32_t in_offset, int64_t multiplier,
+                           int64_t shift, int64_t out_zp, int64_t lo,
+                           int64_t hi);
+  fn_t fn;
+  fn_i32_t fn_i32;
+  // range of the storage type, lo raised to the zero point with relu
+  int64_t lo, hi;
+  void operator()(const float *src, float *dst, int64_t len, float in_offset,
+                  int64_t multiplier, int64_t shift, int64_t out_zp) const {
+    fn(src, dst, len, in_offset, multiplier, shift, out_zp, lo, hi);
+  }
+  void operator()(const int32_t *src, float *dst, int64_t len,
+                  int32_t in_offset, int64_t multiplier, int64_t shift,
+                  int64_t out_zp) const {
+    fn_i32(src, dst, len, in_offset, multiplier, shift, out_zp, lo, hi);
+  }
+};
+RequantKernel get_requant_kernel(tpu::RequantMode qmode, RoundingMode rmode,
+                                 mlir::Type o_sType, bool do_relu = false,
+                                 int64_t out_zp = 0);
+
 void pad_tensor(float *p_after_pad, float *src, int n, int c, int h, int w,
                 int pt, int pb, int pl, int pr, float pad_value);
 void pad_tensor(float *p_after_pad, float *src, int n, int c, int d, int h,
@@ -57,6 +57,28 @@ namespace module {
 // init module by ModuleOp in init pass
 void init(ModuleOp module);
 
+// State of the helpers below (module, chip, platform, weight file). One per
+// process by default, set by init(). A session holds its own, so that modules
+// can run in parallel threads; SessionGuard binds it to a thread while alive.
+struct Session;
+// new session inited by module. share_weight_file: the weight file is read
+// only and shared with other sessions reading the same one
+std::shared_ptr<Session> createSession(ModuleOp module,
+                                       bool share_weight_file = false);
+// session only, not the process one: map its weight file and read tensors
+// on demand instead of loading it all. The file is reopened on next use
+void setWeightFileLazy(Session *session, bool lazy);
+class SessionGuard {
+public:
+  explicit SessionGuard(Session *session);
+  ~SessionGuard();
+  SessionGuard(const SessionGuard &) = delete;
+  SessionGuard &operator=(const SessionGuard &) = delete;
+
+private:
+  Session *prev;
+};
+
 //-----------------------------------------------------------------
 // Helper for debug information
 //-----------------------------------------------------------------
@@ -246,6 +268,9 @@ mlir::TensorFile &weightFile();
 void setWeightFileName(const std::string &name);
 void saveWeight();
 void detachWeightFile();
+// real path and modification time of the weight file, to share what is read
+// from it between modules
+std::string getWeightFileId();
 
 //-----------------------------------------------------------------
 // Helper Functions for apply pattern only once
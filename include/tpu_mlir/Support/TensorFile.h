@@ -19,7 +19,9 @@
 #include "mlir/IR/OpDefinition.h"
 #include "mlir/Support/LogicalResult.h"
 #include "llvm/ADT/Twine.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Format.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/raw_ostream.h"
 
@@ -30,14 +32,46 @@
 #include <string>
 #include <system_error>
 #include <type_traits>
+#include <unordered_map>
 
 #include <iomanip>
 
 namespace mlir {
 
+/// Weight pack: uncompressed alternative to npz that is mapped instead of
+/// loaded, used when the file name ends with TensorFile::packExtension.
+/// Little endian:
+///   header: "TPUMLIRW", u32 version, u32 number of tensors, u64 index offset
+///   tensor data, each aligned to packAlignment bytes, row major
+///   index, per tensor: u32 name size, name, u8 npy type char, u8 word size,
+///   u16 number of dims, u64 dims, u64 data offset, u64 data size, u64
+///   xxHash64 of the data (not in version 1, hashed on the first add)
+/// Tensors with equal data point to the same bytes, in the pack and in
+/// memory: adding or cloning a tensor equal to one in the file only adds a
+/// name. Updating a tensor never changes the ones sharing its data.
+/// Across passes, data is only shared by the pack being cloned to the file
+/// of the next pass (shared extents on reflink file systems). npz weight
+/// files, the default of the tool flow, are written whole by every pass;
+/// see --weight_pack of model_deploy.
+/// Saving a weight pack over the one it was opened from (or to a kernel copy
+/// of it) only appends the new and updated tensors and a new index; deleted
+/// tensors are left out of the index. The file is rewritten whole once the
+/// unreferenced bytes would exceed packGarbageRatio of it
 class TensorFile {
 public:
-  TensorFile(llvm::StringRef filename, bool readOnly, bool newCreate = false);
+  static constexpr llvm::StringLiteral packExtension = ".mlirw";
+  static constexpr size_t packAlignment = 64;
+  static constexpr double packGarbageRatio = 0.5;
+
+  /// lazy: map the file instead of loading it, tensors are copied out of the
+  /// mapping when read; the whole file is loaded before any modification.
+  /// Weight packs are always mapped, only modified tensors are loaded. Zip64
+  /// npz (entries of 4GiB and more) can't be mapped and fail to open lazy
+  TensorFile(llvm::StringRef filename, bool readOnly, bool newCreate = false,
+             bool lazy = false);
+
+  /// npz <-> weight pack, by the extension of dst
+  static LogicalResult convert(llvm::StringRef src, llvm::StringRef dst);
 
   ~TensorFile();
 
@@ -71,6 +105,7 @@ public:
   /// read a tensor from file
   /// if the name is not found, return failure()
   /// type is provided for checking, return failure() if type does not match
+  /// reads do not modify the file, threads may read it concurrently
   template <typename T>
   LogicalResult readTensor(llvm::StringRef name, T *data, size_t count,
                            bool isINT4, bool do_compress);
@@ -78,11 +113,18 @@ public:
   std::unique_ptr<std::vector<T>>
   readTensor(llvm::StringRef name, RankedTensorType &type, uint32_t store_mode, bool do_compress = false);
 
+  /// data of a tensor without copy, in the mapping of the file. Empty if it
+  /// is not mapped: npz not opened lazy, compressed or column major, or the
+  /// tensor was modified. Valid until the TensorFile is saved or destroyed.
+  /// Ops read it through WeightOp::view
+  llvm::ArrayRef<char> view(llvm::StringRef name) const;
+
   /// delete a tensor from file
   /// if the name is not found, return failure()
   LogicalResult deleteTensor(const llvm::StringRef name);
 
   void getAllNames(std::set<StringRef> &names);
+  bool hasTensor(llvm::StringRef name) const;
 
   /// read all tensor from file
   template <typename T>
@@ -94,15 +136,72 @@ public:
 
   template <typename T>
   void colMajorToRowMajor(T &des, const cnpy::NpyArray &src);
+  /// in weight pack format if file (or the current name) ends with
+  /// packExtension, in npz otherwise
   void save(const std::string &file = "");
 
 private:
   /// load the file
   LogicalResult load(void);
+  /// map the file and index its (uncompressed) arrays
+  LogicalResult load_lazy(void);
+  /// map a weight pack and read its index
+  LogicalResult load_pack(void);
+  void save_pack(void);
+  /// append to pack_file, false if it has to be rewritten
+  bool append_pack(void);
+  /// data written to a pack by a save, by hash
+  struct PackBlob {
+    uint64_t offset;
+    const char *data;
+    uint64_t num_bytes;
+  };
+  using PackBlobs = std::unordered_multimap<uint64_t, PackBlob>;
+  /// write the data of a tensor at pos aligned, unless it is in written
+  /// already, and its index entry
+  void write_pack_tensor(std::ostream &out, uint64_t &pos,
+                         llvm::StringRef name, std::string &index,
+                         PackBlobs &written);
+  static void add_pack_entry(std::string &index, llvm::StringRef name,
+                             char type, size_t word_size,
+                             const std::vector<size_t> &shape,
+                             uint64_t offset, uint64_t num_bytes,
+                             uint64_t hash);
+  /// move mapped arrays into map, all of them if name is empty
+  void materialize(llvm::StringRef name = "");
+
+  struct LazyArray {
+    size_t offset; // of data in the file
+    std::vector<size_t> shape;
+    size_t word_size;
+    char type;
+    bool fortran_order;
+    size_t num_bytes;
+    uint64_t hash = 0;
+    bool hashed = false; // from the index of weight packs since version 2
+  };
+  /// copy of a mapped array
+  cnpy::NpyArray lazy_array(const LazyArray &arr) const;
+  uint64_t blob_hash(LazyArray &arr);
+  /// point the tensor name of map to equal data already in the file, or
+  /// register its data to be found by the next ones
+  void share_blob(const std::string &name);
 
   std::string filename;
   bool readOnly;
   cnpy::npz_t map;
+  std::unique_ptr<llvm::MemoryBuffer> buffer;
+  std::map<std::string, LazyArray> lazy_map;
+  /// names by hash of their data, checked when found
+  std::unordered_multimap<uint64_t, std::string> blobs;
+  /// mapped arrays without a hash yet are left out of blobs
+  bool blobs_pending = false;
+  /// weight pack mapped in buffer and its size, identity and modification
+  /// time then, empty for npz
+  std::string pack_file;
+  uint64_t pack_size = 0;
+  llvm::sys::fs::UniqueID pack_id;
+  llvm::sys::TimePoint<> pack_mtime;
   std::atomic<int> cnt_del = {0};
   std::atomic<int> cnt_add = {0};
   std::atomic<int> cnt_update = {0};
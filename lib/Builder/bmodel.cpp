@@ -43,6 +43,7 @@ const uint32_t BMODEL_MAGIC = 0xFF55AAEE;
 
 ModelGen::ModelGen(uint32_t reserved_size) {
   binary_.reserve(reserved_size);
+  binary_size_ = 0;
   max_neuron_size_ = 0;
   num_device_ = 0;
 }
@@ -53,22 +54,51 @@ ModelGen::~ModelGen() { builder_.Release(); }
 
 Binary ModelGen::WriteBinary(size_t size, uint8_t *data) {
   // ASSERT(size != 0 && data != NULL);
-  for (auto &binary : binary_vector_) {
-    if (binary.size() != size) {
+  for (auto &piece : pieces_) {
+    if (piece.fill || piece.size != size) {
       continue;
     }
-    if (memcmp(data, binary_.data() + binary.start(), size) == 0) {
-      return binary;
+    if (memcmp(data, binary_.data() + piece.mem_start, size) == 0) {
+      return Binary(piece.start, size);
     }
   }
-  uint64_t start = binary_.size();
+  uint64_t mem_start = binary_.size();
   binary_.insert(binary_.end(), size, 0);
-  memcpy(binary_.data() + start, data, size);
-  Binary new_bin(start, size);
-  binary_vector_.push_back(new_bin);
+  memcpy(binary_.data() + mem_start, data, size);
+  Binary new_bin(binary_size_, size);
+  pieces_.push_back({binary_size_, size, mem_start, "", nullptr});
+  binary_size_ += size;
   return new_bin;
 }
 
+Binary ModelGen::WriteBinary(size_t size, const string &key, Filler fill) {
+  for (auto &piece : pieces_) {
+    if (piece.fill && piece.size == size && piece.key == key) {
+      return Binary(piece.start, size);
+    }
+  }
+  Binary new_bin(binary_size_, size);
+  pieces_.push_back({binary_size_, size, 0, key, std::move(fill)});
+  binary_size_ += size;
+  return new_bin;
+}
+
+void ModelGen::WritePieces(const Writer &writer) {
+  for (auto &piece : pieces_) {
+    if (!piece.fill) {
+      writer(binary_.data() + piece.mem_start, piece.size);
+      continue;
+    }
+    uint64_t written = 0;
+    piece.fill([&](const uint8_t *data, size_t size) {
+      ASSERT(written + size <= piece.size);
+      writer(data, size);
+      written += size;
+    });
+    ASSERT(written == piece.size);
+  }
+}
+
 void ModelGen::AddNet(const flatbuffers::Offset<bmodel::Net> &net) {
   nets_.push_back(net);
 }
@@ -337,7 +367,7 @@ size_t ModelGen::Finish() {
   builder_.Finish(model);
 
   // return size
-  size_t size = sizeof(MODEL_HEADER_T) + builder_.GetSize() + binary_.size();
+  size_t size = sizeof(MODEL_HEADER_T) + builder_.GetSize() + binary_size_;
   return size;
 }
 
@@ -356,11 +386,17 @@ void ModelGen::Save(const string &filename) {
   header.magic = BMODEL_MAGIC;
   header.header_size = sizeof(header);
   header.flatbuffers_size = builder_.GetSize();
-  header.binary_size = binary_.size();
+  header.binary_size = binary_size_;
   fout.write((char *)&header, sizeof(header));
   fout.write((char *)builder_.GetBufferPointer(), builder_.GetSize());
-  fout.write((char *)binary_.data(), binary_.size());
+  WritePieces([&](const uint8_t *data, size_t size) {
+    fout.write((const char *)data, size);
+  });
   fout.close();
+  if (!fout) {
+    BMODEL_LOG(FATAL) << "Save file[" << filename << "] failed." << std::endl;
+    exit(-1);
+  }
 }
 
 void ModelGen::Save(void *buffer) {
@@ -370,11 +406,14 @@ void ModelGen::Save(void *buffer) {
   p_header->magic = BMODEL_MAGIC;
   p_header->header_size = sizeof(MODEL_HEADER_T);
   p_header->flatbuffers_size = builder_.GetSize();
-  p_header->binary_size = binary_.size();
+  p_header->binary_size = binary_size_;
   uint8_t *p_flb = (uint8_t *)buffer + p_header->header_size;
   memcpy(p_flb, builder_.GetBufferPointer(), p_header->flatbuffers_size);
   uint8_t *p_binary = p_flb + p_header->flatbuffers_size;
-  memcpy(p_binary, binary_.data(), p_header->binary_size);
+  WritePieces([&](const uint8_t *data, size_t size) {
+    memcpy(p_binary, data, size);
+    p_binary += size;
+  });
 }
 
 ModelCtx::ModelCtx(const string &filename)
@@ -94,6 +94,9 @@ LogicalResult top::AvgPoolOp::init(InferenceParameter &p) {
   auto attr = parseParam();
   pooling->setup(p.inputs[0], p.outputs[0], attr, true);
   p.handle = (void *)pooling;
+  p.rebind = [](InferenceParameter &p) {
+    ((Pooling *)p.handle)->rebind(p.inputs[0], p.outputs[0]);
+  };
   return success();
 }
 
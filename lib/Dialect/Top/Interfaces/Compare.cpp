@@ -44,6 +44,9 @@ LogicalResult top::CompareOp::init(InferenceParameter &p) {
       .setup();
 
   p.handle = (void *)binary;
+  p.rebind = [](InferenceParameter &p) {
+    ((Binary *)p.handle)->rebind(p.inputs[0], p.inputs[1], p.outputs[0]);
+  };
 
   return success();
 }
@@ -95,16 +95,27 @@ int64_t top::ConvOp::getFLOPs() {
          (attr.kd * attr.kh * attr.kw * attr.ic / attr.groups * 2 + extra);
 }
 
+// attributes are parsed once by init
+struct ConvHandle {
+  Conv conv;
+  conv_attr_t attr;
+};
+
 LogicalResult top::ConvOp::init(InferenceParameter &p) {
-  auto conv = new Conv();
-  p.handle = (void *)conv;
+  auto h = new ConvHandle();
+  h->attr = parseParam();
+  p.handle = (void *)h;
+  p.blocked_output = h->conv.blocked_dst();
+  p.sync_output = [h](bool to_plain) { h->conv.sync_dst(to_plain); };
+  p.reads_blocked_input = Conv::reads_blocked_src(h->attr);
+  p.setup_in_inference = true;
   return success();
 }
 
 void top::ConvOp::deinit(InferenceParameter &p) {
   if (p.handle != nullptr) {
-    auto conv = (Conv *)p.handle;
-    delete conv;
+    auto h = (ConvHandle *)p.handle;
+    delete h;
     p.handle = nullptr;
   }
 }
@@ -113,10 +124,14 @@ LogicalResult top::ConvOp::inference(InferenceParameter &p) {
   if (p.handle == nullptr) {
     return failure();
   }
-  auto conv = (Conv *)p.handle;
-  auto attr = parseParam();
-  conv->setup(p.inputs[0], p.inputs[1], p.inputs[2], p.outputs[0], attr);
-  conv->run();
+  auto h = (ConvHandle *)p.handle;
+  h->conv.set_blocked_layout(p.blocked_layout);
+  h->conv.keep_blocked_dst(p.keep_blocked_output);
+  h->conv.set_blocked_src((const memory *)p.blocked_input);
+  h->conv.set_weight_version(p.weight_version);
+  // only rebinds the buffers once the primitive is built
+  h->conv.setup(p.inputs[0], p.inputs[1], p.inputs[2], p.outputs[0], h->attr);
+  h->conv.run();
   return success();
 }
 
@@ -125,8 +140,8 @@ LogicalResult top::ConvOp::backward_weight(InferenceParameter &p,
   if (p.handle == nullptr) {
     return failure();
   }
-  auto conv = (Conv *)p.handle;
-  conv->run_backw(p_back.inputs[0], p_back.outputs[0]);
+  auto h = (ConvHandle *)p.handle;
+  h->conv.run_backw(p_back.inputs[0], p_back.outputs[0]);
 
   return success();
 }
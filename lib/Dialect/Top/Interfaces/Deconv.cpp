@@ -97,16 +97,24 @@ int64_t top::DeconvOp::getFLOPs() {
          (attr.kw * attr.kw * attr.oc / attr.g * 2 + extra);
 }
 
+// attributes parsed once by init
+struct DeconvHandle {
+  Deconv deconv;
+  deconv_attr_t attr;
+};
+
 LogicalResult top::DeconvOp::init(InferenceParameter &p) {
-  auto deconv = new Deconv();
-  p.handle = (void *)deconv;
+  auto handle = new DeconvHandle();
+  handle->attr = parseParam();
+  p.handle = (void *)handle;
+  p.setup_in_inference = true;
   return success();
 }
 
 void top::DeconvOp::deinit(InferenceParameter &p) {
   if (p.handle != nullptr) {
-    auto deconv = (Deconv *)p.handle;
-    delete deconv;
+    auto handle = (DeconvHandle *)p.handle;
+    delete handle;
     p.handle = nullptr;
   }
 }
@@ -115,10 +123,12 @@ LogicalResult top::DeconvOp::inference(InferenceParameter &p) {
   if (p.handle == nullptr) {
     return failure();
   }
-  auto deconv = (Deconv *)p.handle;
-  auto attr = parseParam();
-  deconv->setup(p.inputs[0], p.inputs[1], p.inputs[2], p.outputs[0], attr);
-  deconv->run();
+  auto handle = (DeconvHandle *)p.handle;
+  auto &deconv = handle->deconv;
+  deconv.set_weight_version(p.weight_version);
+  deconv.setup(p.inputs[0], p.inputs[1], p.inputs[2], p.outputs[0],
+               handle->attr);
+  deconv.run();
   return success();
 }
 
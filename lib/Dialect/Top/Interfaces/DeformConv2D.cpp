@@ -64,16 +64,16 @@ int64_t top::DeformConv2DOp::getFLOPs() {
 }
 
 LogicalResult top::DeformConv2DOp::init(InferenceParameter &p) {
-  auto num = module::getNumElements(getOutput());
-  float* buffer = new float[num];
-  p.handle = (void *)buffer;
+  // attributes parsed once, the buffers are taken from p by inference
+  p.handle = (void *)new deform_conv2d_attr_t(parseParam());
+  p.setup_in_inference = true;
   return success();
 }
 
 void top::DeformConv2DOp::deinit(InferenceParameter &p) {
   if (p.handle != nullptr) {
-    float* buffer = (float*) p.handle;
-    delete[] buffer;
+    auto attr = (deform_conv2d_attr_t *)p.handle;
+    delete attr;
     p.handle = nullptr;
   }
 }
@@ -82,8 +82,8 @@ LogicalResult top::DeformConv2DOp::inference(InferenceParameter &p) {
   if (p.handle == nullptr) {
     return failure();
   }
-  auto attr = parseParam();
-  processDeformConv2D(p, attr);
+  auto attr = (deform_conv2d_attr_t *)p.handle;
+  processDeformConv2D(p, *attr);
   return success();
 }
 
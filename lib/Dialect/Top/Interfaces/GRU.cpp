@@ -57,25 +57,30 @@ gru_attr_t top::GRUOp::parseParam() {
   return attr;
 }
 
+// attributes parsed once by init
+struct GRUHandle {
+  gru_attr_t attr;
+  // torch Y is computed in [seq, dir, batch, hidden], then permuted
+  std::vector<float> buffer;
+};
+
 LogicalResult top::GRUOp::init(InferenceParameter &p) {
-  if (!module::isPlatform(module::Platform::TORCH)) {
-    return success();
-  }
-  auto attr = parseParam();
-  if (attr.output_y == false || attr.batch_size == 1 ||
-      attr.num_direction == 1) {
-    return success();
+  auto handle = new GRUHandle();
+  handle->attr = parseParam();
+  auto &attr = handle->attr;
+  if (module::isPlatform(module::Platform::TORCH) && attr.output_y &&
+      attr.batch_size != 1 && attr.num_direction != 1) {
+    handle->buffer.resize(module::getNumElements(getY()));
   }
-  auto num = module::getNumElements(getY());
-  float *buffer = new float[num];
-  p.handle = (void *)buffer;
+  p.handle = (void *)handle;
+  p.setup_in_inference = true;
   return success();
 }
 
 void top::GRUOp::deinit(InferenceParameter &p) {
   if (p.handle) {
-    float *buffer = (float *)p.handle;
-    delete[] buffer;
+    auto handle = (GRUHandle *)p.handle;
+    delete handle;
     p.handle = nullptr;
   }
 }
@@ -92,7 +97,8 @@ static void gru_compute(InferenceParameter &p, const gru_attr_t &attr,
   //(TODO) num_layers > 1
   // input += seq_length * batch * input_size * num_layer; //(TODO check!)
   float *input = p.inputs[0];
-  float *output = p.handle != nullptr ? (float *)p.handle : p.outputs[0];
+  auto &buffer = ((GRUHandle *)p.handle)->buffer;
+  float *output = buffer.empty() ? p.outputs[0] : buffer.data();
   float *x_wz = p.inputs[1];
   float *h_wz = p.inputs[2];
   float *x_bz = bias;
@@ -188,7 +194,11 @@ static void gru_compute(InferenceParameter &p, const gru_attr_t &attr,
 }
 
 LogicalResult top::GRUOp::inference(InferenceParameter &p) {
-  auto attr = parseParam();
+  if (p.handle == nullptr) {
+    return failure();
+  }
+  auto handle = (GRUHandle *)p.handle;
+  auto &attr = handle->attr;
 
   auto h0_buffer = std::make_shared<std::vector<float>>(
       attr.num_direction * attr.batch_size * attr.hidden_size, 0.0f);
@@ -208,9 +218,9 @@ LogicalResult top::GRUOp::inference(InferenceParameter &p) {
   if (attr.num_direction == 2) {
     gru_compute(p, attr, B, initial_h, false);
   }
-  if (p.handle) {
-    float *buffer = (float *)p.handle;
-    function_permute(buffer, p.outputs[0],
+  auto &buffer = handle->buffer;
+  if (!buffer.empty()) {
+    function_permute(buffer.data(), p.outputs[0],
                      {1, attr.seq_len, attr.num_direction, attr.batch_size,
                       attr.hidden_size},
                      {0, 1, 3, 2, 4});
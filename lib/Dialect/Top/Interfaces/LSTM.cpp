@@ -60,25 +60,30 @@ lstm_attr_t top::LSTMOp::parseParam() {
   return attr;
 }
 
+// attributes parsed once by init
+struct LSTMHandle {
+  lstm_attr_t attr;
+  // torch Y is computed in [seq, dir, batch, hidden], then permuted
+  std::vector<float> buffer;
+};
+
 LogicalResult top::LSTMOp::init(InferenceParameter &p) {
-  if (!module::isPlatform(module::Platform::TORCH)) {
-    return success();
-  }
-  auto attr = parseParam();
-  if (attr.output_y == false || attr.batch_size == 1 ||
-      attr.num_direction == 1) {
-    return success();
+  auto handle = new LSTMHandle();
+  handle->attr = parseParam();
+  auto &attr = handle->attr;
+  if (module::isPlatform(module::Platform::TORCH) && attr.output_y &&
+      attr.batch_size != 1 && attr.num_direction != 1) {
+    handle->buffer.resize(module::getNumElements(getY()));
   }
-  auto num = module::getNumElements(getY());
-  float *buffer = new float[num];
-  p.handle = (void *)buffer;
+  p.handle = (void *)handle;
+  p.setup_in_inference = true;
   return success();
 }
 
 void top::LSTMOp::deinit(InferenceParameter &p) {
   if (p.handle) {
-    float *buffer = (float *)p.handle;
-    delete[] buffer;
+    auto handle = (LSTMHandle *)p.handle;
+    delete handle;
     p.handle = nullptr;
   }
 }
@@ -95,7 +100,8 @@ static void lstm_compute(InferenceParameter &p, const lstm_attr_t &attr,
   //(TODO) num_layers > 1
   // input += seq_length * batch * input_size * num_layer; //(TODO check!)
   float *input = p.inputs[0];
-  float *output = p.handle != nullptr ? (float *)p.handle : p.outputs[0];
+  auto &buffer = ((LSTMHandle *)p.handle)->buffer;
+  float *output = buffer.empty() ? p.outputs[0] : buffer.data();
   float *x_wi = p.inputs[1];
   float *h_wi = p.inputs[2];
   float *x_bi = bias;
@@ -212,7 +218,11 @@ static void lstm_compute(InferenceParameter &p, const lstm_attr_t &attr,
 }
 
 LogicalResult top::LSTMOp::inference(InferenceParameter &p) {
-  auto attr = parseParam();
+  if (p.handle == nullptr) {
+    return failure();
+  }
+  auto handle = (LSTMHandle *)p.handle;
+  auto &attr = handle->attr;
 
   auto h0_buffer = std::make_shared<std::vector<float>>(
       attr.num_direction * attr.batch_size * attr.hidden_size, 0.0f);
@@ -239,9 +249,9 @@ LogicalResult top::LSTMOp::inference(InferenceParameter &p) {
   if (attr.num_direction == 2) {
     lstm_compute(p, attr, B, initial_h, initial_c, false);
   }
-  if (p.handle) {
-    float *buffer = (float *)p.handle;
-    function_permute(buffer, p.outputs[0],
+  auto &buffer = handle->buffer;
+  if (!buffer.empty()) {
+    function_permute(buffer.data(), p.outputs[0],
                      {1, attr.seq_len, attr.num_direction, attr.batch_size,
                       attr.hidden_size},
                      {0, 1, 3, 2, 4});
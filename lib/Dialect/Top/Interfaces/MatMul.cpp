@@ -104,6 +104,10 @@ LogicalResult top::MatMulOp::init(InferenceParameter &p) {
                 a.M, a.K, a.N, a.do_relu, a.relu_limit, 0, 0, a.right_transpose,
                 0, 0, 0, a.L_shape, a.R_shape, a.dims_merge_2_M);
   p.handle = (void *)matmul;
+  p.rebind = [](InferenceParameter &p) {
+    ((MatMul *)p.handle)
+        ->rebind(p.inputs[0], p.inputs[1], p.inputs[2], p.outputs[0]);
+  };
   return success();
 }
 
@@ -87,6 +87,9 @@ LogicalResult top::MaxPoolOp::init(InferenceParameter &p) {
   auto attr = parseParam();
   pooling->setup(p.inputs[0], p.outputs[0], attr, false);
   p.handle = (void *)pooling;
+  p.rebind = [](InferenceParameter &p) {
+    ((Pooling *)p.handle)->rebind(p.inputs[0], p.outputs[0]);
+  };
   return success();
 }
 
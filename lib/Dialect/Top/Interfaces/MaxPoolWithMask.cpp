@@ -49,13 +49,25 @@ int64_t top::MaxPoolWithMaskOp::getFLOPs() {
 }
 
 LogicalResult top::MaxPoolWithMaskOp::init(InferenceParameter &p) {
+  // attributes parsed once, the buffers are taken from p by inference
+  p.handle = (void *)new pool_attr_t(parseParam());
+  p.setup_in_inference = true;
   return success();
 }
 
-void top::MaxPoolWithMaskOp::deinit(InferenceParameter &p) { return; }
+void top::MaxPoolWithMaskOp::deinit(InferenceParameter &p) {
+  if (p.handle != nullptr) {
+    auto attr = (pool_attr_t *)p.handle;
+    delete attr;
+    p.handle = nullptr;
+  }
+}
 
 LogicalResult top::MaxPoolWithMaskOp::inference(InferenceParameter &p) {
-  auto attr = parseParam();
+  if (p.handle == nullptr) {
+    return failure();
+  }
+  auto &attr = *(pool_attr_t *)p.handle;
   int64_t nc = attr.n * attr.c;
   auto num_elem = module::getNumElements(getOutput());
   std::fill_n(p.outputs[0], num_elem, (float)(-FLT_MAX));
@@ -75,6 +75,19 @@ template <typename T> std::shared_ptr<std::vector<T>> WeightOp::read() {
   }
 }
 
+llvm::ArrayRef<char> WeightOp::view() {
+  auto type = getOutput().getType().cast<RankedTensorType>();
+  bool do_compress = getDoCompress().has_value() && getDoCompress().value();
+  if (do_compress || type.getElementType().isInteger(4)) {
+    return {};
+  }
+  if (getInlineBytes().has_value() && !getInlineBytes().value().empty()) {
+    auto bytes = getInlineBytes().value();
+    return llvm::ArrayRef<char>(bytes.data(), bytes.size());
+  }
+  return module::weightFile().view(module::getName(getOperation()));
+}
+
 std::shared_ptr<std::vector<float>> WeightOp::read_as_float() {
   auto dtype = module::getStorageType(getOutput());
   if (dtype.isUnsignedInteger(8)) {
@@ -239,13 +252,9 @@ Value WeightOp::create(Operation *OwnerOp, llvm::StringRef suffix,
   builder.setInsertionPoint(OwnerOp);
   std::string op_name = module::getName(OwnerOp).str();
   std::string new_name = op_name + "_" + suffix.str();
-  std::set<StringRef> all_tensor_names;
-  module::weightFile().getAllNames(all_tensor_names);
-  auto it = all_tensor_names.find(new_name.c_str());
   int index = 1;
-  while (it != all_tensor_names.end()) {
+  while (module::weightFile().hasTensor(new_name)) {
     new_name = op_name + "_" + std::to_string((index++)) + "_" + suffix.str();
-    it = all_tensor_names.find(new_name.c_str());
   }
   auto ret = module::weightFile().addTensor(new_name, &data, type);
   assert(succeeded(ret));
@@ -212,68 +212,56 @@ void weightQuantization(
   }
 }
 
-LogicalResult tpu::A16MatMulOp::init(InferenceParameter &p) {
-  // (MxK), (KxN) matmul
-  if (getWeightBits() == 8) {
-    auto matmul = new MatMul();
-    auto in_shape = getInput().getType().cast<RankedTensorType>().getShape();
-    int64_t M = 1;
-    for (int i = 0; i < in_shape.size() - 1; i++) {
-      M *= in_shape[i];
-    }
-    auto weight_value = getWeight();
-    auto weight_shape =
-        weight_value.getType().cast<RankedTensorType>().getShape();
-
-    auto w_transpose = getWTranspose();
-    int K = w_transpose ? weight_shape[1] : weight_shape[0];
-    int N = w_transpose ? weight_shape[0] : weight_shape[1];
-
-    matmul->setup(p.inputs[0], p.inputs[1], p.inputs[4], p.outputs[0], 1, 1, M,
-                  K, N, false, -1.0, 0, 0, w_transpose, false, false, false);
-    p.handle = (void *)matmul;
-  }
-  return success();
-}
-
-void tpu::A16MatMulOp::deinit(InferenceParameter &p) {
-  if (p.handle != nullptr) {
-    auto matmul = (MatMul *)p.handle;
-    delete matmul;
-    p.handle = nullptr;
-  }
-  return;
-}
+// dequantized weight and the matmul on it, built once by init
+struct A16MatMulHandle {
+  // [K, N], already transposed when the op has w_transpose
+  std::vector<float> weight;
+  MatMul matmul;
+};
 
-LogicalResult tpu::A16MatMulOp::inference(InferenceParameter &p) {
+LogicalResult tpu::A16MatMulOp::init(InferenceParameter &p) {
   // dequant weight back to f16/ bf16
   auto scale = p.inputs[2];
+  auto zp = p.inputs[3];
   auto weight_value = getWeight();
   auto weight_shape =
       weight_value.getType().cast<RankedTensorType>().getShape();
   int K = weight_shape[0];
   int N = weight_shape[1];
+  auto w_transpose = getWTranspose();
+  auto in_shape = getInput().getType().cast<RankedTensorType>().getShape();
+  int64_t M = 1;
+  for (int i = 0; i < in_shape.size() - 1; i++) {
+    M *= in_shape[i];
+  }
+  // the weight is either widened to float by the interpreter, or kept in
+  // storage type (native_inputs) and widened here
   auto weight = p.inputs[1];
+  bool native = p.native_inputs.size() > 1 && p.native_inputs[1];
+  bool sign = !module::getStorageType(weight_value).isUnsignedInteger(8);
+  auto weight_at = [&](int64_t i) -> float {
+    if (!native) {
+      return weight[i];
+    }
+    return sign ? ((int8_t *)weight)[i] : ((uint8_t *)weight)[i];
+  };
+  std::vector<float> new_weight;
   if (getWeightBits() == 4) {
-    auto w_transpose = getWTranspose();
     int q_group_size = module::getQuantGroupSize();
-    auto zp = p.inputs[3];
     N *= 2;
-    auto in_shape = getInput().getType().cast<RankedTensorType>().getShape();
-    int64_t M = 1;
-    for (int i = 0; i < in_shape.size() - 1; i++) {
-      M *= in_shape[i];
-    }
-    auto new_weight = std::vector<float>(K * N, 0);
+    new_weight.assign(K * N, 0);
+    auto weight_byte = [&](int64_t i) -> int {
+      return native ? ((uint8_t *)weight)[i] : int(weight[i]);
+    };
     if (!q_group_size) {
       for (int i = 0; i < K; i++) {
         auto offset = i * N;
         auto zp_i = zp[i];
         auto scale_i = scale[i];
         for (int j = 0; j < N; j++) {
-          new_weight[offset + j] = (((int(weight[(offset + j) / 2]) & 0x0F) - zp_i) * scale_i);
+          new_weight[offset + j] = ((weight_byte((offset + j) / 2) & 0x0F) - zp_i) * scale_i;
           j++;
-          new_weight[offset + j] = (((int(weight[(offset + j) / 2]) >> 4) - zp_i) * scale_i);
+          new_weight[offset + j] = ((weight_byte((offset + j) / 2) >> 4) - zp_i) * scale_i;
         }
       }
     } else {
@@ -281,38 +269,59 @@ LogicalResult tpu::A16MatMulOp::inference(InferenceParameter &p) {
         int quant_idx = i / q_group_size;
         auto zp_i = zp[quant_idx];
         auto scale_i = scale[quant_idx];
-        new_weight[i] =  (((int(weight[i / 2]) & 0x0F) - zp_i) * scale_i);
+        new_weight[i] = ((weight_byte(i / 2) & 0x0F) - zp_i) * scale_i;
         i++;
-        new_weight[i] =  (((int(weight[i / 2]) >> 4) - zp_i) * scale_i);
+        new_weight[i] = ((weight_byte(i / 2) >> 4) - zp_i) * scale_i;
       }
     }
-
-    auto matmul = new MatMul();
-    if (w_transpose) {
-      std::swap(K, N);
-    }
-    matmul->setup(p.inputs[0], new_weight.data(), p.inputs[4], p.outputs[0], 1,
-                  1, M, K, N, false, -1.0, 0, 0, w_transpose, false, false,
-                  false);
-    matmul->run();
-    delete matmul;
   } else {
-    auto zp = p.inputs[3];
+    new_weight.resize(K * N);
     for (int i = 0; i < K; i++) {
       auto offset = i * N;
       for (int j = 0; j < N; j++) {
-        weight[offset + j] = module::isSG2380() ?
-            ((weight[offset + j]) * scale[i] - zp[i]) :
-            ((weight[offset + j]) * scale[i]);
+        new_weight[offset + j] = module::isSG2380() ?
+            (weight_at(offset + j) * scale[i] - zp[i]) :
+            (weight_at(offset + j) * scale[i]);
       }
     }
-    // hand over the rest work to onednn matmul
-    if (p.handle == nullptr) {
-      return failure();
-    }
-    auto matmul = (MatMul *)p.handle;
-    matmul->run();
   }
+  auto handle = new A16MatMulHandle();
+  if (w_transpose) {
+    std::swap(K, N);
+    // transposed here once instead of by the matmul in every run
+    handle->weight.resize(K * N);
+    tensor_hw_transpose(handle->weight.data(), new_weight.data(), 1, 1, N, K);
+  } else {
+    handle->weight = std::move(new_weight);
+  }
+  // hand over the rest work to onednn matmul
+  handle->matmul.setup(p.inputs[0], handle->weight.data(), p.inputs[4],
+                       p.outputs[0], 1, 1, M, K, N, false, -1.0, 0, 0, false,
+                       false, false, false);
+  p.handle = (void *)handle;
+  p.rebind = [](InferenceParameter &p) {
+    auto handle = (A16MatMulHandle *)p.handle;
+    handle->matmul.rebind(p.inputs[0], handle->weight.data(), p.inputs[4],
+                          p.outputs[0]);
+  };
+  return success();
+}
+
+void tpu::A16MatMulOp::deinit(InferenceParameter &p) {
+  if (p.handle != nullptr) {
+    auto handle = (A16MatMulHandle *)p.handle;
+    delete handle;
+    p.handle = nullptr;
+  }
+  return;
+}
+
+LogicalResult tpu::A16MatMulOp::inference(InferenceParameter &p) {
+  if (p.handle == nullptr) {
+    return failure();
+  }
+  auto handle = (A16MatMulHandle *)p.handle;
+  handle->matmul.run();
 
   auto num_elem = module::getNumElements(getOutput());
   if (module::isF16Modes()) {
@@ -66,16 +66,58 @@ conv_attr_t tpu::Conv2DOp::parseParam() {
   return p;
 }
 
+// attributes and requant params, parsed once by init
+struct Conv2DHandle {
+  conv_attr_t attr;
+  std::unique_ptr<Conv> conv;
+  // keeps the workspace of the transforms between invokes
+  std::unique_ptr<Winograd> wino;
+  bool quant;
+  // int8 models run in s32 when exact, f32 otherwise
+  bool try_int8, input_unsigned;
+  // quantized output: bias is added by the requant, after the conv
+  std::shared_ptr<std::vector<int32_t>> bias_i32;
+  i64_array_t rshift_v, multiplier_v;
+};
+
 LogicalResult tpu::Conv2DOp::init(InferenceParameter &p) {
-  auto conv = new Conv();
-  p.handle = (void *)conv;
+  auto handle = new Conv2DHandle();
+  handle->attr = parseParam();
+  if (getUseWinograd().value_or(0)) {
+    handle->wino = std::make_unique<Winograd>();
+  } else {
+    handle->conv = std::make_unique<Conv>();
+  }
+  handle->quant = module::isUniformQuantized(getOutput());
+  auto in_stype = module::getStorageType(getInput());
+  auto w_stype = module::getStorageType(getFilter());
+  handle->try_int8 = handle->quant && in_stype.isInteger(8) &&
+                     w_stype.isInteger(8) && !w_stype.isUnsignedInteger(8);
+  handle->input_unsigned = in_stype.isUnsignedInteger(8);
+  if (handle->quant) {
+    if (handle->attr.has_bias) {
+      handle->attr.do_relu = false;
+    }
+    int64_t n, c, h, w;
+    module::getNCHW(getOutput(), n, c, h, w);
+    handle->rshift_v = module::getI64Array(getRshift().value());
+    handle->multiplier_v =
+        module::getI64Array(getMultiplier(), handle->rshift_v->size(), 1);
+    handle->bias_i32 = std::make_shared<std::vector<int32_t>>(c, 0);
+    if (getWithBias()) {
+      auto biasOp = cast<top::WeightOp>(getBias().getDefiningOp());
+      handle->bias_i32 = biasOp.read_as_int32();
+    }
+  }
+  p.handle = (void *)handle;
+  p.setup_in_inference = true;
   return success();
 }
 
 void tpu::Conv2DOp::deinit(InferenceParameter &p) {
   if (p.handle != nullptr) {
-    auto conv = (Conv *)p.handle;
-    delete conv;
+    auto handle = (Conv2DHandle *)p.handle;
+    delete handle;
     p.handle = nullptr;
   }
 }
@@ -84,180 +126,29 @@ LogicalResult tpu::Conv2DOp::inference(InferenceParameter &p) {
   if (p.handle == nullptr) {
     return failure();
   }
-  auto conv = (Conv *)p.handle;
-  auto attr = parseParam();
-  if (module::isUniformQuantized(getOutput()) && attr.has_bias) {
-    attr.do_relu = false;
-    for (int i = 0; i < attr.oc; i++) {
-      p.inputs[2][i] = 0.f;
-    }
-  }
-
-  int use_winograd = getUseWinograd().value_or(0);
-  if (use_winograd) {
-    // AT @ P @ A -> AE @ P
-    float AEQ[4][16] = {
-        {1., 1., 1., 0., 1., 1., 1., 0., 1., 1., 1., 0., 0., 0., 0., 0.},
-        {0., 1., -1., 1., 0., 1., -1., 1., 0., 1., -1., 1., 0., 0., 0., 0.},
-        {0., 0., 0., 0., 1., 1., 1., 0., -1., -1., -1., 0., 1., 1., 1., 0.},
-        {0., 0., 0., 0., 0., 1., -1., 1., 0., -1., 1., -1., 0., 1., -1., 1.}};
-
-    //
-    float BEQ[16][16] = {
-        {1., 0., -1., 0., 0., 0., 0., 0., -1., 0., 1., 0., 0., 0., 0., 0.},
-        {0., 1., 1., 0., 0., 0., 0., 0., 0., -1., -1., 0., 0., 0., 0., 0.},
-        {0., -1., 1., 0., 0., 0., 0., 0., 0., 1., -1., 0., 0., 0., 0., 0.},
-        {0., -1., 0., 1., 0., 0., 0., 0., 0., 1., 0., -1., 0., 0., 0., 0.},
-        {0., 0., 0., 0., 1., 0., -1., 0., 1., 0., -1., 0., 0., 0., 0., 0.},
-        {0., 0., 0., 0., 0., 1., 1., 0., 0., 1., 1., 0., 0., 0., 0., 0.},
-        {0., 0., 0., 0., 0., -1., 1., 0., 0., -1., 1., 0., 0., 0., 0., 0.},
-        {0., 0., 0., 0., 0., -1., 0., 1., 0., -1., 0., 1., 0., 0., 0., 0.},
-        {0., 0., 0., 0., -1., 0., 1., 0., 1., 0., -1., 0., 0., 0., 0., 0.},
-        {0., 0., 0., 0., 0., -1., -1., 0., 0., 1., 1., 0., 0., 0., 0., 0.},
-        {0., 0., 0., 0., 0., 1., -1., 0., 0., -1., 1., 0., 0., 0., 0., 0.},
-        {0., 0., 0., 0., 0., 1., 0., -1., 0., -1., 0., 1., 0., 0., 0., 0.},
-        {0., 0., 0., 0., -1., 0., 1., 0., 0., 0., 0., 0., 1., 0., -1., 0.},
-        {0., 0., 0., 0., 0., -1., -1., 0., 0., 0., 0., 0., 0., 1., 1., 0.},
-        {0., 0., 0., 0., 0., 1., -1., 0., 0., 0., 0., 0., 0., -1., 1., 0.},
-        {0., 0., 0., 0., 0., 1., 0., -1., 0., 0., 0., 0., 0., -1., 0., 1.}};
-
-    int n = attr.n;
-    int ic = attr.ic;
-    int ih = attr.ih;
-    int iw = attr.iw;
-    int pih = attr.ih + attr.phb + attr.pht;
-    int piw = attr.iw + attr.pwl + attr.pwr;
-
-    int window_h = (pih - 4) / 2 + 1;
-    int window_w = (piw - 4) / 2 + 1;
-    int row_num = window_w * window_h;
-
-    int oc = attr.oc;
-    int ow = attr.ow;
-    int oh = attr.oh;
-    auto gt = p.inputs[1] + (ic * oc * 3 * 3); // b, ic, iw, ih
-
-    float *input_unfolded = new float[row_num * attr.ic * 16];
-    float *P = new float[row_num * attr.oc * 16];
-    float *IA_wino = new float[row_num * attr.ic * 16];
-
-    bool need_pad = (attr.phb + attr.pht + attr.pwl + attr.pwr) > 0;
-
-    float *inputs;
-    // for each batch
-    for (int bs = 0; bs < n; bs++) {
-      inputs = need_pad ? new float[ic * pih * piw]
-                        : p.inputs[0] + (bs * ic * ih * iw);
-      if (need_pad) {
-        memset(inputs, attr.pad_value,
-               sizeof(float) * ic * (ih + attr.pht + attr.phb) *
-                   (iw + attr.pwl + attr.pwr));
-        for (int i = 0; i < ic; i++) {
-          for (int j = 0; j < ih; j++) {
-            for (int k = 0; k < iw; k++) {
-              int input_index =
-                  (bs * ic * ih * iw) + (i * ih * iw) + (j * iw) + (k);
-              int output_index =
-                  (i * pih * piw) + ((j + attr.pht) * piw) + (k + attr.pwl);
-
-              inputs[output_index] = p.inputs[0][input_index];
-            }
-          }
-        }
-      }
-
-      /**
-       * 1. unfold image (im2col)
-       * input_unfolded = (
-       *     input_image.unfold(2, 4, 2)
-       *     .unfold(3, 4, 2)
-       *     .permute(0, 2, 3, 1, 4, 5)
-       *     .reshape(row_num * ic, 16)
-       * )
-       */
-      int output_index = 0;
-      for (int i = 0; i < window_h * 2; i += 2) {   // unfold(3, 4, 2)
-        for (int j = 0; j < window_w * 2; j += 2) { // unfold(2, 4, 2)
-          for (int ci = 0; ci < attr.ic; ci++) {    // permute(0, 2, 3, 1, 4, 5)
-            for (int hi = 0; hi < 4; hi++) {
-              for (int wi = 0; wi < 4; wi++) {
-                int input_index =
-                    (ci * pih * piw) + ((i + hi) * piw) + (j + wi);
-                input_unfolded[output_index] = inputs[input_index];
-                output_index++;
-              }
-            }
-          }
-        }
-      }
-
-      // 2.
-      // input_unfolded @ BEQ.transpose(0, 1) -> IA_wino
-      auto matmul = new MatMul();
-      matmul->setup(input_unfolded, (float *)BEQ, 0, IA_wino, 1, 1,
-                    row_num * ic, 16, 16, false, 0, 0, 0, true, false, false,
-                    false);
-      matmul->run();
-      delete matmul;
-
-      // 3.
-      memset(P, 0, sizeof(float) * row_num * attr.oc * 16);
-      // (gt * IA_wino with broadcast and reduce sum) -> P
-
-#pragma omp parallel for schedule(static, omp_schedule(row_num))
-      for (int i = 0; i < row_num; i++) {
-        for (int oi = 0; oi < attr.oc; oi++) { // for each kernel
-          for (int k = 0; k < 16; k++) {       // for each window
-            for (int j = 0; j < ic; j++) {     // for each input channel
-              int input_index = (i * ic * 16) + (j * 16) + (k);
-              // IA_wino[input_index]
-              int gt_index = (oi * ic * 16) + (j * 16) + (k);
-              int output_index = (i * attr.oc * 16) + (oi * 16) + (k);
-              P[output_index] += IA_wino[input_index] * gt[gt_index];
-            }
-          }
-        }
-      }
-
-      // 4.
-      // P @ AEQ.transpose(0, 1) -> wino_res
-      float *wino_res = new float[row_num * attr.oc * 4];
-      matmul = new MatMul();
-      matmul->setup(P, (float *)AEQ, 0, wino_res, 1, 1, row_num * attr.oc, 16,
-                    4, false, 0, 0, 0, true, false, false, 0);
-      matmul->run();
-      delete matmul;
-
-      // 5.
-#pragma omp parallel for schedule(static, omp_schedule(row_num))
-      for (int r = 0; r < row_num; r++) {
-        for (int c = 0; c < oc; c++) {
-          for (int h = 0; h < 2; h++) {
-            for (int w = 0; w < 2; w++) {
-              int wino_res_idx = (r * oc * 4) + (c * 4) + h * 2 + w;
-              int h_idx = ((r * 2) / ow) * 2 + h;
-              int w_idx = (r * 2) % ow + w;
-              int unfolded_idx =
-                  (bs * oc * oh * ow) + (c * oh * ow) + (h_idx * ow) + (w_idx);
-              p.outputs[0][unfolded_idx] = wino_res[wino_res_idx];
-            }
-          }
-        }
-      }
-
-      // fold wino_res -> p.outputs[0]
-      delete[] wino_res;
-    }
-    if (need_pad) {
-      delete[] inputs;
-    }
-    delete[] P;
-    delete[] IA_wino;
-    delete[] input_unfolded;
-
+  auto handle = (Conv2DHandle *)p.handle;
+  auto &attr = handle->attr;
+  // setups only rebind the buffers once the kernel is built
+  // exact sums of the integer path
+  const int32_t *acc = nullptr;
+  if (handle->wino) {
+    handle->wino->set_weight_version(p.weight_version);
+    handle->wino->setup(p.inputs[0], p.inputs[1], p.outputs[0], attr);
+    handle->wino->run();
   } else {
-    conv->setup(p.inputs[0], p.inputs[1], p.inputs[2], p.outputs[0], attr);
+    auto conv = handle->conv.get();
+    conv->set_blocked_layout(p.blocked_layout);
+    conv->set_weight_version(p.weight_version);
+    bool int8 = handle->try_int8 &&
+                conv->setup_int8(p.inputs[0], p.inputs[1], p.outputs[0], attr,
+                                 handle->input_unsigned);
+    if (!int8) {
+      // quantized: the bias is left to the requant
+      conv->setup(p.inputs[0], p.inputs[1],
+                  handle->quant ? nullptr : p.inputs[2], p.outputs[0], attr);
+    }
     conv->run();
+    acc = conv->acc();
   }
 
   // requant
@@ -288,49 +179,48 @@ LogicalResult tpu::Conv2DOp::inference(InferenceParameter &p) {
     } else if (out_type.isF16()) {
       F16(p.outputs[0], p.outputs[0], num_elem);
     }
-  } else if (module::isUniformQuantized(getOutput())) {
+  } else if (handle->quant) {
     int64_t n, c, h, w;
     module::getNCHW(getOutput(), n, c, h, w);
     auto o_qtype = module::getUniformQuantizedType(getOutput());
-    auto rshift_v = module::getI64Array(getRshift().value());
-    auto multiplier_v =
-        module::getI64Array(getMultiplier(), rshift_v->size(), 1);
+    auto &rshift_v = handle->rshift_v;
+    auto &multiplier_v = handle->multiplier_v;
     bool per_axis = rshift_v->size() == c;
     bool use_winograd = attr.use_winograd;
     // do bias after conv prevent precision issue
-    auto bias_i32 = std::make_shared<std::vector<int32_t>>(c, 0);
+    auto &bias_i32 = handle->bias_i32;
     bool do_relu = getDoRelu();
-    if (getWithBias()) {
-      auto biasOp = cast<top::WeightOp>(getBias().getDefiningOp());
-      bias_i32 = biasOp.read_as_int32();
-    }
     auto qmode = getQuantMode();
     bool is_tf = qmode == tpu::RequantMode::QDM ||
                  qmode == tpu::RequantMode::TFLite ||
                  qmode == tpu::RequantMode::TFLite_LShift;
     auto rmode = is_tf ? ROUNDING_HALF_AWAY_FROM_ZERO : ROUNDING_HALF_UP;
+    int64_t zero_point = o_qtype.getZeroPoint();
+    auto requant =
+        get_requant_kernel(qmode, rmode, out_type, do_relu, zero_point);
 
 #pragma omp parallel for schedule(static, omp_schedule(c))
     for (int ic = 0; ic < c; ic++) {
       int64_t shift = per_axis       ? rshift_v->at(ic)
                       : use_winograd ? rshift_v->at(1)
                                      : rshift_v->at(0);
+      if (is_tf && module::isCV18xx()) {
+        // as applyMultiplierAndRShift
+        shift = -shift;
+      }
       int64_t multi = 1;
       if (qmode != tpu::RequantMode::OnlyShift) {
         multi = per_axis ? multiplier_v->at(ic) : multiplier_v->at(0);
       }
       int32_t bias = bias_i32->at(ic + (use_winograd ? c : 0));
       for (int in = 0; in < n; in++) {
-        for (int hw = 0; hw < h * w; hw++) {
-          int offset = (in * c + ic) * h * w + hw;
-          int64_t v = 0;
-          int64_t tmp = p.outputs[0][offset] + bias;
-          v = applyMultiplierAndRShift(tmp, multi, shift, qmode, rmode) +
-              o_qtype.getZeroPoint();
-          if (do_relu && (v < o_qtype.getZeroPoint())) {
-            v = o_qtype.getZeroPoint();
-          }
-          p.outputs[0][offset] = saturate(v, out_type);
+        int offset = (in * c + ic) * h * w;
+        if (acc) {
+          requant(acc + offset, p.outputs[0] + offset, h * w, bias, multi,
+                  shift, zero_point);
+        } else {
+          requant(p.outputs[0] + offset, p.outputs[0] + offset, h * w,
+                  (float)bias, multi, shift, zero_point);
         }
       }
     }
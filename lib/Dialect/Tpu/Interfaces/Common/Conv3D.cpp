@@ -66,6 +66,7 @@ LogicalResult tpu::Conv3DOp::init(InferenceParameter &p) {
   auto conv = new Conv();
   auto attr = parseParam();
 
+  conv->set_blocked_layout(p.blocked_layout);
   conv->setup(p.inputs[0], p.inputs[1], p.inputs[2], p.outputs[0], attr);
   p.handle = (void *)conv;
   return success();
@@ -94,16 +94,28 @@ deconv_attr_t tpu::DeconvOp::parseParam() {
   return p;
 }
 
+// attributes parsed once by init
+struct DeconvHandle {
+  Deconv deconv;
+  deconv_attr_t attr;
+  int izp = 0;
+};
+
 LogicalResult tpu::DeconvOp::init(InferenceParameter &p) {
-  auto deconv = new Deconv();
-  p.handle = (void *)deconv;
+  auto handle = new DeconvHandle();
+  handle->attr = parseParam();
+  if (module::isUniformQuantized(getInput())) {
+    handle->izp = module::getUniformQuantizedType(getInput()).getZeroPoint();
+  }
+  p.handle = (void *)handle;
+  p.setup_in_inference = true;
   return success();
 }
 
 void tpu::DeconvOp::deinit(InferenceParameter &p) {
   if (p.handle != nullptr) {
-    auto deconv = (Deconv *)p.handle;
-    delete deconv;
+    auto handle = (DeconvHandle *)p.handle;
+    delete handle;
     p.handle = nullptr;
   }
 }
@@ -112,14 +124,12 @@ LogicalResult tpu::DeconvOp::inference(InferenceParameter &p) {
   if (p.handle == nullptr) {
     return failure();
   }
-  auto deconv = (Deconv *)p.handle;
-  auto attr = parseParam();
-  int izp = 0;
-  if (module::isUniformQuantized(getInput())) {
-    izp = module::getUniformQuantizedType(getInput()).getZeroPoint();
-  }
-  deconv->setup(p.inputs[0], p.inputs[1], p.inputs[2], p.outputs[0], attr, izp);
-  deconv->run();
+  auto handle = (DeconvHandle *)p.handle;
+  auto &deconv = handle->deconv;
+  deconv.set_weight_version(p.weight_version);
+  deconv.setup(p.inputs[0], p.inputs[1], p.inputs[2], p.outputs[0],
+               handle->attr, handle->izp);
+  deconv.run();
   // requant
   auto out_type = module::getStorageType(getOutput());
   auto num_elem = module::getNumElements(getOutput());
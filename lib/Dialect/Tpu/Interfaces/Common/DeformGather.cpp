@@ -57,22 +57,25 @@ deform_gather_attr_t tpu::DeformGatherOp::parseParam() {
 }
 
 LogicalResult tpu::DeformGatherOp::init(InferenceParameter& p) {
-  auto num = module::getNumElements(getOutput()); // output size, buffer size
-  float *buffer = new float[num];
-  p.handle = (void *)buffer;
+  // attributes parsed once, the buffers are taken from p by inference
+  p.handle = (void *)new deform_gather_attr_t(parseParam());
+  p.setup_in_inference = true;
   return success();
 }
 
 void tpu::DeformGatherOp::deinit(InferenceParameter& p) {
   if (p.handle != nullptr) {
-    float *buffer = (float *)p.handle;
-    delete[] buffer;
+    auto attr = (deform_gather_attr_t *)p.handle;
+    delete attr;
     p.handle = nullptr;
   }
 }
 
 LogicalResult tpu::DeformGatherOp::inference(InferenceParameter &p) {
-  auto attr = parseParam();
-  processDeformGather(p, attr, p.outputs[0], false);
+  if (p.handle == nullptr) {
+    return failure();
+  }
+  auto attr = (deform_gather_attr_t *)p.handle;
+  processDeformGather(p, *attr, p.outputs[0], false);
   return success();
 }
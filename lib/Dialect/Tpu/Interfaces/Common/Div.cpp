@@ -30,6 +30,10 @@ LogicalResult tpu::DivOp::init(InferenceParameter &p) {
       .setup();
 
   p.handle = (void *)binary;
+  p.rebind = [index0, index1](InferenceParameter &p) {
+    ((Binary *)p.handle)
+        ->rebind(p.inputs[index0], p.inputs[index1], p.outputs[0]);
+  };
 
   return success();
 }
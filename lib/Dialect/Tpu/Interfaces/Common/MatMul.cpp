@@ -135,21 +135,40 @@ matmul_attr_t tpu::MatMulOp::parseParam() {
   return p;
 }
 
+// attributes parsed once by init
+struct MatMulHandle {
+  MatMul matmul;
+  matmul_attr_t attr;
+};
+
 LogicalResult tpu::MatMulOp::init(InferenceParameter &p) {
-  auto matmul = new MatMul();
-  auto a = parseParam();
+  auto handle = new MatMulHandle();
+  handle->attr = parseParam();
+  auto &a = handle->attr;
+  auto matmul = &handle->matmul;
+  // int8 models run in s32 when exact, f32 otherwise
+  auto in_stype = module::getStorageType(getInput());
+  auto r_stype = module::getStorageType(getRight());
+  matmul->set_int8(module::isUniformQuantized(getOutput()) &&
+                       in_stype.isInteger(8) && r_stype.isInteger(8) &&
+                       !r_stype.isUnsignedInteger(8),
+                   in_stype.isUnsignedInteger(8), module::isWeight(getRight()));
   matmul->setup(p.inputs[0], p.inputs[1], p.inputs[2], p.outputs[0], a.batch,
                 a.batch_low, a.M, a.K, a.N, a.do_relu, a.relu_limit, a.right_zp,
                 a.input_zp, a.right_transpose, a.left_transpose,
                 a.output_transpose, a.hdim_is_batch);
-  p.handle = (void *)matmul;
+  p.handle = (void *)handle;
+  p.rebind = [](InferenceParameter &p) {
+    ((MatMulHandle *)p.handle)
+        ->matmul.rebind(p.inputs[0], p.inputs[1], p.inputs[2], p.outputs[0]);
+  };
   return success();
 }
 
 void tpu::MatMulOp::deinit(InferenceParameter &p) {
   if (p.handle != nullptr) {
-    auto matmul = (MatMul *)p.handle;
-    delete matmul;
+    auto handle = (MatMulHandle *)p.handle;
+    delete handle;
     p.handle = nullptr;
   }
   return;
@@ -159,7 +178,8 @@ LogicalResult tpu::MatMulOp::inference(InferenceParameter &p) {
   if (p.handle == nullptr) {
     return failure();
   }
-  auto matmul = (MatMul *)p.handle;
+  auto handle = (MatMulHandle *)p.handle;
+  auto matmul = &handle->matmul;
 
   matmul->run();
   auto out_type = module::getStorageType(getOutput());
@@ -182,8 +202,13 @@ LogicalResult tpu::MatMulOp::inference(InferenceParameter &p) {
     }
   } else if (module::isUniformQuantized(getOutput())) {
     auto qmode = getQuantMode();
+    // exact sums of the integer path
+    auto acc = matmul->acc();
+    auto sum = [&](int64_t i) -> int64_t {
+      return acc ? acc[i] : (int64_t)p.outputs[0][i];
+    };
     if (is_cv18xx) {
-      auto a = parseParam();
+      auto &a = handle->attr;
       auto full_batch = a.batch * a.batch_low;
       bool is_fc = module::isWeight(getRight());
       i64_array_t rshift_v;
@@ -203,7 +228,7 @@ LogicalResult tpu::MatMulOp::inference(InferenceParameter &p) {
         for (int64_t j = 0; j < isz; ++j) {
           int64_t offset = i * isz + j;
           int64_t v = 0;
-          v = applyMultiplierAndRShift(p.outputs[0][offset],
+          v = applyMultiplierAndRShift(sum(offset),
                                        multiplier_v->at(i), rshift_v->at(i),
                                        qmode, ROUNDING_HALF_AWAY_FROM_ZERO);
           p.outputs[0][offset] = saturate(v, out_type);
@@ -222,7 +247,7 @@ LogicalResult tpu::MatMulOp::inference(InferenceParameter &p) {
         for (int64_t i = 0; i < num_output; i++) {
           // auto v = (((int64_t)(p.outputs[0][i] * mlti) + (1 << (rft - 1))) >>
           // rft);
-          auto v = MultiplyByQuantizedMultiplier((int32_t)(p.outputs[0][i]),
+          auto v = MultiplyByQuantizedMultiplier((int32_t)sum(i),
                                                  (int32_t)multiplier_v->at(0),
                                                  -(int32_t)rshift_v->at(0)) +
                    o_qtype.getZeroPoint();
@@ -232,7 +257,7 @@ LogicalResult tpu::MatMulOp::inference(InferenceParameter &p) {
 #pragma omp parallel for schedule(static, omp_schedule(num_output))
         for (int i = 0; i < num_output; ++i) {
           auto v = applyMultiplierAndRShift(
-                       p.outputs[0][i], multiplier_v->at(0), rshift_v->at(0)) +
+                       sum(i), multiplier_v->at(0), rshift_v->at(0)) +
                    o_qtype.getZeroPoint();
           p.outputs[0][i] = saturate(v, out_type);
         }
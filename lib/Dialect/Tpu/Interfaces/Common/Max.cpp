@@ -23,6 +23,9 @@ LogicalResult tpu::MaxOp::init(InferenceParameter &p) {
       .algorithem(algorithm::binary_max)
       .setup();
   p.handle = (void *)binary;
+  p.rebind = [](InferenceParameter &p) {
+    ((Binary *)p.handle)->rebind(p.inputs[0], p.inputs[1], p.outputs[0]);
+  };
   return success();
 }
 
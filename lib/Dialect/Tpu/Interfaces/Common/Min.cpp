@@ -22,6 +22,9 @@ LogicalResult tpu::MinOp::init(InferenceParameter &p) {
       .algorithem(algorithm::binary_min)
       .setup();
   p.handle = (void *)binary;
+  p.rebind = [](InferenceParameter &p) {
+    ((Binary *)p.handle)->rebind(p.inputs[0], p.inputs[1], p.outputs[0]);
+  };
   return success();
 }
 
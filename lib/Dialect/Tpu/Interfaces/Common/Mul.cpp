@@ -26,6 +26,9 @@ LogicalResult tpu::MulOp::init(InferenceParameter &p) {
       .algorithem(algorithm::binary_mul)
       .setup();
   p.handle = (void *)binary;
+  p.rebind = [](InferenceParameter &p) {
+    ((Binary *)p.handle)->rebind(p.inputs[0], p.inputs[1], p.outputs[0]);
+  };
   return success();
 }
 
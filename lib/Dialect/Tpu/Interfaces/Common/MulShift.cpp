@@ -29,13 +29,20 @@ LogicalResult tpu::MulShiftOp::inference(InferenceParameter &p) {
     out_zp = qtype.getZeroPoint();
   }
 
-#pragma omp parallel for schedule(static, omp_schedule(num_elem))
-  for (int64_t i = 0; i < num_elem; i++) {
-    auto v = applyMultiplierAndRShift(p.inputs[0][i] - in_zp,
-                                      (int64_t)getMultiplier(), getRshift());
+  auto requant = get_requant_kernel(tpu::RequantMode::MultiplierShift,
+                                    ROUNDING_HALF_UP, sType);
+  int64_t multi = getMultiplier();
+  int64_t rshift = getRshift();
+  // blocks of contiguous elements for the vectorized kernel
+  const int64_t block = 4096;
+  int64_t num_block = ceiling_func(num_elem, block);
+#pragma omp parallel for schedule(static, omp_schedule(num_block))
+  for (int64_t b = 0; b < num_block; b++) {
+    int64_t start = b * block;
+    int64_t len = std::min(block, num_elem - start);
     // should add zp to the outputs.
-    v += out_zp;
-    p.outputs[0][i] = saturate(v, sType);
+    requant(p.inputs[0] + start, p.outputs[0] + start, len, -(float)in_zp,
+            multi, rshift, out_zp);
   }
   return success();
 }
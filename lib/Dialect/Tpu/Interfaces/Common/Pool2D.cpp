@@ -64,6 +64,9 @@ LogicalResult tpu::Pool2DOp::init(InferenceParameter &p) {
   }
   pooling->setup(p.inputs[0], p.outputs[0], attr, is_avg_pooling, izp);
   p.handle = (void *)pooling;
+  p.rebind = [](InferenceParameter &p) {
+    ((Pooling *)p.handle)->rebind(p.inputs[0], p.outputs[0]);
+  };
   return success();
 }
 
@@ -91,17 +91,31 @@ reduce_attr_t tpu::ReduceOp::parseParam() {
   return attr;
 }
 
-LogicalResult tpu::ReduceOp::init(InferenceParameter &p) { return success(); }
-void tpu::ReduceOp::deinit(InferenceParameter &p) {}
+LogicalResult tpu::ReduceOp::init(InferenceParameter &p) {
+  // attributes parsed once, the buffers are taken from p by inference
+  p.handle = (void *)new reduce_attr_t(parseParam());
+  p.setup_in_inference = true;
+  return success();
+}
+void tpu::ReduceOp::deinit(InferenceParameter &p) {
+  if (p.handle != nullptr) {
+    auto attr = (reduce_attr_t *)p.handle;
+    delete attr;
+    p.handle = nullptr;
+  }
+}
 
 LogicalResult tpu::ReduceOp::inference(InferenceParameter &p) {
+  if (p.handle == nullptr) {
+    return failure();
+  }
+  auto &attr = *(reduce_attr_t *)p.handle;
   float *input_v = p.inputs[0];
   float *output_v = p.outputs[0];
   auto type_val = getMode();
 
   bool is_cv18xx = module::isCV18xx();
   auto out_type = module::getStorageType(getOutput());
-  auto attr = parseParam();
   int64_t outer_dims = attr.outer_n * attr.outer_c;
   // calc dims
 
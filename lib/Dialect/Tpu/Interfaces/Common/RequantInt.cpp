@@ -41,30 +41,23 @@ LogicalResult tpu::RequantIntOp::inference(InferenceParameter &p) {
 
   if (mode == tpu::RequantMode::TFLite_LShift ||
       mode == tpu::RequantMode::TFLite) {
+    auto requant = get_requant_kernel(mode, round_mode, o_sType);
 #pragma omp parallel for schedule(static, omp_schedule(shape[1]))
     for (int c = 0; c < shape[1]; ++c) {
       for (int n = 0; n < shape[0]; ++n) {
-        for (int i = 0; i < inner; ++i) {
-          int offset = (n * shape[1] + c) * inner + i;
-          auto v = zero_point + MultiplyByQuantizedMultiplier(
-                                    (int32_t)(p.inputs[0][offset]),
-                                    (int32_t)multi, (int32_t)shift_val,
-                                    round_mode);
-          p.outputs[0][offset] = saturate(v, o_sType);
-        }
+        int offset = (n * shape[1] + c) * inner;
+        requant(p.inputs[0] + offset, p.outputs[0] + offset, inner, 0.f,
+                multi, shift_val, zero_point);
       }
     }
   } else if (mode == tpu::RequantMode::MultiplierShift) {
+    auto requant = get_requant_kernel(mode, round_mode, o_sType);
 #pragma omp parallel for schedule(static, omp_schedule(shape[1]))
     for (int c = 0; c < shape[1]; ++c) {
       for (int n = 0; n < shape[0]; ++n) {
-        for (int i = 0; i < inner; ++i) {
-          int offset = (n * shape[1] + c) * inner + i;
-          auto v = zero_point +
-                   applyMultiplierAndRShift((p.inputs[0][offset] - zp_x), multi,
-                                            -shift_val, tpu::RequantMode::MultiplierShift, round_mode);
-          p.outputs[0][offset] = saturate(v, o_sType);
-        }
+        int offset = (n * shape[1] + c) * inner;
+        requant(p.inputs[0] + offset, p.outputs[0] + offset, inner,
+                -(float)zp_x, multi, -shift_val, zero_point);
       }
     }
   }
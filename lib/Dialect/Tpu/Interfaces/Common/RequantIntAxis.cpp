@@ -33,6 +33,7 @@ LogicalResult tpu::RequantIntAxisOp::inference(InferenceParameter &p) {
   }
   if (mode == tpu::RequantMode::TFLite_LShift ||
       mode == tpu::RequantMode::TFLite) {
+    auto requant = get_requant_kernel(mode, round_mode, o_sType);
 #pragma omp parallel for schedule(static, omp_schedule(shape[1]))
     for (int c = 0; c < shape[1]; ++c) {
       int64_t multi, shift_val, zero_point;
@@ -47,17 +48,13 @@ LogicalResult tpu::RequantIntAxisOp::inference(InferenceParameter &p) {
         zero_point = (int64_t)(short)((tmp & 0xffff0000) >> 16);
       }
       for (int n = 0; n < shape[0]; ++n) {
-        for (int i = 0; i < inner; ++i) {
-          int offset = (n * shape[1] + c) * inner + i;
-          int v = zero_point + MultiplyByQuantizedMultiplier(
-                                   (int32_t)(p.inputs[0][offset]),
-                                   (int32_t)multi, (int32_t)shift_val,
-                                   round_mode);
-          p.outputs[0][offset] = saturate(v, o_sType);
-        }
+        int offset = (n * shape[1] + c) * inner;
+        requant(p.inputs[0] + offset, p.outputs[0] + offset, inner, 0.f,
+                multi, shift_val, zero_point);
       }
     }
   } else if (mode == tpu::RequantMode::MultiplierShift) {
+    auto requant = get_requant_kernel(mode, round_mode, o_sType);
 #pragma omp parallel for schedule(static, omp_schedule(shape[1]))
     for (int c = 0; c < shape[1]; ++c) {
       int64_t multi, rshift_val, zero_point;
@@ -72,13 +69,9 @@ LogicalResult tpu::RequantIntAxisOp::inference(InferenceParameter &p) {
         zero_point = (int64_t)(short)((tmp & 0xffff0000) >> 16);
       }
       for (int n = 0; n < shape[0]; ++n) {
-        for (int i = 0; i < inner; ++i) {
-          int offset = (n * shape[1] + c) * inner + i;
-          int v = zero_point +
-                  applyMultiplierAndRShift((p.inputs[0][offset] - zp_x), multi,
-                                           rshift_val, tpu::RequantMode::MultiplierShift, round_mode);
-          p.outputs[0][offset] = saturate(v, o_sType);
-        }
+        int offset = (n * shape[1] + c) * inner;
+        requant(p.inputs[0] + offset, p.outputs[0] + offset, inner,
+                -(float)zp_x, multi, rshift_val, zero_point);
       }
     }
   }
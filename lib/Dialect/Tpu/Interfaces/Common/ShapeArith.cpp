@@ -46,6 +46,9 @@ LogicalResult tpu::ShapeArithOp::init(InferenceParameter &p) {
       .algorithem(alg)
       .setup();
   p.handle = (void *)binary;
+  p.rebind = [](InferenceParameter &p) {
+    ((Binary *)p.handle)->rebind(p.inputs[0], p.inputs[1], p.outputs[0]);
+  };
   return success();
 }
 void tpu::ShapeArithOp::deinit(InferenceParameter &p) {
@@ -30,6 +30,10 @@ LogicalResult tpu::SubOp::init(InferenceParameter &p) {
       .algorithem(algorithm::binary_sub)
       .setup();
   p.handle = (void *)binary;
+  p.rebind = [index0, index1](InferenceParameter &p) {
+    ((Binary *)p.handle)
+        ->rebind(p.inputs[index0], p.inputs[index1], p.outputs[0]);
+  };
   return success();
 }
 
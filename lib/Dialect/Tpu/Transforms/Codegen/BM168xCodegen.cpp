@@ -431,6 +431,42 @@ bool BMCodegen::getOpCoeffLocation(Operation *op, uint64_t coeff_addr,
   return true;
 }
 
+// hands the coeff of s to writer in address order, zero padded to
+// coeff_size. Returns the size taken by the weights
+static uint64_t write_coeff(ModuleOp s, uint64_t coeff_size,
+                            const bmodel::ModelGen::Writer &writer) {
+  std::vector<uint8_t> zeros(BM168x::ALIGNMENT, 0);
+  uint64_t offset = 0, written = 0;
+  auto pad_to = [&](uint64_t end) {
+    end = std::min(end, coeff_size);
+    while (written < end) {
+      auto size = std::min<uint64_t>(end - written, zeros.size());
+      writer(zeros.data(), size);
+      written += size;
+    }
+  };
+  for (auto func : s.getOps<FuncOp>()) {
+    func.walk([&](top::WeightOp weightOp) {
+      // straight from the weight file mapping when it can
+      std::shared_ptr<std::vector<uint8_t>> data;
+      auto bytes = weightOp.view();
+      if (bytes.empty()) {
+        data = weightOp.read_as_byte();
+        bytes = llvm::ArrayRef<char>((const char *)data->data(), data->size());
+      }
+      pad_to(offset);
+      if (written == offset && offset < coeff_size) {
+        auto size = std::min<uint64_t>(bytes.size(), coeff_size - offset);
+        writer((const uint8_t *)bytes.data(), size);
+        written += size;
+      }
+      offset += align_up((int64_t)bytes.size(), BM168x::ALIGNMENT);
+    });
+  }
+  pad_to(coeff_size);
+  return offset;
+}
+
 Offset<bmodel::CoeffMem> BMCodegen::CreateCoeffMem(ModuleOp s,
                                                    uint64_t coeff_addr,
                                                    uint64_t coeff_size) {
@@ -454,20 +490,21 @@ Offset<bmodel::CoeffMem> BMCodegen::CreateCoeffMem(ModuleOp s,
     });
   }
   auto coeff_location = builder.CreateVector(locations);
-  auto data_u8 = std::make_shared<std::vector<uint8_t>>(coeff_size, 0);
-  uint64_t offset = 0;
-  for (auto func : s.getOps<FuncOp>()) {
-    func.walk([&](top::WeightOp weightOp) {
-      auto data = weightOp.read_as_byte();
-      memcpy(data_u8->data() + offset, data->data(), data->size());
-      offset += align_up((int64_t)data->size(), BM168x::ALIGNMENT);
-    });
-  }
+  // hashed now and written when the model is saved, a weight at a time
+  llvm::SHA256 hasher;
+  auto offset = write_coeff(s, coeff_size, [&](const uint8_t *data,
+                                               size_t size) {
+    hasher.update(llvm::ArrayRef(data, size));
+  });
   if (offset != coeff_size) {
     llvm::errs() << "Warning: coeff size is not correct\n";
   }
-  auto sha256 = llvm::SHA256::hash(llvm::ArrayRef(data_u8->data(), coeff_size));
-  auto binary_coeff = model_gen->WriteBinary(coeff_size, data_u8->data());
+  auto sha256 = hasher.final();
+  auto binary_coeff = model_gen->WriteBinary(
+      coeff_size, std::string(sha256.begin(), sha256.end()),
+      [s, coeff_size](const bmodel::ModelGen::Writer &writer) {
+        write_coeff(s, coeff_size, writer);
+      });
   auto coeff_sha256 = builder.CreateVector(sha256.data(), sha256.size());
   bmodel::CoeffMemBuilder cmb(builder);
   cmb.add_address(coeff_addr);
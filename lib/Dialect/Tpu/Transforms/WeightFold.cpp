@@ -12,38 +12,45 @@
 #include "tpu_mlir/Dialect/Tpu/Transforms/Passes.h"
 #include "tpu_mlir/Support/Float16.h"
 #include "tpu_mlir/Support/MathUtils.h"
+#include "omp.h"
 using namespace llvm;
 
 namespace tpu_mlir {
 namespace tpu {
-static void WeightFolder(Operation *op) {
+static bool canFold(Operation *op) {
   // if the op is in the region of other op, don't do WeightFolder
 
   if (isa<tpu::IfOp, tpu::LoopOp, top::LoopOp, top::IfOp>(
           op->getBlock()->getParentOp()))
-    return;
+    return false;
   if (module::isAllWeight(op) == false) {
-    return;
+    return false;
   }
   // avoid Weight2ActivationOp -> Gather be folded as Weight -> Gather
   if (isa<tpu::Weight2ActivationOp, tpu::Device2HostOp, tpu::ShapeCastOp,
           tpu::ShapePackOp>(op)) {
-    return;
+    return false;
   }
-  auto infer = dyn_cast<InferenceInterface>(op);
-  if (!infer) {
-    return;
+  if (!isa<InferenceInterface>(op)) {
+    return false;
   }
   for (auto user : op->getUsers()) {
     if (isa<ReturnOp>(user)) {
-      return;
+      return false;
     }
   }
+  return true;
+}
+
+// outputs of op computed from its weights. Reads the weight file and the op
+// only, so that ops are folded in parallel
+static std::vector<std::vector<float>> foldPayload(Operation *op) {
+  auto infer = cast<InferenceInterface>(op);
   auto ins = op->getOperands();
   auto outs = op->getResults();
   auto num_in = ins.size();
   auto num_out = outs.size();
-  std::vector<float> datas[num_out];
+  std::vector<std::vector<float>> datas(num_out);
   for (int i = 0; i < num_out; i++) {
     if (module::isNone(outs[i])) {
       continue;
@@ -78,13 +85,16 @@ static void WeightFolder(Operation *op) {
   ret = infer.inference(p);
   assert(mlir::succeeded(ret));
   infer.deinit(p);
-  OpBuilder builder(module::getCtx());
-  builder.setInsertionPointAfter(op);
-  for (int i = 0; i < num_out; i++) {
+  return datas;
+}
+
+// new weights of the folded outputs, in place of them
+static void commitFold(Operation *op, std::vector<std::vector<float>> &datas) {
+  auto outs = op->getResults();
+  for (int i = 0; i < outs.size(); i++) {
     if (datas[i].empty()) {
       continue;
     }
-    std::string suffix = std::string("folder_") + std::to_string(i);
     auto out = outs[i];
     auto out_type = out.getType().cast<RankedTensorType>();
     Value new_op;
@@ -158,15 +168,47 @@ public:
   WeightFoldPass() {}
   void runOnOperation() override {
     auto mOp = getOperation();
+    // created before the workers read it
+    module::weightFile();
+    bool parallel = getContext().isMultithreadingEnabled();
 
     for (auto func : mOp.getOps<FuncOp>()) {
-      func.walk([&](InferenceInterface op) {
-        // LLVM_DEBUG(llvm::dbgs() << "weight infer: " << op << "\n";);
-        if (false == removeIfNoUse(op)) {
-          WeightFolder(op);
-          removeIfNoUse(op);
+      // the ops of a wave only have weights as inputs, none of them uses
+      // another. Their outputs are folded in parallel, then replaced one by
+      // one, which turns the users into the next wave
+      DenseSet<Operation *> folded;
+      while (true) {
+        std::vector<Operation *> wave;
+        func.walk([&](InferenceInterface op) {
+          // LLVM_DEBUG(llvm::dbgs() << "weight infer: " << op << "\n";);
+          if (false == removeIfNoUse(op) && !folded.count(op) &&
+              canFold(op)) {
+            wave.push_back(op);
+          }
+        });
+        if (wave.empty()) {
+          break;
+        }
+        // by chunks, not to hold the outputs of a whole wave
+        int64_t num = wave.size();
+        int64_t chunk = parallel ? omp_get_max_threads() * 4 : 1;
+        for (int64_t start = 0; start < num; start += chunk) {
+          int64_t end = std::min(start + chunk, num);
+          std::vector<std::vector<std::vector<float>>> payloads(end - start);
+#pragma omp parallel for schedule(dynamic, 1) if (end - start > 1)
+          for (int64_t i = start; i < end; i++) {
+            payloads[i - start] = foldPayload(wave[i]);
+          }
+          for (int64_t i = start; i < end; i++) {
+            commitFold(wave[i], payloads[i - start]);
+            payloads[i - start].clear();
+            if (!removeIfNoUse(wave[i])) {
+              // outputs left, e.g. none ones
+              folded.insert(wave[i]);
+            }
+          }
         }
-      });
+      }
     }
   }
   bool removeIfNoUse(Operation *op) {
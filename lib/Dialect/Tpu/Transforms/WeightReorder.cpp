@@ -20,6 +20,7 @@ namespace tpu {
 extern void populateWeightReorderCV18xxPatterns(RewritePatternSet *patterns);
 extern void populateWeightReorderBM1684Patterns(RewritePatternSet *patterns);
 extern void populateWeightReorderBM1684XPatterns(RewritePatternSet *patterns);
+extern void prepareWeightReorderBM1684X(ModuleOp m);
 
 class WeightReorderPass : public WeightReorderBase<WeightReorderPass> {
 public:
@@ -31,10 +32,13 @@ public:
     auto modules = module::getAllModules();
     for (auto sub : *modules) {
       RewritePatternSet patterns(&getContext());
+      bool bm1684x = module::isBM1684XFamily() || module::isBM1690Family();
       if (module::isBM1684Family()) {
         populateWeightReorderBM1684Patterns(&patterns);
-      } else if (module::isBM1684XFamily() || module::isBM1690Family()) {
+      } else if (bm1684x) {
         populateWeightReorderBM1684XPatterns(&patterns);
+        // heavy payloads computed in parallel and committed ahead
+        prepareWeightReorderBM1684X(sub);
       } else if (module::isCV18xx()) {
         populateWeightReorderCV18xxPatterns(&patterns);
       }
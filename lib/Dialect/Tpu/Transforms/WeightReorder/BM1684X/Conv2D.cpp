@@ -10,6 +10,7 @@
 #include "../WeightReorder.h"
 #include "ConvUtils.h"
 #include "tpu_mlir/Support/Float16.h"
+#include "omp.h"
 
 using namespace bm1684x;
 // refer to net_compiler: bool BM1684XCoeffArranger::ConvWeightArr(GraphEdge*
@@ -62,7 +63,20 @@ LogicalResult dynamic_weight_reorder_bm1684x(tpu::Conv2DOp op,
   return success();
 }
 
-static LogicalResult reorder_8bit(tpu::Conv2DOp op, PatternRewriter &rewriter, Type filter_stype) {
+// requant, bias and filter of an int8/fp8 conv merged in one coeff
+struct Conv8bitCoeff {
+  std::shared_ptr<std::vector<int8_t>> coeff;
+  std::vector<int64_t> shape;
+  bool int4;
+  bool merge;
+  int use_3ic_optimize; // -1 if not set
+};
+
+// reads the op and its weights only, so that convs are merged in parallel
+static std::shared_ptr<Conv8bitCoeff> merge_8bit_coeff(tpu::Conv2DOp op,
+                                                       Type filter_stype) {
+  auto merged = std::make_shared<Conv8bitCoeff>();
+  merged->use_3ic_optimize = -1;
   auto attr = op.parseParam();
   int input_c = attr.ic;
   int output_c = attr.oc;
@@ -199,8 +213,7 @@ static LogicalResult reorder_8bit(tpu::Conv2DOp op, PatternRewriter &rewriter, T
     } else {
       tpu::reshape_coeff_for_3ic(filter_i8, filter_shape, use_3ic_optimize,
                                  isINT4Conv);
-      op->setAttr("use_3ic_optimize",
-                  rewriter.getI64IntegerAttr(use_3ic_optimize));
+      merged->use_3ic_optimize = use_3ic_optimize;
     }
   } else {
     filter_shape = {1, attr.oc, 1, attr.kh * attr.kw};
@@ -382,6 +395,25 @@ static LogicalResult reorder_8bit(tpu::Conv2DOp op, PatternRewriter &rewriter, T
       coeff_shape[3] /= IC_PARALLEL;
     }
   }
+  merged->coeff = new_coeff;
+  merged->shape = coeff_shape;
+  merged->int4 = isINT4Conv;
+  merged->merge = merge;
+  return merged;
+}
+
+// commits merged to the IR and the weight file
+static LogicalResult commit_8bit_coeff(tpu::Conv2DOp op, RewriterBase &rewriter,
+                                       Type filter_stype,
+                                       const Conv8bitCoeff *merged) {
+  auto new_coeff = merged->coeff;
+  auto &coeff_shape = merged->shape;
+  bool isINT4Conv = merged->int4;
+  bool merge = merged->merge;
+  if (merged->use_3ic_optimize >= 0) {
+    op->setAttr("use_3ic_optimize",
+                rewriter.getI64IntegerAttr(merged->use_3ic_optimize));
+  }
   auto elem_type = module::getStorageType(op.getFilter());
   auto coeff_type = RankedTensorType::get(coeff_shape, elem_type);
   bool sign = coeff_type.getElementType().isSignedInteger();
@@ -426,6 +458,58 @@ static LogicalResult reorder_8bit(tpu::Conv2DOp op, PatternRewriter &rewriter, T
   return success();
 }
 
+static LogicalResult reorder_8bit(tpu::Conv2DOp op, PatternRewriter &rewriter,
+                                  Type filter_stype) {
+  auto merged = merge_8bit_coeff(op, filter_stype);
+  return commit_8bit_coeff(op, rewriter, filter_stype, merged.get());
+}
+
+void bm1684x::prepareConv2DCoeff(ModuleOp m) {
+  if (!m.getContext()->isMultithreadingEnabled()) {
+    return;
+  }
+  std::vector<tpu::Conv2DOp> ops;
+  m.walk([&](tpu::Conv2DOp op) {
+    auto stype = module::getStorageType(op.getFilter());
+    if ((stype.isInteger(8) || stype.isFloat8E4M3FN() ||
+         stype.isFloat8E5M2()) &&
+        !op.getCoeffMerged() && module::isWeight(op.getFilter())) {
+      ops.push_back(op);
+    }
+  });
+  if (ops.size() < 2) {
+    return;
+  }
+  // created before the workers read it
+  module::weightFile();
+  IRRewriter rewriter(m.getContext());
+  // by chunks, each one committed before the next is merged, not to hold
+  // the coeffs of the whole net
+  int64_t num = ops.size();
+  int64_t chunk = omp_get_max_threads() * 4;
+  for (int64_t start = 0; start < num; start += chunk) {
+    int64_t end = std::min(start + chunk, num);
+    std::vector<std::shared_ptr<Conv8bitCoeff>> coeffs(end - start);
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int64_t i = start; i < end; i++) {
+      coeffs[i - start] = merge_8bit_coeff(
+          ops[i], module::getStorageType(ops[i].getFilter()));
+    }
+    for (int64_t i = start; i < end; i++) {
+      auto &merged = coeffs[i - start];
+      // coeff_merged stays false without merge, left to the patterns so
+      // that they do not match it again
+      if (merged->merge) {
+        rewriter.setInsertionPoint(ops[i]);
+        (void)commit_8bit_coeff(ops[i], rewriter,
+                                module::getStorageType(ops[i].getFilter()),
+                                merged.get());
+      }
+      merged.reset();
+    }
+  }
+}
+
 template <>
 LogicalResult WeightReorder<tpu::Conv2DOp, int8_t>::matchAndRewrite(
     tpu::Conv2DOp op, PatternRewriter &rewriter) const {
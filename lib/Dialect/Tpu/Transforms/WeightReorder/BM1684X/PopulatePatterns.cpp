@@ -43,5 +43,7 @@ void populateWeightReorderBM1684XPatterns(RewritePatternSet *patterns) {
   // clang-format on
 };
 
+void prepareWeightReorderBM1684X(ModuleOp m) { prepareConv2DCoeff(m); }
+
 } // namespace tpu
 } // namespace tpu_mlir
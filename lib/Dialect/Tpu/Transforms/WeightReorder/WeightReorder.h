@@ -40,6 +40,11 @@ public:
                                 PatternRewriter &rewriter) const override;
 };
 
+// merges the coeff of the int8/fp8 Conv2D ops of m on the openmp workers,
+// by chunks each committed to the IR and the weight file before the next,
+// ahead of the patterns. What it leaves is merged by the patterns
+void prepareConv2DCoeff(ModuleOp m);
+
 } // namespace bm1684x
 
 namespace cv18xx {
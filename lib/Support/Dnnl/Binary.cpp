@@ -13,8 +13,7 @@ using namespace dnnl;
 
 namespace tpu_mlir {
 Binary::Binary() {
-  eng = dnnl::engine(engine::kind::cpu, 0);
-  engine_stream = dnnl::stream(eng);
+  eng = dnnl_engine();
 }
 
 void Binary::setup() {
@@ -27,10 +26,10 @@ void Binary::setup() {
 }
 
 void Binary::run() {
-  binary_prim.execute(engine_stream, {{DNNL_ARG_SRC_0, lhs_mem},
+  binary_prim.execute(dnnl_stream(), {{DNNL_ARG_SRC_0, lhs_mem},
                                       {DNNL_ARG_SRC_1, rhs_mem},
                                       {DNNL_ARG_DST, dst_mem}});
-  engine_stream.wait();
+  dnnl_stream().wait();
 }
 
 } // namespace tpu_mlir
@@ -9,6 +9,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "tpu_mlir/Support/Dnnl/Concat.h"
+#include "tpu_mlir/Support/Dnnl/DnnlUtils.h"
 
 using namespace dnnl;
 using tag = memory::format_tag;
@@ -17,8 +18,7 @@ using dt = memory::data_type;
 namespace tpu_mlir {
 
 Concat::Concat() {
-  eng = dnnl::engine(engine::kind::cpu, 0);
-  eng_stream = dnnl::stream(eng);
+  eng = dnnl_engine();
 }
 
 void Concat::setup(std::vector<float *> inputs, float *output,
@@ -55,8 +55,8 @@ void Concat::setup(std::vector<float *> inputs, float *output,
 }
 
 void Concat::run() {
-  concat_prim.execute(eng_stream, concat_args);
-  eng_stream.wait();
+  concat_prim.execute(dnnl_stream(), concat_args);
+  dnnl_stream().wait();
 }
 
 } // namespace tpu_mlir
@@ -14,8 +14,7 @@
 using namespace dnnl;
 using namespace tpu_mlir;
 Conv::Conv() {
-  eng = dnnl::engine(engine::kind::cpu, 0);
-  eng_stream = dnnl::stream(eng);
+  eng = dnnl_engine();
   memset(&_attr, 0, sizeof(conv_attr_t));
   backw_init = false;
 }
@@ -53,6 +52,7 @@ void Conv::activation_init(float *input, conv_attr_t &attr) {
     p_input = input_after_pad->data();
   } else {
     src_shape = {attr.n, attr.ic, attr.id, attr.ih, attr.iw};
+    input_after_pad = nullptr;
     p_input = input;
   }
 }
@@ -95,8 +95,44 @@ void Conv::diff_dst_init(memory::dims &dst_shape) {
   p_goutput = diff_dst->data();
 }
 
+std::vector<int64_t> Conv::cache_key(float *weight, float *bias,
+                                     const conv_attr_t &attr) {
+  int64_t relu_limit;
+  memcpy(&relu_limit, &attr.relu_limit, sizeof(relu_limit));
+  return {attr.n,      attr.ic,        attr.id,         attr.ih,
+          attr.iw,     attr.oc,        attr.od,         attr.oh,
+          attr.ow,     attr.kd,        attr.dd,         attr.sd,
+          attr.ins_d,  attr.kh,        attr.dh,         attr.sh,
+          attr.ins_h,  attr.kw,        attr.dw,         attr.sw,
+          attr.ins_w,  attr.pdf,       attr.pdb,        attr.pht,
+          attr.phb,    attr.pwl,       attr.pwr,        attr.groups,
+          attr.pad_value, attr.kernel_zp, attr.do_relu, relu_limit,
+          (int64_t)weight, (int64_t)bias, (int64_t)blocked, (int64_t)keep_dst,
+          blocked_src ? (int64_t)blocked_src->get(true) : 0,
+          (int64_t)weight_version};
+}
+
+void Conv::rebind(float *input, float *output) {
+  origin_input = input;
+  if (!input_after_pad) {
+    p_input = input;
+    src_mem.set_data_handle(input);
+  }
+  // the reorders of the blocked layout share these memories
+  dst_mem.set_data_handle(output);
+}
+
 void Conv::setup(float *input, float *weight, float *bias, float *output,
                  conv_attr_t attr) {
+  auto key = cache_key(weight, bias, attr);
+  if (key == prim_key) {
+    // same op and shape: reuse the primitive
+    rebind(input, output);
+    return;
+  }
+  // backward path depends on the forward primitive desc
+  backw_init = false;
+  acc_i32 = nullptr;
   activation_init(input, attr);
   filter_init(weight, attr);
   dst_shape = {attr.n, attr.oc, attr.od, attr.oh, attr.ow};
@@ -136,12 +172,166 @@ void Conv::setup(float *input, float *weight, float *bias, float *output,
   primitive_attr conv_attr;
   post_relu(conv_attr, attr.do_relu, attr.relu_limit);
 
+  net.clear();
+  net_args.clear();
+  prim_dst_mem = dst_mem;
+  if (!blocked) {
+    conv_prim_desc = convolution_forward::primitive_desc(
+        eng, prop_kind::forward_inference, algorithm::convolution_direct,
+        src_mem.get_desc(), filter_mem.get_desc(), bias_mem.get_desc(),
+        dst_mem.get_desc(), strides, dilation, padding_l, padding_r, conv_attr);
+    prim = convolution_forward(conv_prim_desc);
+    prim_key = std::move(key);
+    return;
+  }
+
+  auto any_md = [](const memory::dims &dims) {
+    return memory::desc(dims, memory::data_type::f32, memory::format_tag::any);
+  };
   conv_prim_desc = convolution_forward::primitive_desc(
       eng, prop_kind::forward_inference, algorithm::convolution_direct,
-      src_mem.get_desc(), filter_mem.get_desc(), bias_mem.get_desc(),
-      dst_mem.get_desc(), strides, dilation, padding_l, padding_r, conv_attr);
-  prim = convolution_forward(conv_prim_desc);
+      any_md(src_shape), any_md(filter_shape), bias_mem.get_desc(),
+      any_md(dst_shape), strides, dilation, padding_l, padding_r, conv_attr);
+  // weights are constant, reorder them here instead of in every run
+  prim_filter_mem = filter_mem;
+  if (conv_prim_desc.weights_desc() != filter_mem.get_desc()) {
+    prim_filter_mem = memory(conv_prim_desc.weights_desc(), eng);
+    reorder(filter_mem, prim_filter_mem)
+        .execute(dnnl_stream(), filter_mem, prim_filter_mem);
+    dnnl_stream().wait();
+  }
+  // the result of the producing conv, not reordered back to plain
+  auto in_mem = src_mem;
+  if (blocked_src != nullptr && *blocked_src && !input_after_pad) {
+    in_mem = *blocked_src;
+  }
+  auto prim_src_mem = in_mem;
+  if (conv_prim_desc.src_desc() != in_mem.get_desc()) {
+    prim_src_mem = memory(conv_prim_desc.src_desc(), eng);
+    net.push_back(reorder(in_mem, prim_src_mem));
+    net_args.push_back({{DNNL_ARG_FROM, in_mem}, {DNNL_ARG_TO, prim_src_mem}});
+  }
+  if (conv_prim_desc.dst_desc() != dst_mem.get_desc()) {
+    prim_dst_mem = memory(conv_prim_desc.dst_desc(), eng);
+  }
+  net.push_back(convolution_forward(conv_prim_desc));
+  net_args.push_back({{DNNL_ARG_SRC, prim_src_mem},
+                      {DNNL_ARG_WEIGHTS, prim_filter_mem},
+                      {DNNL_ARG_BIAS, bias_mem},
+                      {DNNL_ARG_DST, prim_dst_mem}});
+  if (prim_dst_mem != dst_mem && !keep_dst) {
+    net.push_back(reorder(prim_dst_mem, dst_mem));
+    net_args.push_back({{DNNL_ARG_FROM, prim_dst_mem}, {DNNL_ARG_TO, dst_mem}});
+  }
+  prim_key = std::move(key);
+}
+
+bool Conv::reads_blocked_src(const conv_attr_t &attr) {
+  // run() dilates and pads these from the plain input
+  bool pad = attr.pdf > 0 || attr.pdb > 0 || attr.pht > 0 || attr.phb > 0 ||
+             attr.pwl > 0 || attr.pwr > 0;
+  return !attr.ins_d && !attr.ins_h && !attr.ins_w &&
+         !(attr.pad_value != 0 && pad);
+}
+
+void Conv::sync_dst(bool to_plain) {
+  if (!prim_dst_mem || prim_dst_mem == dst_mem) {
+    return;
+  }
+  if (to_plain) {
+    reorder(prim_dst_mem, dst_mem)
+        .execute(dnnl_stream(), prim_dst_mem, dst_mem);
+  } else {
+    reorder(dst_mem, prim_dst_mem)
+        .execute(dnnl_stream(), dst_mem, prim_dst_mem);
+  }
+  dnnl_stream().wait();
+}
+
+bool Conv::setup_int8(float *input, float *weight, float *output,
+                      conv_attr_t attr, bool input_unsigned) {
+  // relu of the f32 path is applied to the sums, kernel_zp may leave s8
+  if (!dnnl_exact_int8() || attr.do_relu || attr.kernel_zp != 0) {
+    return false;
+  }
+  auto key = cache_key(weight, nullptr, attr);
+  key.push_back(input_unsigned ? 2 : 1);
+  if (key == prim_key) {
+    rebind(input, output);
+    return true;
+  }
+  backw_init = false;
+  // pad_value and inserts are still materialized in f32 by run()
+  activation_init(input, attr);
+  filter_init(weight, attr);
+  dst_shape = {attr.n, attr.oc, attr.od, attr.oh, attr.ow};
+  memory::dims filter_shape =
+      (attr.groups != 1)
+          ? memory::dims{attr.groups,
+                         attr.oc / attr.groups,
+                         attr.ic / attr.groups,
+                         attr.kd,
+                         attr.kh,
+                         attr.kw}
+          : memory::dims{attr.oc, attr.ic, attr.kd, attr.kh, attr.kw};
+  memory::dims strides = {attr.sd, attr.sh, attr.sw};
+  memory::dims padding_l = {attr.pdf, attr.pht, attr.pwl};
+  memory::dims padding_r = {attr.pdb, attr.phb, attr.pwr};
+  memory::dims dilation = {attr.dd - 1, attr.dh - 1, attr.dw - 1};
 
+  src_mem =
+      memory({{src_shape}, memory::data_type::f32, memory::format_tag::ncdhw},
+             eng, p_input);
+  auto filter_tag = (attr.groups != 1) ? memory::format_tag::goidhw
+                                       : memory::format_tag::oidhw;
+  filter_mem = memory({{filter_shape}, memory::data_type::f32, filter_tag}, eng,
+                      p_weight);
+  dst_mem =
+      memory({{dst_shape}, memory::data_type::f32, memory::format_tag::ncdhw},
+             eng, output);
+  acc_i32 = std::make_shared<std::vector<int32_t>>(
+      attr.n * attr.oc * attr.od * attr.oh * attr.ow);
+  auto acc_mem =
+      memory({{dst_shape}, memory::data_type::s32, memory::format_tag::ncdhw},
+             eng, acc_i32->data());
+
+  // plain int8 layouts only have reference kernels, let dnnl pick them
+  auto src_dt =
+      input_unsigned ? memory::data_type::u8 : memory::data_type::s8;
+  conv_prim_desc = convolution_forward::primitive_desc(
+      eng, prop_kind::forward_inference, algorithm::convolution_direct,
+      memory::desc(src_shape, src_dt, memory::format_tag::any),
+      memory::desc(filter_shape, memory::data_type::s8,
+                   memory::format_tag::any),
+      memory::desc(dst_shape, memory::data_type::s32, memory::format_tag::any),
+      strides, dilation, padding_l, padding_r);
+  // ints held in floats convert exactly in the reorders
+  prim_filter_mem = memory(conv_prim_desc.weights_desc(), eng);
+  reorder(filter_mem, prim_filter_mem)
+      .execute(dnnl_stream(), filter_mem, prim_filter_mem);
+  dnnl_stream().wait();
+  auto prim_src_mem = memory(conv_prim_desc.src_desc(), eng);
+  auto prim_acc_mem = acc_mem;
+  if (conv_prim_desc.dst_desc() != acc_mem.get_desc()) {
+    prim_acc_mem = memory(conv_prim_desc.dst_desc(), eng);
+  }
+  net.clear();
+  net_args.clear();
+  prim_dst_mem = dst_mem;
+  net.push_back(reorder(src_mem, prim_src_mem));
+  net_args.push_back({{DNNL_ARG_FROM, src_mem}, {DNNL_ARG_TO, prim_src_mem}});
+  net.push_back(convolution_forward(conv_prim_desc));
+  net_args.push_back({{DNNL_ARG_SRC, prim_src_mem},
+                      {DNNL_ARG_WEIGHTS, prim_filter_mem},
+                      {DNNL_ARG_DST, prim_acc_mem}});
+  if (prim_acc_mem != acc_mem) {
+    net.push_back(reorder(prim_acc_mem, acc_mem));
+    net_args.push_back({{DNNL_ARG_FROM, prim_acc_mem}, {DNNL_ARG_TO, acc_mem}});
+  }
+  net.push_back(reorder(acc_mem, dst_mem));
+  net_args.push_back({{DNNL_ARG_FROM, acc_mem}, {DNNL_ARG_TO, dst_mem}});
+  prim_key = std::move(key);
+  return true;
 }
 
 void Conv::backward_weights_setup() {
@@ -245,11 +435,17 @@ void Conv::run() {
     }
   }
 
-  prim.execute(eng_stream, {{DNNL_ARG_SRC, src_mem},
-                            {DNNL_ARG_WEIGHTS, filter_mem},
-                            {DNNL_ARG_BIAS, bias_mem},
-                            {DNNL_ARG_DST, dst_mem}});
-  eng_stream.wait();
+  if (net.empty()) {
+    prim.execute(dnnl_stream(), {{DNNL_ARG_SRC, src_mem},
+                                 {DNNL_ARG_WEIGHTS, filter_mem},
+                                 {DNNL_ARG_BIAS, bias_mem},
+                                 {DNNL_ARG_DST, dst_mem}});
+  } else {
+    for (size_t i = 0; i < net.size(); ++i) {
+      net.at(i).execute(dnnl_stream(), net_args.at(i));
+    }
+  }
+  dnnl_stream().wait();
 }
 
 void Conv::run_backw(void *dst_grd_input, void *weight_grd_output) {
@@ -261,8 +457,8 @@ void Conv::run_backw(void *dst_grd_input, void *weight_grd_output) {
   memset(p_gweight, 0, diff_filter.get()->size() * sizeof(float));
   memset(p_gbias, 0, diff_bias.get()->size() * sizeof(float));
   for (size_t i = 0; i < net_bw.size(); ++i)
-    net_bw.at(i).execute(eng_stream, net_bw_args.at(i));
-  eng_stream.wait();
+    net_bw.at(i).execute(dnnl_stream(), net_bw_args.at(i));
+  dnnl_stream().wait();
   memcpy(weight_grd_output, p_gweight,
          diff_filter.get()->size() * sizeof(float));
 }
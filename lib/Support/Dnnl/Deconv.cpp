@@ -14,8 +14,7 @@
 using namespace dnnl;
 using namespace tpu_mlir;
 Deconv::Deconv() {
-  eng = dnnl::engine(engine::kind::cpu, 0);
-  eng_stream = dnnl::stream(eng);
+  eng = dnnl_engine();
   memset(&_attrs, 0, sizeof(deconv_attr_t));
   _izp = 0;
 }
@@ -45,14 +44,40 @@ void Deconv::pad_init(float *input, deconv_attr_t &attr, int izp) {
     p_input = input_after_pad->data();
   } else {
     src_shape = {attr.n, attr.ic, attr.id, attr.ih, attr.iw};
+    input_after_pad = nullptr;
     p_input = input;
   }
 }
 
+std::vector<int64_t> Deconv::cache_key(float *input, float *weight,
+                                       float *bias, float *output,
+                                       const deconv_attr_t &attr, int izp) {
+  int64_t relu_limit;
+  memcpy(&relu_limit, &attr.relu_limit, sizeof(relu_limit));
+  return {attr.n,           attr.ic,           attr.id,
+          attr.ih,          attr.iw,           attr.oc,
+          attr.od,          attr.oh,           attr.ow,
+          attr.kd,          attr.kh,           attr.kw,
+          attr.sd,          attr.sh,           attr.sw,
+          attr.dd,          attr.dh,           attr.dw,
+          attr.pad_d,       attr.pad_d_after,  attr.pad_h,
+          attr.pad_h_after, attr.pad_w,        attr.pad_w_after,
+          attr.output_pad_d, attr.output_pad_h, attr.output_pad_w,
+          attr.g,           attr.do_relu,      relu_limit,
+          izp,              (int64_t)input,    (int64_t)weight,
+          (int64_t)bias,    (int64_t)output,
+          (int64_t)weight_version};
+}
+
 void Deconv::setup(float *input, float *weight, float *bias, float *output,
                    const deconv_attr_t &attr_, int izp) {
   // printf("Conv para:%d,%d,%d,%d,%d,%d,%d,%d\n", idt, wdt, bdt, odt,
   // per_channel, izp, ozp, do_relu);
+  auto key = cache_key(input, weight, bias, output, attr_, izp);
+  if (key == prim_key) {
+    // same op, same shape and buffers: reuse the primitives
+    return;
+  }
   auto attr = attr_;
   this->kd = attr.kd;
   this->kh = attr.kh;
@@ -118,7 +143,7 @@ void Deconv::setup(float *input, float *weight, float *bias, float *output,
     if (conv_prim_desc.weights_desc() != filter_memory.get_desc()) {
       prim_filter_memory = memory(conv_prim_desc.weights_desc(), eng);
       reorder(filter_memory, prim_filter_memory)
-          .execute(eng_stream, filter_memory, prim_filter_memory);
+          .execute(dnnl_stream(), filter_memory, prim_filter_memory);
     }
 
     auto prim_bias_memory = memory();
@@ -189,7 +214,7 @@ void Deconv::setup(float *input, float *weight, float *bias, float *output,
     if (deconv_prim_desc.weights_desc() != filter_memory.get_desc()) {
       prim_filter_memory = memory(deconv_prim_desc.weights_desc(), eng);
       reorder(filter_memory, prim_filter_memory)
-          .execute(eng_stream, filter_memory, prim_filter_memory);
+          .execute(dnnl_stream(), filter_memory, prim_filter_memory);
     }
 
     auto prim_bias_memory = memory();
@@ -239,6 +264,7 @@ void Deconv::setup(float *input, float *weight, float *bias, float *output,
           {{DNNL_ARG_FROM, prim_dst_memory}, {DNNL_ARG_TO, dst_memory}});
     }
   }
+  prim_key = std::move(key);
 }
 
 void Deconv::run() {
@@ -252,7 +278,7 @@ void Deconv::run() {
                           _attrs.output_pad_h, _attrs.output_pad_w, _izp);
   }
   for (size_t i = 0; i < net.size(); ++i) {
-    net.at(i).execute(eng_stream, net_args.at(i));
+    net.at(i).execute(dnnl_stream(), net_args.at(i));
   }
-  eng_stream.wait();
+  dnnl_stream().wait();
 }
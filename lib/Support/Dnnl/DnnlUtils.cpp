@@ -23,4 +23,31 @@ void post_relu(primitive_attr &attr, bool &do_relu, double &relu_limit) {
     attr.set_post_ops(ops);
   }
 }
+
+const engine &dnnl_engine() {
+  static const engine eng(engine::kind::cpu, 0);
+  return eng;
+}
+
+stream &dnnl_stream() {
+  // streams are not thread-safe; give every interpreter thread its own one
+  thread_local stream s(dnnl_engine());
+  return s;
+}
+
+bool dnnl_exact_int8() {
+  static const bool exact = [] {
+    // isas with vnni (or amx) for int8; others, newer ones included, stay f32
+    switch (get_effective_cpu_isa()) {
+    case cpu_isa::avx2_vnni:
+    case cpu_isa::avx512_core_vnni:
+    case cpu_isa::avx512_core_bf16:
+    case cpu_isa::avx512_core_amx:
+      return true;
+    default:
+      return false;
+    }
+  }();
+  return exact;
+}
 } // namespace tpu_mlir
@@ -8,13 +8,13 @@
 //===----------------------------------------------------------------------===//
 
 #include "tpu_mlir/Support/Dnnl/LRN.h"
+#include "tpu_mlir/Support/Dnnl/DnnlUtils.h"
 
 using namespace dnnl;
 
 namespace tpu_mlir {
 LRN::LRN() {
-  eng = dnnl::engine(engine::kind::cpu, 0);
-  engine_stream = dnnl::stream(eng);
+  eng = dnnl_engine();
 }
 
 void LRN::setup() {
@@ -26,9 +26,9 @@ void LRN::setup() {
 }
 
 void LRN::run() {
-  lrn_prim.execute(engine_stream,
+  lrn_prim.execute(dnnl_stream(),
                    {{DNNL_ARG_SRC, src_mem}, {DNNL_ARG_DST, dst_mem}});
-  engine_stream.wait();
+  dnnl_stream().wait();
 }
 
 } // namespace tpu_mlir
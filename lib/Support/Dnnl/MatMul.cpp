@@ -17,8 +17,53 @@ using dt = memory::data_type;
 
 namespace tpu_mlir {
 MatMul::MatMul() {
-  eng = dnnl::engine(engine::kind::cpu, 0);
-  engine_stream = dnnl::stream(eng);
+  eng = dnnl_engine();
+}
+
+void MatMul::set_int8(bool enable, bool left_unsigned, bool right_const) {
+  int8_ = enable;
+  int8_unsigned_ = left_unsigned;
+  right_const_ = right_const;
+}
+
+void MatMul::reorder_right() {
+  if (right_transpose_) {
+    if (hdim_is_batch_) {
+      tensor_hc_transpose(right_after_init->data(), origin_right, batch_, K_,
+                          batch_low_, N_);
+    } else {
+      tensor_hw_transpose(right_after_init->data(), origin_right, 1, batch_, N_,
+                          K_);
+    }
+  }
+  // ints held in floats convert exactly
+  reorder(weight_mem, prim_weight_mem)
+      .execute(dnnl_stream(), weight_mem, prim_weight_mem);
+  dnnl_stream().wait();
+}
+
+void MatMul::rebind(float *left, float *right, float *bias, float *output) {
+  // staging buffers of transpose, zero point or broadcast stay bound
+  if (p_input == origin_input) {
+    p_input = left;
+    src_mem.set_data_handle(left);
+  }
+  origin_input = left;
+  bool right_changed = right != origin_right;
+  if (p_right == origin_right) {
+    p_right = right;
+    weight_mem.set_data_handle(right);
+  }
+  origin_right = right;
+  if (right_reordered_ && right_changed) {
+    reorder_right();
+  }
+  if (bias != nullptr) {
+    p_bias = bias;
+    bias_mem.set_data_handle(bias);
+  }
+  origin_output = output;
+  dst_mem.set_data_handle(output);
 }
 
 void MatMul::right_init(float *right, int64_t right_zp, int64_t batch,
@@ -126,6 +171,16 @@ void MatMul::setup(float *left, float *right, float *bias, float *output,
   right_zp_ = right_zp;
   input_zp_ = input_zp;
   hdim_is_batch_ = hdim_is_batch;
+  // clip limits and right_zp are not kept exact in s8/s32
+  bool int8 = int8_ && dnnl_exact_int8() && right_zp == 0 && !need_broadcast_ &&
+              !output_transpose && !(do_relu && relu_limit > 0);
+  acc_i32 = nullptr;
+  right_reordered_ = false;
+  if (int8 && input_has_zp_) {
+    // subtracted by dnnl instead
+    input_has_zp_ = false;
+    p_input = input_transpose ? input_after_init->data() : origin_input;
+  }
   src_mem = memory({src_dims, memory::data_type::f32, tag::abc}, eng, p_input);
   weight_mem =
       memory({weights_dims, memory::data_type::f32, tag::abc}, eng, p_right);
@@ -135,6 +190,47 @@ void MatMul::setup(float *left, float *right, float *bias, float *output,
   }
   bias_mem = memory({bias_dims, memory::data_type::f32, tag::abc}, eng, bias);
   dst_mem = memory({dst_dims, memory::data_type::f32, tag::abc}, eng, output);
+  if (int8) {
+    primitive_attr zp_attr;
+    if (input_zp != 0) {
+      zp_attr.set_zero_points_mask(DNNL_ARG_SRC, 0);
+      src_zp_mem = memory({{1}, dt::s32, tag::x}, eng);
+      *(int32_t *)src_zp_mem.get_data_handle() = input_zp;
+    }
+    auto matmul_pd = matmul::primitive_desc(
+        eng, memory::desc(src_dims, int8_unsigned_ ? dt::u8 : dt::s8, tag::abc),
+        memory::desc(weights_dims, dt::s8, tag::any),
+        memory::desc(dst_dims, dt::s32, tag::abc), zp_attr);
+    acc_i32 = std::make_shared<std::vector<int32_t>>(batch * batch_low * M * N);
+    auto acc_mem = memory(matmul_pd.dst_desc(), eng, acc_i32->data());
+    // ints held in floats convert exactly in the reorders
+    auto prim_src_mem = memory(matmul_pd.src_desc(), eng);
+    prim_weight_mem = memory(matmul_pd.weights_desc(), eng);
+    net.clear();
+    net_args.clear();
+    net.push_back(reorder(src_mem, prim_src_mem));
+    net_args.push_back({{DNNL_ARG_FROM, src_mem}, {DNNL_ARG_TO, prim_src_mem}});
+    if (right_const_) {
+      // a weight, reordered once here as Conv::setup_int8 does
+      reorder_right();
+      right_reordered_ = true;
+    } else {
+      net.push_back(reorder(weight_mem, prim_weight_mem));
+      net_args.push_back(
+          {{DNNL_ARG_FROM, weight_mem}, {DNNL_ARG_TO, prim_weight_mem}});
+    }
+    net.push_back(matmul(matmul_pd));
+    net_args.push_back({{DNNL_ARG_SRC, prim_src_mem},
+                        {DNNL_ARG_WEIGHTS, prim_weight_mem},
+                        {DNNL_ARG_DST, acc_mem}});
+    if (input_zp != 0) {
+      net_args.back().insert(
+          {DNNL_ARG_ATTR_ZERO_POINTS | DNNL_ARG_SRC, src_zp_mem});
+    }
+    p_bias = bias;
+    do_relu_ = do_relu;
+    return;
+  }
   primitive_attr relu_attr;
   post_relu(relu_attr, do_relu, relu_limit);
   auto matmul_pd = matmul::primitive_desc(
@@ -146,7 +242,7 @@ void MatMul::setup(float *left, float *right, float *bias, float *output,
 void MatMul::run() {
   float *p_input_after = origin_input;
   float *p_right_after = origin_right;
-  if (right_transpose_) {
+  if (right_transpose_ && !right_reordered_) {
     if (hdim_is_batch_) {
       tensor_hc_transpose(right_after_init->data(), origin_right, batch_, K_,
                           batch_low_, N_);
@@ -195,11 +291,32 @@ void MatMul::run() {
       }
     }
   }
-  prim.execute(engine_stream, {{DNNL_ARG_SRC, src_mem},
-                               {DNNL_ARG_WEIGHTS, weight_mem},
-                               {DNNL_ARG_BIAS, bias_mem},
-                               {DNNL_ARG_DST, dst_mem}});
-  engine_stream.wait();
+  if (acc_i32) {
+    for (size_t i = 0; i < net.size(); ++i) {
+      net.at(i).execute(dnnl_stream(), net_args.at(i));
+    }
+    dnnl_stream().wait();
+    int64_t rows = batch_ * batch_low_ * M_;
+    auto acc = acc_i32->data();
+#pragma omp parallel for schedule(static, omp_schedule(rows))
+    for (int64_t r = 0; r < rows; r++) {
+      for (int64_t n = 0; n < N_; n++) {
+        int64_t i = r * N_ + n;
+        int32_t v = acc[i] + (int32_t)p_bias[n];
+        if (do_relu_ && v < 0) {
+          v = 0;
+        }
+        acc[i] = v;
+        origin_output[i] = v;
+      }
+    }
+  } else {
+    prim.execute(dnnl_stream(), {{DNNL_ARG_SRC, src_mem},
+                                 {DNNL_ARG_WEIGHTS, weight_mem},
+                                 {DNNL_ARG_BIAS, bias_mem},
+                                 {DNNL_ARG_DST, dst_mem}});
+    dnnl_stream().wait();
+  }
   if (output_transpose_) {
     if (hdim_is_batch_) {
       tensor_hc_transpose(output_after_trans->data(), origin_output, batch_,
@@ -8,12 +8,12 @@
 //===----------------------------------------------------------------------===//
 
 #include "tpu_mlir/Support/Dnnl/PRelu.h"
+#include "tpu_mlir/Support/Dnnl/DnnlUtils.h"
 using namespace dnnl;
 
 namespace tpu_mlir {
 PRelu::PRelu() {
-  eng = dnnl::engine(engine::kind::cpu, 0);
-  eng_stream = dnnl::stream(eng);
+  eng = dnnl_engine();
 }
 
 void PRelu::setup(/*float *input, float *output, prelu_attr_t &attr*/) {
@@ -26,10 +26,10 @@ void PRelu::setup(/*float *input, float *output, prelu_attr_t &attr*/) {
   prelu_prim = prelu_forward(prelu_pd);
 }
 void PRelu::run() {
-  prelu_prim.execute(eng_stream, {{DNNL_ARG_SRC, src_mem},
-                                  {DNNL_ARG_WEIGHTS, weights_mem},
-                                  {DNNL_ARG_DST, dst_mem}});
-  eng_stream.wait();
+  prelu_prim.execute(dnnl_stream(), {{DNNL_ARG_SRC, src_mem},
+                                      {DNNL_ARG_WEIGHTS, weights_mem},
+                                      {DNNL_ARG_DST, dst_mem}});
+  dnnl_stream().wait();
 }
 /*
 Binary::Binary() {
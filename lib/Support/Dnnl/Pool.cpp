@@ -8,14 +8,14 @@
 //===----------------------------------------------------------------------===//
 
 #include "tpu_mlir/Support/Dnnl/Pool.h"
+#include "tpu_mlir/Support/Dnnl/DnnlUtils.h"
 #include "tpu_mlir/Support/MathUtils.h"
 
 using namespace dnnl;
 using namespace tpu_mlir;
 
 Pooling::Pooling() {
-  eng = dnnl::engine(engine::kind::cpu, 0);
-  eng_stream = dnnl::stream(eng);
+  eng = dnnl_engine();
   memset(&_attrs, 0, sizeof(pool_attr_t));
   _izp = 0;
 }
@@ -73,6 +73,15 @@ void Pooling::setup(float *input, float *output, pool_attr_t attr, bool is_avg,
   prim = pooling_forward(prim_desc);
 }
 
+void Pooling::rebind(float *input, float *output) {
+  origin_input = input;
+  if (!input_after_pad) {
+    p_input = input;
+    src_mem.set_data_handle(input);
+  }
+  dst_mem.set_data_handle(output);
+}
+
 void Pooling::run() {
   if (input_after_pad) {
     pad_tensor(input_after_pad->data(), origin_input, _attrs.n, _attrs.c,
@@ -80,6 +89,6 @@ void Pooling::run() {
                _attrs.pad_d_after, _attrs.pad_h, _attrs.pad_h_after,
                _attrs.pad_w, _attrs.pad_w_after, _izp);
   }
-  prim.execute(eng_stream, {{DNNL_ARG_FROM, src_mem}, {DNNL_ARG_TO, dst_mem}});
-  eng_stream.wait();
+  prim.execute(dnnl_stream(), {{DNNL_ARG_FROM, src_mem}, {DNNL_ARG_TO, dst_mem}});
+  dnnl_stream().wait();
 }
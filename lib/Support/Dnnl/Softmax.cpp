@@ -9,6 +9,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "tpu_mlir/Support/Dnnl/Softmax.h"
+#include "tpu_mlir/Support/Dnnl/DnnlUtils.h"
 
 using namespace dnnl;
 using tag = memory::format_tag;
@@ -17,8 +18,7 @@ using dt = memory::data_type;
 namespace tpu_mlir {
 
 Softmax::Softmax() {
-  eng = dnnl::engine(engine::kind::cpu, 0);
-  eng_stream = dnnl::stream(eng);
+  eng = dnnl_engine();
 }
 
 void Softmax::setup(float *input, float *output, softmax_attr_t &attr) {
@@ -41,8 +41,8 @@ void Softmax::setup(float *input, float *output, softmax_attr_t &attr) {
 }
 
 void Softmax::run() {
-  softmax_prim.execute(eng_stream, softmax_args);
-  eng_stream.wait();
+  softmax_prim.execute(dnnl_stream(), softmax_args);
+  dnnl_stream().wait();
 }
 
 } // namespace tpu_mlir
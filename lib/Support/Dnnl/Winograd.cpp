@@ -0,0 +1,176 @@
+//===----------------------------------------------------------------------===//
+//
+// Copyright (C) 2022 Sophgo Technologies Inc.  All rights reserved.
+//
+// TPU-MLIR is licensed under the 2-Clause BSD License except for the
+// third-party components.
+//
+//===----------------------------------------------------------------------===//
+
+#include "tpu_mlir/Support/Dnnl/Winograd.h"
+#include "tpu_mlir/Support/Dnnl/DnnlUtils.h"
+#include "tpu_mlir/Support/MathUtils.h"
+#include "omp.h"
+
+namespace tpu_mlir {
+
+// A^T @ m @ A flattened as kron(A^T, A^T), applied as m @ AEQ^T
+static float AEQ[4][16] = {
+    {1., 1., 1., 0., 1., 1., 1., 0., 1., 1., 1., 0., 0., 0., 0., 0.},
+    {0., 1., -1., 1., 0., 1., -1., 1., 0., 1., -1., 1., 0., 0., 0., 0.},
+    {0., 0., 0., 0., 1., 1., 1., 0., -1., -1., -1., 0., 1., 1., 1., 0.},
+    {0., 0., 0., 0., 0., 1., -1., 1., 0., -1., 1., -1., 0., 1., -1., 1.}};
+
+void Winograd::setup(float *input, float *weight, float *output,
+                     conv_attr_t attr) {
+  std::vector<int64_t> key = {attr.n,   attr.ic,  attr.ih,        attr.iw,
+                              attr.oc,  attr.oh,  attr.ow,        attr.pht,
+                              attr.phb, attr.pwl, attr.pwr,       attr.pad_value,
+                              (int64_t)weight,
+                              (int64_t)weight_version};
+  p_input = input;
+  p_output = output;
+  if (key == prim_key) {
+    return;
+  }
+  _attr = attr;
+  int64_t ic = attr.ic, oc = attr.oc;
+  pih = attr.ih + attr.pht + attr.phb;
+  piw = attr.iw + attr.pwl + attr.pwr;
+  window_h = (pih - 4) / 2 + 1;
+  window_w = (piw - 4) / 2 + 1;
+  row_num = window_h * window_w;
+  need_pad = (attr.pht + attr.phb + attr.pwl + attr.pwr) > 0;
+  padded.assign(need_pad ? ic * pih * piw : 0, (float)attr.pad_value);
+  tiles.resize(row_num * ic * 16);
+  prod.resize(row_num * oc * 16);
+  result.resize(row_num * oc * 4);
+  rows.resize(omp_get_max_threads() * 4 * piw);
+
+  // (oc, ic, 16) -> (ic, oc, 16), so that the gemm reads a row per ic
+  auto gt = weight + ic * oc * 3 * 3;
+  filter.resize(ic * oc * 16);
+#pragma omp parallel for schedule(static, omp_schedule(ic))
+  for (int64_t j = 0; j < ic; j++) {
+    for (int64_t o = 0; o < oc; o++) {
+      memcpy(filter.data() + (j * oc + o) * 16, gt + (o * ic + j) * 16,
+             16 * sizeof(float));
+    }
+  }
+  output_matmul = std::make_shared<MatMul>();
+  output_matmul->setup(prod.data(), (float *)AEQ, nullptr, result.data(), 1, 1,
+                       row_num * oc, 16, 4, false, 0, 0, 0, true, false, false,
+                       false);
+  prim_key = std::move(key);
+}
+
+void Winograd::input_transform(const float *image) {
+  int64_t ic = _attr.ic;
+  // the thread limit may have been raised since setup()
+  if (rows.size() < (size_t)omp_get_max_threads() * 4 * piw) {
+    rows.resize(omp_get_max_threads() * 4 * piw);
+  }
+#pragma omp parallel for schedule(static, omp_schedule(ic))
+  for (int64_t ci = 0; ci < ic; ci++) {
+    const float *chan = image + ci * pih * piw;
+    // B^T @ d of a tile row, for all its columns at once
+    float *t0 = rows.data() + omp_get_thread_num() * 4 * piw;
+    float *t1 = t0 + piw, *t2 = t1 + piw, *t3 = t2 + piw;
+    for (int64_t ti = 0; ti < window_h; ti++) {
+      const float *d0 = chan + 2 * ti * piw;
+      const float *d1 = d0 + piw, *d2 = d1 + piw, *d3 = d2 + piw;
+#pragma omp simd
+      for (int64_t x = 0; x < piw; x++) {
+        t0[x] = d0[x] - d2[x];
+        t1[x] = d1[x] + d2[x];
+        t2[x] = d2[x] - d1[x];
+        t3[x] = d3[x] - d1[x];
+      }
+      // @ B on the 4 columns of each tile
+      for (int64_t tj = 0; tj < window_w; tj++) {
+        float *dst = tiles.data() + ((ti * window_w + tj) * ic + ci) * 16;
+        for (int a = 0; a < 4; a++) {
+          const float *v = t0 + a * piw + 2 * tj;
+          dst[a * 4 + 0] = v[0] - v[2];
+          dst[a * 4 + 1] = v[1] + v[2];
+          dst[a * 4 + 2] = v[2] - v[1];
+          dst[a * 4 + 3] = v[3] - v[1];
+        }
+      }
+    }
+  }
+}
+
+void Winograd::tile_gemm() {
+  int64_t ic = _attr.ic, oc = _attr.oc;
+  // blocks of tiles share each filter load, blocks of oc keep prod in cache.
+  // Every sum is still accumulated in ic order.
+  const int64_t row_block = 8, oc_block = 64;
+  int64_t num_block = ceiling_func(row_num, row_block);
+  const float *a = tiles.data(), *g = filter.data();
+  float *p = prod.data();
+#pragma omp parallel for schedule(static, omp_schedule(num_block))
+  for (int64_t b = 0; b < num_block; b++) {
+    int64_t r0 = b * row_block;
+    int64_t r1 = std::min(r0 + row_block, row_num);
+    for (int64_t o0 = 0; o0 < oc; o0 += oc_block) {
+      int64_t o1 = std::min(o0 + oc_block, oc);
+      for (int64_t r = r0; r < r1; r++) {
+        memset(p + (r * oc + o0) * 16, 0, (o1 - o0) * 16 * sizeof(float));
+      }
+      for (int64_t j = 0; j < ic; j++) {
+        for (int64_t o = o0; o < o1; o++) {
+          const float *g_jo = g + (j * oc + o) * 16;
+          for (int64_t r = r0; r < r1; r++) {
+            const float *a_rj = a + (r * ic + j) * 16;
+            float *p_ro = p + (r * oc + o) * 16;
+#pragma omp simd
+            for (int k = 0; k < 16; k++) {
+              p_ro[k] += a_rj[k] * g_jo[k];
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+void Winograd::output_fold(float *output) {
+  int64_t oc = _attr.oc, oh = _attr.oh, ow = _attr.ow;
+#pragma omp parallel for schedule(static, omp_schedule(row_num))
+  for (int64_t r = 0; r < row_num; r++) {
+    int64_t h0 = ((r * 2) / ow) * 2;
+    int64_t w0 = (r * 2) % ow;
+    for (int64_t c = 0; c < oc; c++) {
+      const float *res = result.data() + (r * oc + c) * 4;
+      float *out = output + (c * oh + h0) * ow + w0;
+      out[0] = res[0];
+      out[1] = res[1];
+      out[ow] = res[2];
+      out[ow + 1] = res[3];
+    }
+  }
+}
+
+void Winograd::run() {
+  int64_t ic = _attr.ic, ih = _attr.ih, iw = _attr.iw;
+  for (int64_t bs = 0; bs < _attr.n; bs++) {
+    const float *image = p_input + bs * ic * ih * iw;
+    if (need_pad) {
+#pragma omp parallel for schedule(static, omp_schedule(ic))
+      for (int64_t i = 0; i < ic; i++) {
+        for (int64_t j = 0; j < ih; j++) {
+          memcpy(padded.data() + (i * pih + j + _attr.pht) * piw + _attr.pwl,
+                 image + (i * ih + j) * iw, iw * sizeof(float));
+        }
+      }
+      image = padded.data();
+    }
+    input_transform(image);
+    tile_gemm();
+    output_matmul->run();
+    output_fold(p_output + bs * _attr.oc * _attr.oh * _attr.ow);
+  }
+}
+
+} // namespace tpu_mlir
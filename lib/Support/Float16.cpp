@@ -8,6 +8,7 @@
 //===----------------------------------------------------------------------===//
 #include "tpu_mlir/Support/Float16.h"
 #include "bitcasts.h"
+#include "tpu_mlir/Support/FloatConvert.h"
 #include "tpu_mlir/Support/MathUtils.h"
 #include <float.h>
 
@@ -791,20 +792,6 @@ float bf16_to_f32(uint16_t src) {
   return *((float *)&tmp);
 }
 
-void BF16(float *p_src, float *p_dst, int num, bool is_tpu) {
-#pragma omp parallel for schedule(static, omp_schedule(num))
-  for (int i = 0; i < num; i++) {
-    p_dst[i] = BF16(p_src[i], is_tpu);
-  }
-}
-
-void F16(float *p_src, float *p_dst, int num) {
-#pragma omp parallel for schedule(static, omp_schedule(num))
-  for (int i = 0; i < num; i++) {
-    p_dst[i] = F16(p_src[i]);
-  }
-}
-
 float F16(float src) {
   uint16_t tmp = f32_to_f16(src);
   return f16_to_f32(tmp);
@@ -826,6 +813,18 @@ float BF16(float src, bool is_tpu) {
   return bf16_to_f32(u16_val);
 }
 
+float F16(float src, RoundingMode round_mode) {
+  fp32 tmp = {.fval = src};
+  fp16 tmp16 = fp32_to_fp16_all(tmp, round_mode);
+  return f16_to_f32(tmp16.bits);
+}
+
+float BF16(float src, RoundingMode round_mode) {
+  fp32 tmp = {.fval = src};
+  bf16 tmp16 = fp32_to_bf16_all(tmp, round_mode);
+  return bf16_to_f32(tmp16.bits);
+}
+
 #define BF16_POSITIVE_MAX_VAL 0x7F7F
 #define BF16_NEGATIVE_MAX_VAL 0xFF7F
 #define BF16_POSITIVE_INF_EXP 0x7F80
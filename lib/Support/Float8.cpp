@@ -267,18 +267,14 @@ float F8E5M2(float src, float step, bool satu) {
   return f8e5m2_to_f32(f32_to_f8e5m2(src/step, satu));
 }
 
-void F8E4M3(const float *p_src, float *p_dst, int num, float step, bool satu) {
-#pragma omp parallel for schedule(static, omp_schedule(num))
-  for (int i=0;i<num;i++) {
-    p_dst[i] = F8E4M3(p_src[i], step, satu);
-  }
+float F8E4M3(float src, float step, bool satu, RoundingMode round_mode) {
+  fp32 tmp = {.fval = src / step};
+  return f8e4m3_to_f32(fp32_to_fp8(tmp, false, satu, round_mode));
 }
 
-void F8E5M2(const float *p_src, float *p_dst, int num, float step, bool satu) {
-#pragma omp parallel for schedule(static, omp_schedule(num))
-  for (int i=0;i<num;i++) {
-    p_dst[i] = F8E5M2(p_src[i], step, satu);
-  }
+float F8E5M2(float src, float step, bool satu, RoundingMode round_mode) {
+  fp32 tmp = {.fval = src / step};
+  return f8e5m2_to_f32(fp32_to_fp8(tmp, true, false, round_mode));
 }
 
 }
@@ -0,0 +1,413 @@
+//===----------------------------------------------------------------------===//
+//
+// Copyright (C) 2022 Sophgo Technologies Inc.  All rights reserved.
+//
+// TPU-MLIR is licensed under the 2-Clause BSD License except for the
+// third-party components.
+//
+//===----------------------------------------------------------------------===//
+
+// Bulk f32 -> f16/bf16/f8 -> f32 conversions.
+// Each conversion is written once as a branch free lane function on the
+// fp32 bits, following the per element code in Float16.cpp and Float8.cpp
+// case by case, and compiled for every instruction set in the dispatch
+// below. The rounding mode is a template parameter, so the lane function
+// keeps no mode switch.
+
+#include "tpu_mlir/Support/FloatConvert.h"
+#include "bitcasts.h"
+#include "tpu_mlir/Support/Module.h"
+
+// lane functions are inlined into the loop of each instruction set
+#define CONVERT_INLINE __attribute__((always_inline))
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CONVERT_X86 1
+#define CONVERT_TARGET(isa) __attribute__((target(isa)))
+#else
+#define CONVERT_X86 0
+#endif
+
+namespace tpu_mlir {
+
+// =======================
+// dispatch
+// =======================
+static ConvertISA detect_convert_isa() {
+#if CONVERT_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+      __builtin_cpu_supports("avx512vl")) {
+    return CONVERT_AVX512;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return CONVERT_AVX2;
+  }
+#endif
+  return CONVERT_GENERIC;
+}
+
+ConvertISA supported_convert_isa() {
+  static const ConvertISA isa = detect_convert_isa();
+  return isa;
+}
+
+static ConvertISA active_convert_isa = supported_convert_isa();
+
+ConvertISA convert_isa() { return active_convert_isa; }
+
+void set_convert_isa(ConvertISA isa) {
+  active_convert_isa = std::min(isa, supported_convert_isa());
+}
+
+template <typename Lane>
+static void convert_lanes(const float *p_src, float *p_dst, int64_t num,
+                          Lane lane) {
+#pragma omp simd
+  for (int64_t i = 0; i < num; i++) {
+    p_dst[i] = lane(p_src[i]);
+  }
+}
+
+#if CONVERT_X86
+template <typename Lane>
+CONVERT_TARGET("avx2")
+static void convert_lanes_avx2(const float *p_src, float *p_dst, int64_t num,
+                               Lane lane) {
+#pragma omp simd
+  for (int64_t i = 0; i < num; i++) {
+    p_dst[i] = lane(p_src[i]);
+  }
+}
+
+template <typename Lane>
+CONVERT_TARGET("avx512f,avx512bw,avx512vl")
+static void convert_lanes_avx512(const float *p_src, float *p_dst,
+                                 int64_t num, Lane lane) {
+#pragma omp simd
+  for (int64_t i = 0; i < num; i++) {
+    p_dst[i] = lane(p_src[i]);
+  }
+}
+#endif
+
+// reference is the per element function, lane the bulk one
+template <typename Ref, typename Lane>
+static void convert(const float *p_src, float *p_dst, int64_t num, Ref ref,
+                    Lane lane) {
+  auto isa = convert_isa();
+  const int64_t block = 4096;
+  int64_t num_block = ceiling_func(num, block);
+#pragma omp parallel for schedule(static, omp_schedule(num_block))
+  for (int64_t b = 0; b < num_block; b++) {
+    int64_t start = b * block;
+    int64_t len = std::min(block, num - start);
+    auto src = p_src + start;
+    auto dst = p_dst + start;
+    switch (isa) {
+    case CONVERT_SCALAR:
+      for (int64_t i = 0; i < len; i++) {
+        dst[i] = ref(src[i]);
+      }
+      break;
+#if CONVERT_X86
+    case CONVERT_AVX512:
+      convert_lanes_avx512(src, dst, len, lane);
+      break;
+    case CONVERT_AVX2:
+      convert_lanes_avx2(src, dst, len, lane);
+      break;
+#endif
+    default:
+      convert_lanes(src, dst, len, lane);
+      break;
+    }
+  }
+}
+
+// call f with the rounding mode as a template parameter. Every mode keeps
+// its own instance, the lane functions truncate for the ones RightShiftRound
+// doesn't handle, as the reference does
+template <typename F> static void with_round_mode(RoundingMode rmode, F f) {
+  switch (rmode) {
+  case ROUNDING_HALF_AWAY_FROM_ZERO:
+    return f(std::integral_constant<RoundingMode,
+                                    ROUNDING_HALF_AWAY_FROM_ZERO>());
+  case ROUNDING_HALF_UP:
+    return f(std::integral_constant<RoundingMode, ROUNDING_HALF_UP>());
+  case ROUNDING_HALF_DOWN:
+    return f(std::integral_constant<RoundingMode, ROUNDING_HALF_DOWN>());
+  case ROUNDING_HALF_TO_EVEN:
+    return f(std::integral_constant<RoundingMode, ROUNDING_HALF_TO_EVEN>());
+  case ROUNDING_HALF_TO_ODD:
+    return f(std::integral_constant<RoundingMode, ROUNDING_HALF_TO_ODD>());
+  case ROUNDING_HALF_TOWARDS_ZERO:
+    return f(std::integral_constant<RoundingMode,
+                                    ROUNDING_HALF_TOWARDS_ZERO>());
+  case ROUNDING_TOWARDS_ZERO:
+    return f(std::integral_constant<RoundingMode, ROUNDING_TOWARDS_ZERO>());
+  case ROUNDING_AWAY_FROM_ZERO:
+    return f(std::integral_constant<RoundingMode, ROUNDING_AWAY_FROM_ZERO>());
+  case ROUNDING_UP:
+    return f(std::integral_constant<RoundingMode, ROUNDING_UP>());
+  case ROUNDING_DOWN:
+    return f(std::integral_constant<RoundingMode, ROUNDING_DOWN>());
+  default:
+    return f(std::integral_constant<RoundingMode, ROUNDING_UNKNOWN>());
+  }
+}
+
+// =======================
+// rounding
+// =======================
+
+// RightShiftRound(bits, S) of the fp32 bits taken as a positive number, with
+// ROUNDING_DOWN and ROUNDING_UP following the sign of the float
+template <RoundingMode R, int S>
+static inline CONVERT_INLINE uint32_t round_bits(uint32_t x) {
+  const uint32_t half = 1u << (S - 1);
+  uint32_t val = x >> S;
+  uint32_t mant = x & ((1u << S) - 1);
+  uint32_t neg = x >> 31;
+  if constexpr (R == ROUNDING_HALF_TO_EVEN) {
+    return val + ((mant + (val & 1)) > half);
+  } else if constexpr (R == ROUNDING_HALF_AWAY_FROM_ZERO ||
+                       R == ROUNDING_HALF_UP) {
+    return val + (mant >= half);
+  } else if constexpr (R == ROUNDING_HALF_DOWN) {
+    return val + (mant > half);
+  } else if constexpr (R == ROUNDING_DOWN) {
+    return val + (neg & (mant != 0));
+  } else if constexpr (R == ROUNDING_UP) {
+    return val + ((neg ^ 1) & (mant != 0));
+  } else {
+    return val;
+  }
+}
+
+// RightShiftRound(src, shift) for |src| < 2^24; any shift above 30 gives
+// the same result as 30 for such src
+template <RoundingMode R>
+static inline CONVERT_INLINE int32_t round_shift(int32_t src, int32_t shift) {
+  shift = std::max(1, std::min(shift, 30));
+  int32_t half = 1 << (shift - 1);
+  int32_t val = src >> shift;
+  int32_t mant = src & ((1 << shift) - 1);
+  if constexpr (R == ROUNDING_HALF_TO_EVEN) {
+    return val + ((mant + (val & 1)) > half);
+  } else if constexpr (R == ROUNDING_HALF_AWAY_FROM_ZERO) {
+    return val + ((mant + (src >= 0)) > half);
+  } else if constexpr (R == ROUNDING_TOWARDS_ZERO) {
+    return val + ((src < 0) & (mant != 0));
+  } else if constexpr (R == ROUNDING_UP) {
+    return val + (mant != 0);
+  } else if constexpr (R == ROUNDING_HALF_UP) {
+    return val + (mant >= half);
+  } else if constexpr (R == ROUNDING_HALF_DOWN) {
+    return val + (mant > half);
+  } else {
+    return val;
+  }
+}
+
+// =======================
+// lane functions
+// =======================
+
+// fp32_to_fp16_all + f16_to_f32
+template <RoundingMode R> static inline CONVERT_INLINE float f16_lane(float src) {
+  uint32_t x = fp32_to_bits(src);
+  uint32_t sign = x & 0x80000000u;
+  uint32_t exp = (x >> 23) & 0xff;
+  // f16 normal, rounded in fp32 then overflow to inf
+  uint32_t y = round_bits<R, 13>(x) << 13;
+  uint32_t inf = sign | 0x7f800000u;
+  uint32_t normal = ((y >> 23) & 0xff) > 142 ? inf : y;
+  // f16 denormal, m * 2^-24 with m <= 0x400, normalized without int to
+  // float conversion which would keep the loop from vectorizing
+  int32_t neg = -(int32_t)(x >> 31);
+  int32_t mant = (int32_t)((x & 0x7fffff) | 0x800000);
+  mant = (mant ^ neg) - neg;
+  mant = round_shift<R>(mant, 126 - (int32_t)exp);
+  mant = (mant ^ neg) - neg;
+  uint32_t m = mant;
+  uint32_t e = (m >= 2) + (m >= 4) + (m >= 8) + (m >= 16) + (m >= 32) +
+               (m >= 64) + (m >= 128) + (m >= 256) + (m >= 512) + (m >= 1024);
+  uint32_t denorm = m ? ((e + 127 - 24) << 23) | ((m << (23 - e)) & 0x7fffff)
+                      : 0;
+  denorm |= sign;
+  uint32_t res = exp > 112 ? normal : denorm;
+  res = exp == 0 ? sign : res;
+  res = exp == 255 ? ((x & 0x7fffff) ? 0xffc00000u : inf) : res;
+  return fp32_from_bits(res);
+}
+
+// fp32_to_bf16_all + bf16_to_f32
+template <RoundingMode R> static inline CONVERT_INLINE float bf16_lane(float src) {
+  uint32_t x = fp32_to_bits(src);
+  uint32_t sign = x & 0x80000000u;
+  uint32_t exp = (x >> 23) & 0xff;
+  uint32_t frac = x & 0x7fffff;
+  uint32_t normal = round_bits<R, 16>(x) << 16;
+  // fp32_to_bf16_denorm, only 0x007f0001-0x007fffff round to +-0x80
+  uint32_t up, half_up;
+  if constexpr (R == ROUNDING_HALF_TO_EVEN ||
+                R == ROUNDING_HALF_AWAY_FROM_ZERO) {
+    up = 0;
+    half_up = 0x800000;
+  } else if constexpr (R == ROUNDING_TOWARDS_ZERO) {
+    up = 0;
+    half_up = 0;
+  } else if constexpr (R == ROUNDING_DOWN) {
+    up = sign ? 0x800000 : 0;
+    half_up = up;
+  } else {
+    up = sign ? 0 : 0x800000;
+    half_up = up;
+  }
+  uint32_t denorm = (frac & 0x8000) ? half_up : up;
+  denorm = ((frac >> 16) == 0x7f && (frac & 0xffff)) ? denorm : 0;
+  uint32_t res = exp == 0 ? (sign | denorm) : normal;
+  res = exp == 255 ? (frac ? 0x7fff0000u : x) : res;
+  return fp32_from_bits(res);
+}
+
+// cvi_f32_to_bf16 + bf16_to_f32
+static inline CONVERT_INLINE float bf16_cv18xx_lane(float src) {
+  uint32_t x = fp32_to_bits(src);
+  x += 0x7fff + ((x >> 16) & 1);
+  x &= 0xffff0000u;
+  return fp32_from_bits((x & 0x7f800000u) == 0x7f800000u ? 0x7f7f0000u : x);
+}
+
+static inline CONVERT_INLINE float bf16_truncate_lane(float src) {
+  return fp32_from_bits(fp32_to_bits(src) & 0xffff0000u);
+}
+
+// fp32_to_fp8 to the f8 bits, decoded by the caller
+template <bool E5M2, bool SATU, RoundingMode R>
+static inline CONVERT_INLINE uint32_t f8_lane(float src) {
+  constexpr uint32_t BIAS = E5M2 ? 15 : 7;
+  constexpr uint32_t SIG = E5M2 ? 3 : 4;
+  constexpr uint32_t MAXNORM = E5M2 ? 0x7b : 0x7e;
+  constexpr uint32_t MANT_MASK = E5M2 ? 0x3 : 0x7;
+  constexpr uint32_t EXP_MASK = E5M2 ? 0x1f : 0xf;
+  constexpr int SHIFT = 24 - SIG;
+  // inf in E5M2, NaN in E4M3
+  constexpr uint32_t OVERFLOW = SATU ? MAXNORM : (E5M2 ? 0x7c : 0x7f);
+  uint32_t x = fp32_to_bits(src);
+  uint32_t sign = x >> 31;
+  uint32_t exp = (x >> 23) & 0xff;
+  uint32_t frac = x & 0x7fffff;
+  // f8 normal
+  uint32_t tmp = round_bits<R, SHIFT>(x) << SHIFT;
+  uint32_t e = ((tmp >> 23) & 0xff) - 127 + BIAS;
+  uint32_t f = (tmp >> SHIFT) & MANT_MASK;
+  bool overflow = (e > EXP_MASK) | ((e == EXP_MASK) & ((f == MANT_MASK) | E5M2));
+  uint32_t normal = overflow ? OVERFLOW : ((e << (SIG - 1)) | f);
+  // f8 denormal
+  int32_t mant = (int32_t)(frac | 0x800000);
+  mant = sign ? -mant : mant;
+  mant = round_shift<R>(mant, (int32_t)(128 - BIAS + SHIFT) - (int32_t)exp);
+  mant = sign ? -mant : mant;
+  uint32_t denorm = mant & 0x7f;
+  uint32_t res = exp > 127 - BIAS ? normal : denorm;
+  res = exp == 0 ? 0 : res;
+  // canonical NaN is 0x7f in both
+  res = exp == 255 ? (frac ? 0x7f : OVERFLOW) : res;
+  return res | (sign << 7);
+}
+
+// f8 bits to fp32 bits, filled from the reference decoder
+struct F8Table {
+  uint32_t e4m3[256];
+  uint32_t e5m2[256];
+  F8Table() {
+    for (int i = 0; i < 256; i++) {
+      e4m3[i] = fp32_to_bits(f8e4m3_to_f32(i));
+      e5m2[i] = fp32_to_bits(f8e5m2_to_f32(i));
+    }
+  }
+};
+static const F8Table f8_table;
+
+// =======================
+// bulk conversions
+// =======================
+void F16(float *p_src, float *p_dst, int num, RoundingMode round_mode) {
+  with_round_mode(round_mode, [&](auto mode) {
+    constexpr RoundingMode R = decltype(mode)::value;
+    convert(
+        p_src, p_dst, num, [](float v) { return F16(v, R); },
+        [](float v) CONVERT_INLINE { return f16_lane<R>(v); });
+  });
+}
+
+void BF16(float *p_src, float *p_dst, int num, RoundingMode round_mode) {
+  with_round_mode(round_mode, [&](auto mode) {
+    constexpr RoundingMode R = decltype(mode)::value;
+    convert(
+        p_src, p_dst, num, [](float v) { return BF16(v, R); },
+        [](float v) CONVERT_INLINE { return bf16_lane<R>(v); });
+  });
+}
+
+template <bool E5M2, bool SATU>
+static void f8_convert(const float *p_src, float *p_dst, int64_t num,
+                       float step, RoundingMode round_mode) {
+  const uint32_t *table = E5M2 ? f8_table.e5m2 : f8_table.e4m3;
+  with_round_mode(round_mode, [&](auto mode) {
+    constexpr RoundingMode R = decltype(mode)::value;
+    convert(
+        p_src, p_dst, num,
+        [=](float v) {
+          return E5M2 ? F8E5M2(v, step, SATU, R) : F8E4M3(v, step, SATU, R);
+        },
+        [=](float v) CONVERT_INLINE {
+          return fp32_from_bits(table[f8_lane<E5M2, SATU, R>(v / step)]);
+        });
+  });
+}
+
+void F8E4M3(const float *p_src, float *p_dst, int num, float step, bool satu,
+            RoundingMode round_mode) {
+  if (satu) {
+    f8_convert<false, true>(p_src, p_dst, num, step, round_mode);
+  } else {
+    f8_convert<false, false>(p_src, p_dst, num, step, round_mode);
+  }
+}
+
+void F8E5M2(const float *p_src, float *p_dst, int num, float step, bool satu,
+            RoundingMode round_mode) {
+  f8_convert<true, false>(p_src, p_dst, num, step, round_mode);
+}
+
+// entries of Float16.h and Float8.h
+void F16(float *p_src, float *p_dst, int num) {
+  F16(p_src, p_dst, num, ROUNDING_HALF_TO_EVEN);
+}
+
+void BF16(float *p_src, float *p_dst, int num, bool is_tpu) {
+  if (!module::isCV18xx()) {
+    BF16(p_src, p_dst, num, ROUNDING_HALF_TO_EVEN);
+  } else if (is_tpu) {
+    convert(
+        p_src, p_dst, num, [](float v) { return BF16(v, true); },
+        [](float v) CONVERT_INLINE { return bf16_cv18xx_lane(v); });
+  } else {
+    convert(
+        p_src, p_dst, num, [](float v) { return BF16(v, false); },
+        [](float v) CONVERT_INLINE { return bf16_truncate_lane(v); });
+  }
+}
+
+void F8E4M3(const float *p_src, float *p_dst, int num, float step, bool satu) {
+  F8E4M3(p_src, p_dst, num, step, satu, ROUNDING_HALF_TO_EVEN);
+}
+
+void F8E5M2(const float *p_src, float *p_dst, int num, float step, bool satu) {
+  F8E5M2(p_src, p_dst, num, step, satu, ROUNDING_HALF_TO_EVEN);
+}
+
+} // namespace tpu_mlir
@@ -9,7 +9,9 @@
 
 #include "float.h"
 #include "omp.h"
+#include <atomic>
 #include "tpu_mlir/Support/Dnnl/Dnnl.h"
+#include "tpu_mlir/Support/Dnnl/DnnlUtils.h"
 #include "llvm/Support/Debug.h"
 
 #define DEBUG_TYPE "math_utils"
@@ -544,6 +546,158 @@ int64_t applyMultiplierAndRShift(int64_t v, int64_t multiplier, int64_t rshift,
   return 0;
 }
 
+// RightShiftRound for 0 < shift <= 63
+template <RoundingMode R>
+static inline int64_t rshift_round(int64_t src, int shift) {
+  int64_t val = src >> shift;
+  int64_t mant = src & (int64_t)((1ull << shift) - 1);
+  int64_t half = 1ull << (shift - 1);
+  if constexpr (R == ROUNDING_HALF_TO_EVEN) {
+    return mant == half ? val + (val & 1) : val + (mant > half);
+  } else if constexpr (R == ROUNDING_HALF_AWAY_FROM_ZERO) {
+    return val + (src >= 0 ? mant >= half : mant > half);
+  } else if constexpr (R == ROUNDING_TOWARDS_ZERO) {
+    return val + (src < 0 && mant != 0);
+  } else if constexpr (R == ROUNDING_UP) {
+    return val + (mant != 0);
+  } else if constexpr (R == ROUNDING_HALF_UP) {
+    return val + (mant >= half);
+  } else if constexpr (R == ROUNDING_HALF_DOWN) {
+    return val + (mant > half);
+  } else {
+    return val;
+  }
+}
+
+enum { RQ_MULTIPLIER_SHIFT, RQ_ONLY_SHIFT, RQ_CV18XX, RQ_TFLITE };
+
+// ints held in floats are offset in float as the scalar callers do, s32
+// accumulators in int64
+static inline int64_t requant_input(float src, float in_offset) {
+  return (int64_t)(src + in_offset);
+}
+static inline int64_t requant_input(int32_t src, int32_t in_offset) {
+  return (int64_t)src + in_offset;
+}
+
+template <int KIND, RoundingMode R, typename T>
+static void requant_impl(const T *src, float *dst, int64_t len, T in_offset,
+                         int64_t multiplier, int64_t shift, int64_t out_zp,
+                         int64_t lo, int64_t hi) {
+  // shift cases are decided out of the loop, the body is branch free
+  auto for_each = [&](auto requant) {
+#pragma omp simd
+    for (int64_t i = 0; i < len; i++) {
+      int64_t v = requant(requant_input(src[i], in_offset)) + out_zp;
+      v = v < lo ? lo : v;
+      dst[i] = v > hi ? hi : v;
+    }
+  };
+  if constexpr (KIND == RQ_TFLITE) {
+    int32_t multi = multiplier;
+    int32_t lshift = shift;
+    int rshift = lshift < 0 ? std::min(-lshift, 63) : 0;
+    auto mul = [=](int64_t x) -> int64_t {
+      int32_t x32 = x;
+      int64_t value = lshift > 0 ? x32 << lshift : x32;
+      value = rshift_round<ROUNDING_HALF_UP>(value * multi, 31);
+      value = value > INT32_MAX ? INT32_MAX : value;
+      return value < INT32_MIN ? INT32_MIN : value;
+    };
+    if (rshift > 0) {
+      for_each([=](int64_t x) { return rshift_round<R>(mul(x), rshift); });
+    } else {
+      for_each(mul);
+    }
+  } else if constexpr (KIND == RQ_CV18XX) {
+    for_each([=](int64_t x) {
+      return to_int((((float)x * multiplier)) / (1 << shift), R);
+    });
+  } else {
+    int64_t multi = KIND == RQ_ONLY_SHIFT ? 1 : multiplier;
+    int s = std::min((int)shift, 63);
+    if (s > 0) {
+      for_each([=](int64_t x) { return rshift_round<R>(x * multi, s); });
+    } else if (s == 0) {
+      for_each([=](int64_t x) { return x * multi; });
+    } else {
+      for_each([=](int64_t x) { return (x * multi) << (-s); });
+    }
+  }
+}
+
+template <int KIND, typename T>
+static auto select_requant(RoundingMode rmode) {
+  switch (rmode) {
+  case ROUNDING_HALF_AWAY_FROM_ZERO:
+    return requant_impl<KIND, ROUNDING_HALF_AWAY_FROM_ZERO, T>;
+  case ROUNDING_HALF_UP:
+    return requant_impl<KIND, ROUNDING_HALF_UP, T>;
+  case ROUNDING_HALF_DOWN:
+    return requant_impl<KIND, ROUNDING_HALF_DOWN, T>;
+  case ROUNDING_HALF_TO_EVEN:
+    return requant_impl<KIND, ROUNDING_HALF_TO_EVEN, T>;
+  case ROUNDING_TOWARDS_ZERO:
+    return requant_impl<KIND, ROUNDING_TOWARDS_ZERO, T>;
+  case ROUNDING_UP:
+    return requant_impl<KIND, ROUNDING_UP, T>;
+  case ROUNDING_DOWN:
+    return requant_impl<KIND, ROUNDING_DOWN, T>;
+  default:
+    // truncates in RightShiftRound, rejected by to_int
+    return requant_impl<KIND, ROUNDING_UNKNOWN, T>;
+  }
+}
+
+template <int KIND>
+static void select_requant(RequantKernel &kernel, RoundingMode rmode) {
+  kernel.fn = select_requant<KIND, float>(rmode);
+  kernel.fn_i32 = select_requant<KIND, int32_t>(rmode);
+}
+
+RequantKernel get_requant_kernel(tpu::RequantMode qmode, RoundingMode rmode,
+                                 mlir::Type o_sType, bool do_relu,
+                                 int64_t out_zp) {
+  auto itype = dyn_cast<mlir::IntegerType>(o_sType);
+  if (!itype) {
+    o_sType.dump();
+    llvm_unreachable("not support type");
+  }
+  RequantKernel kernel;
+  auto N = itype.getWidth();
+  if (itype.isUnsigned()) {
+    kernel.hi = llvm::maxUIntN(N);
+    kernel.lo = 0;
+  } else {
+    kernel.hi = llvm::maxIntN(N);
+    kernel.lo = llvm::minIntN(N);
+  }
+  if (do_relu) {
+    kernel.lo = std::max(kernel.lo, out_zp);
+  }
+  switch (qmode) {
+  case tpu::RequantMode::MultiplierShift:
+    if (module::isCV18xx()) {
+      select_requant<RQ_CV18XX>(kernel, rmode);
+    } else {
+      select_requant<RQ_MULTIPLIER_SHIFT>(kernel, rmode);
+    }
+    return kernel;
+  case tpu::RequantMode::OnlyShift:
+    select_requant<RQ_ONLY_SHIFT>(kernel, rmode);
+    return kernel;
+  case tpu::RequantMode::QDM:
+  case tpu::RequantMode::TFLite:
+  case tpu::RequantMode::TFLite_LShift:
+    select_requant<RQ_TFLITE>(kernel, rmode);
+    return kernel;
+  case tpu::RequantMode::OnlyScale:
+    llvm_unreachable("FIXME: should use other implementation for this mode.");
+  }
+  llvm_unreachable("unsupport quant multiplier mode.");
+  return kernel;
+}
+
 RoundingMode round_mode_convert(tpu::RoundMode mode) {
   switch (mode) {
   case tpu::RoundMode::HalfAwayFromZero:
@@ -834,6 +988,42 @@ int omp_schedule(int count) {
   return (count + omp_get_num_threads() - 1) / omp_get_num_threads();
 }
 
+static std::atomic<int> num_threads_set(0);
+static std::atomic<int> num_invokes_set(1);
+
+static int default_num_threads() {
+  if (auto env = std::getenv("TPUMLIR_NUM_THREADS")) {
+    int num = std::atoi(env);
+    if (num > 0) {
+      return num;
+    }
+  }
+  return omp_get_max_threads();
+}
+
+void set_num_threads(int num) { num_threads_set = std::max(num, 0); }
+
+int get_num_threads() {
+  static const int num_threads_default = default_num_threads();
+  int num = num_threads_set;
+  return num > 0 ? num : num_threads_default;
+}
+
+void set_concurrent_invokes(int num) { num_invokes_set = std::max(num, 1); }
+
+int get_concurrent_invokes() { return num_invokes_set; }
+
+ThreadBudget::ThreadBudget() : saved_threads(omp_get_max_threads()) {
+  // the setting is per native thread, so it is applied on every entry
+  omp_set_num_threads(
+      std::max(1, get_num_threads() / get_concurrent_invokes()));
+}
+
+ThreadBudget::~ThreadBudget() {
+  // give the calling thread back the team size it had before the invoke
+  omp_set_num_threads(saved_threads);
+}
+
 void function_relu(float *src, float *dst, int64_t size, float relu_limit,
                    mlir::Type elem_type) {
 #pragma omp parallel for schedule(static, omp_schedule(size))
@@ -867,8 +1057,8 @@ int dnnl_mm(float *input, float *weight, float *bias, float *output, int m,
   using tag = memory::format_tag;
   using dt = memory::data_type;
 
-  engine eng(engine::kind::cpu, 0);
-  stream s(eng);
+  const engine &eng = dnnl_engine();
+  stream &s = dnnl_stream();
 
   std::vector<primitive> net;
   std::vector<std::unordered_map<int, memory>> net_args;
@@ -6,10 +6,14 @@
 // third-party components.
 //
 //===----------------------------------------------------------------------===//
+#include <atomic>
 #include <fstream>
+#include <mutex>
+#include "omp.h"
 #include "tpu_mlir/Backend/Arch.h"
 #include "tpu_mlir/Support/MathUtils.h"
 #include "tpu_mlir/Support/ModuleEnum.cpp.inc"
+#include "llvm/Support/FileSystem.h"
 
 static uint64_t core_addr[8] = {
     // according to TPU1686/sgdnn_tmp/src/sgdnn_api_common.cpp
@@ -53,30 +57,53 @@ struct Attr {
   static constexpr llvm::StringRef TOP_RUN_MODE = "module.top_run_mode";
 };
 
-static ModuleOp m = nullptr;
-static MLIRContext *ctx = nullptr;
-static Chip chip = Chip::ALL;
-static Platform platform = Platform::ONNX;
-static std::unique_ptr<mlir::TensorFile> wFile = nullptr;
-static std::string weightFileName = "";
-static std::string debug_cmd = "";
+struct Session {
+  ModuleOp m = nullptr;
+  MLIRContext *ctx = nullptr;
+  Chip chip = Chip::ALL;
+  Platform platform = Platform::ONNX;
+  std::shared_ptr<mlir::TensorFile> wFile = nullptr;
+  std::string weightFileName = "";
+  bool weightFileLazy = false;
+  std::string debug_cmd = "";
+  // weight file is read only, shared with the sessions reading the same one
+  bool sharedWeightFile = false;
+};
+
+// used by threads without a bound session, i.e. the tools and passes
+static Session process_session;
+static thread_local Session *bound_session = nullptr;
+// sessions of createSession alive
+static std::atomic<int> num_sessions(0);
+
+static inline Session &session() {
+  if (bound_session != nullptr) {
+    return *bound_session;
+  }
+  // an openmp worker bind_session did not reach reads the process session
+  // instead of the one of its module
+  assert((num_sessions == 0 || omp_get_thread_num() == 0) &&
+         "openmp worker without the session of its module");
+  return process_session;
+}
 
 void init(ModuleOp module) {
-  m = module;
-  ctx = m.getContext();
-  auto chip_ = m->getAttrOfType<StringAttr>(Attr::CHIP);
-  chip = symbolizeChip(chip_).value_or(Chip::ALL);
-  wFile = nullptr;
-  if (m->hasAttrOfType<StringAttr>(Attr::PLATFORM)) {
-    auto p = m->getAttrOfType<StringAttr>(Attr::PLATFORM);
-    platform = symbolizePlatform(p).value_or(Platform::ONNX);
+  auto &ss = session();
+  ss.m = module;
+  ss.ctx = ss.m.getContext();
+  auto chip_ = ss.m->getAttrOfType<StringAttr>(Attr::CHIP);
+  ss.chip = symbolizeChip(chip_).value_or(Chip::ALL);
+  ss.wFile = nullptr;
+  if (ss.m->hasAttrOfType<StringAttr>(Attr::PLATFORM)) {
+    auto p = ss.m->getAttrOfType<StringAttr>(Attr::PLATFORM);
+    ss.platform = symbolizePlatform(p).value_or(Platform::ONNX);
   } else {
-    platform = Platform::ONNX;
+    ss.platform = Platform::ONNX;
   }
 
   std::ifstream file("/tmp/debug_cmd");
   if (file.is_open()) {
-    std::getline(file, debug_cmd);
+    std::getline(file, ss.debug_cmd);
     file.close();
   }
 }
@@ -223,7 +250,7 @@ Value getOperand(Operation *op, int i) {
 }
 
 static void updateModuleTypes(ModuleOp s) {
-  Builder builder(ctx);
+  Builder builder(session().ctx);
   // update callee func's return types
   for (auto func : s.getOps<FuncOp>()) {
     if (func.getName() == "main") {
@@ -921,7 +948,7 @@ int64_t getCoeffSize(ModuleOp s) {
 }
 
 void setCoeffSize(ModuleOp s, int64_t size) {
-  s->setAttr(Attr::COEFF_SIZE, Builder(ctx).getI64IntegerAttr(size));
+  s->setAttr(Attr::COEFF_SIZE, Builder(session().ctx).getI64IntegerAttr(size));
 }
 
 int64_t getGmemPrivateSize(ModuleOp s) {
@@ -929,28 +956,31 @@ int64_t getGmemPrivateSize(ModuleOp s) {
 }
 
 void setGmemPrivateSize(ModuleOp s, int64_t size) {
-  s->setAttr(Attr::GMEM_PRIVATE_SIZE, Builder(ctx).getI64IntegerAttr(size));
+  s->setAttr(Attr::GMEM_PRIVATE_SIZE,
+             Builder(session().ctx).getI64IntegerAttr(size));
 }
 
 int64_t getCoreNum() {
-  if (auto cores = m->getAttrOfType<IntegerAttr>(Attr::CORES))
+  if (auto cores = session().m->getAttrOfType<IntegerAttr>(Attr::CORES))
     return cores.getInt();
   return 1;
 }
 
 void setCoreNum(int64_t core_num) {
-  m->setAttr(Attr::CORES, Builder(ctx).getI64IntegerAttr(core_num));
+  session().m->setAttr(Attr::CORES,
+                       Builder(session().ctx).getI64IntegerAttr(core_num));
 }
 
 int64_t getDeviceNum() {
-  if (auto devices = m->getAttrOfType<IntegerAttr>(Attr::DEVICES)) {
+  if (auto devices = session().m->getAttrOfType<IntegerAttr>(Attr::DEVICES)) {
     return devices.getInt();
   }
   return 1;
 }
 
 void setDeviceNum(int64_t device_num) {
-  m->setAttr(Attr::DEVICES, Builder(ctx).getI64IntegerAttr(device_num));
+  session().m->setAttr(Attr::DEVICES,
+                       Builder(session().ctx).getI64IntegerAttr(device_num));
 }
 
 int64_t getCoeffAddr(ModuleOp s) {
@@ -958,7 +988,7 @@ int64_t getCoeffAddr(ModuleOp s) {
 }
 
 void setCoeffAddr(ModuleOp s, int64_t addr) {
-  s->setAttr(Attr::COEFF_ADDR, Builder(ctx).getI64IntegerAttr(addr));
+  s->setAttr(Attr::COEFF_ADDR, Builder(session().ctx).getI64IntegerAttr(addr));
 }
 
 int64_t getNeuronSize(ModuleOp s) {
@@ -966,7 +996,7 @@ int64_t getNeuronSize(ModuleOp s) {
 }
 
 void setNeuronSize(ModuleOp s, int64_t size) {
-  s->setAttr(Attr::NEURON_SIZE, Builder(ctx).getI64IntegerAttr(size));
+  s->setAttr(Attr::NEURON_SIZE, Builder(session().ctx).getI64IntegerAttr(size));
 }
 
 int64_t getNeuronAddr(ModuleOp s) {
@@ -974,7 +1004,7 @@ int64_t getNeuronAddr(ModuleOp s) {
 }
 
 void setNeuronAddr(ModuleOp s, int64_t addr) {
-  s->setAttr(Attr::NEURON_ADDR, Builder(ctx).getI64IntegerAttr(addr));
+  s->setAttr(Attr::NEURON_ADDR, Builder(session().ctx).getI64IntegerAttr(addr));
 }
 
 int64_t getIOSize(ModuleOp s) {
@@ -985,7 +1015,7 @@ int64_t getIOSize(ModuleOp s) {
 }
 
 void setIOSize(ModuleOp s, int64_t size) {
-  s->setAttr(Attr::IO_SIZE, Builder(ctx).getI64IntegerAttr(size));
+  s->setAttr(Attr::IO_SIZE, Builder(session().ctx).getI64IntegerAttr(size));
 }
 
 int64_t getIOAddr(ModuleOp s) {
@@ -996,75 +1026,76 @@ int64_t getIOAddr(ModuleOp s) {
 }
 
 void setIOAddr(ModuleOp s, int64_t addr) {
-  s->setAttr(Attr::IO_ADDR, Builder(ctx).getI64IntegerAttr(addr));
+  s->setAttr(Attr::IO_ADDR, Builder(session().ctx).getI64IntegerAttr(addr));
 }
 
 llvm::StringRef getPostprocess() {
-  if (m->hasAttrOfType<StringAttr>(Attr::POSTPROCESS)) {
-    return m->getAttrOfType<StringAttr>(Attr::POSTPROCESS).strref();
+  if (session().m->hasAttrOfType<StringAttr>(Attr::POSTPROCESS)) {
+    return session().m->getAttrOfType<StringAttr>(Attr::POSTPROCESS).strref();
   }
   return llvm::StringRef("");
 }
 
 void setPostprocess(StringRef post) {
-  m->setAttr(Attr::POSTPROCESS, Builder(ctx).getStringAttr(post));
+  session().m->setAttr(Attr::POSTPROCESS,
+                       Builder(session().ctx).getStringAttr(post));
 }
 
-Chip getChip() { return chip; }
+Chip getChip() { return session().chip; }
 
 Mode getMode() {
-  if (false == m->hasAttrOfType<StringAttr>(Attr::MODE)) {
+  if (false == session().m->hasAttrOfType<StringAttr>(Attr::MODE)) {
     return Mode::F32;
   }
-  auto s = m->getAttrOfType<StringAttr>(Attr::MODE);
+  auto s = session().m->getAttrOfType<StringAttr>(Attr::MODE);
   return symbolizeMode(s).value_or(Mode::F32);
 }
 
 bool isBF16Modes() {
-  auto s = m->getAttrOfType<StringAttr>(Attr::MODE);
+  auto s = session().m->getAttrOfType<StringAttr>(Attr::MODE);
   auto mode = symbolizeMode(s).value_or(Mode::F32);
   return mode == Mode::BF16 || mode == Mode::W8BF16 || mode == Mode::W4BF16;
 }
 
 bool isF16Modes() {
-  auto s = m->getAttrOfType<StringAttr>(Attr::MODE);
+  auto s = session().m->getAttrOfType<StringAttr>(Attr::MODE);
   auto mode = symbolizeMode(s).value_or(Mode::F32);
   return mode == Mode::F16 || mode == Mode::W8F16 || mode == Mode::W4F16;
 }
 
 bool isF8Modes() {
-  auto s = m->getAttrOfType<StringAttr>(Attr::MODE);
+  auto s = session().m->getAttrOfType<StringAttr>(Attr::MODE);
   auto mode = symbolizeMode(s).value_or(Mode::F32);
   return mode == Mode::F8 || mode == Mode::F8E4M3 || mode == Mode::F8E5M2;
 }
 
 void setChip(Chip chip_) {
-  chip = chip_;
+  session().chip = chip_;
   auto s = stringifyChip(chip_);
-  m->setAttr(Attr::CHIP, StringAttr::get(m.getContext(), s));
+  session().m->setAttr(Attr::CHIP, StringAttr::get(session().ctx, s));
 }
 
-bool isChip(Chip chip_) { return chip == chip_; }
+bool isChip(Chip chip_) { return session().chip == chip_; }
 
 void setMode(Mode mode) {
   auto s = stringifyMode(mode);
-  m->setAttr(Attr::MODE, StringAttr::get(ctx, s));
+  session().m->setAttr(Attr::MODE, StringAttr::get(session().ctx, s));
 }
 
 int64_t getFLOPs() {
-  return m->getAttrOfType<IntegerAttr>(Attr::FLOPS).getInt();
+  return session().m->getAttrOfType<IntegerAttr>(Attr::FLOPS).getInt();
 }
 
 void setFLOPs(int64_t flops) {
-  auto intType = IntegerType::get(ctx, 64);
-  m->setAttr(Attr::FLOPS, IntegerAttr::get(intType, flops));
+  auto intType = IntegerType::get(session().ctx, 64);
+  session().m->setAttr(Attr::FLOPS, IntegerAttr::get(intType, flops));
 }
 
 std::shared_ptr<std::vector<ModuleOp>> getAllModules() {
   auto modules = std::make_shared<std::vector<ModuleOp>>();
-  auto sub = m.getOps<ModuleOp>();
+  auto sub = session().m.getOps<ModuleOp>();
   if (sub.empty()) {
-    modules->push_back(m);
+    modules->push_back(session().m);
   } else {
     modules->assign(sub.begin(), sub.end());
   }
@@ -1072,7 +1103,7 @@ std::shared_ptr<std::vector<ModuleOp>> getAllModules() {
 }
 
 int getNumSubModule() {
-  auto sub = m.getOps<ModuleOp>();
+  auto sub = session().m.getOps<ModuleOp>();
   return std::distance(sub.begin(), sub.end());
 }
 
@@ -1088,19 +1119,20 @@ void getSubModuleId(ModuleOp sub, int64_t &device_id, int64_t &step) {
 }
 
 bool isAsymmetric() {
-  if (m->hasAttrOfType<BoolAttr>(Attr::ASYMMETRIC)) {
-    return m->getAttrOfType<BoolAttr>(Attr::ASYMMETRIC).getValue();
+  if (session().m->hasAttrOfType<BoolAttr>(Attr::ASYMMETRIC)) {
+    return session().m->getAttrOfType<BoolAttr>(Attr::ASYMMETRIC).getValue();
   }
   return false;
 }
 
 void setAsymmetric(bool is_asymmetric) {
-  m->setAttr(Attr::ASYMMETRIC, BoolAttr::get(ctx, is_asymmetric));
+  session().m->setAttr(Attr::ASYMMETRIC,
+                       BoolAttr::get(session().ctx, is_asymmetric));
 }
 
 int getQuantGroupSize() {
-  if (m->hasAttrOfType<IntegerAttr>(Attr::QUANT_GROUP_SIZE)) {
-    return m->getAttrOfType<IntegerAttr>(Attr::QUANT_GROUP_SIZE)
+  if (session().m->hasAttrOfType<IntegerAttr>(Attr::QUANT_GROUP_SIZE)) {
+    return session().m->getAttrOfType<IntegerAttr>(Attr::QUANT_GROUP_SIZE)
         .getValue()
         .getSExtValue();
   }
@@ -1108,29 +1140,30 @@ int getQuantGroupSize() {
 }
 
 void setQuantGroupSize(int q_group_size) {
-  auto intType = IntegerType::get(ctx, 64);
-  m->setAttr(Attr::QUANT_GROUP_SIZE, IntegerAttr::get(intType, q_group_size));
+  auto intType = IntegerType::get(session().ctx, 64);
+  session().m->setAttr(Attr::QUANT_GROUP_SIZE,
+                       IntegerAttr::get(intType, q_group_size));
 }
 
 bool isTrain() {
-  if (m->hasAttrOfType<BoolAttr>(Attr::TRAIN)) {
-    return m->getAttrOfType<BoolAttr>(Attr::TRAIN).getValue();
+  if (session().m->hasAttrOfType<BoolAttr>(Attr::TRAIN)) {
+    return session().m->getAttrOfType<BoolAttr>(Attr::TRAIN).getValue();
   }
   return false;
 }
 
 void setTrain(bool is_train) {
-  m->setAttr(Attr::TRAIN, BoolAttr::get(ctx, is_train));
+  session().m->setAttr(Attr::TRAIN, BoolAttr::get(session().ctx, is_train));
 }
 
 void setAddrMode(AddrMode mode) {
   auto s = stringifyAddrMode(mode);
-  m->setAttr(Attr::ADDR_MODE, StringAttr::get(ctx, s));
+  session().m->setAttr(Attr::ADDR_MODE, StringAttr::get(session().ctx, s));
 }
 
 AddrMode getAddrMode() {
-  if (m->hasAttrOfType<StringAttr>(Attr::ADDR_MODE)) {
-    auto s = m->getAttrOfType<StringAttr>(Attr::ADDR_MODE);
+  if (session().m->hasAttrOfType<StringAttr>(Attr::ADDR_MODE)) {
+    auto s = session().m->getAttrOfType<StringAttr>(Attr::ADDR_MODE);
     return symbolizeAddrMode(s).value_or(AddrMode::BASIC);
   }
   return AddrMode::BASIC;
@@ -1140,12 +1173,12 @@ bool isAddrMode(AddrMode mode) { return mode == getAddrMode(); }
 
 void setTopRunMode(TopRunMode mode) {
   auto s = stringifyTopRunMode(mode);
-  m->setAttr(Attr::TOP_RUN_MODE, StringAttr::get(ctx, s));
+  session().m->setAttr(Attr::TOP_RUN_MODE, StringAttr::get(session().ctx, s));
 }
 
 TopRunMode getTopRunMode() {
-  if (m->hasAttrOfType<StringAttr>(Attr::TOP_RUN_MODE)) {
-    auto s = m->getAttrOfType<StringAttr>(Attr::TOP_RUN_MODE);
+  if (session().m->hasAttrOfType<StringAttr>(Attr::TOP_RUN_MODE)) {
+    auto s = session().m->getAttrOfType<StringAttr>(Attr::TOP_RUN_MODE);
     return symbolizeTopRunMode(s).value_or(TopRunMode::STATIC);
   }
   return TopRunMode::STATIC;
@@ -1154,32 +1187,33 @@ TopRunMode getTopRunMode() {
 bool isDynamic() { return getTopRunMode() == TopRunMode::DYNAMIC; }
 
 bool isDebugCmdEnable(std::string cmd_str) {
-  if (debug_cmd.find(cmd_str) != std::string::npos) {
+  if (session().debug_cmd.find(cmd_str) != std::string::npos) {
     return true;
   }
   return false;
 }
 
 State getState() {
-  auto s = m->getAttrOfType<StringAttr>(Attr::STATE);
+  auto s = session().m->getAttrOfType<StringAttr>(Attr::STATE);
   return symbolizeState(s).value_or(State::TOP_F32);
 }
 
 void setState(State state) {
   auto s = stringifyState(state);
-  m->setAttr(Attr::STATE, StringAttr::get(ctx, s));
+  session().m->setAttr(Attr::STATE, StringAttr::get(session().ctx, s));
 }
 
-Platform getPlatform() { return platform; }
+Platform getPlatform() { return session().platform; }
 
-bool isPlatform(Platform plt) { return platform == plt; }
+bool isPlatform(Platform plt) { return session().platform == plt; }
 
 void setInputs(ArrayRef<StringRef> inputs) {
-  m->setAttr(Attr::INPUTS, Builder(ctx).getStrArrayAttr(inputs));
+  session().m->setAttr(Attr::INPUTS,
+                       Builder(session().ctx).getStrArrayAttr(inputs));
 }
 
 std::shared_ptr<std::vector<StringRef>> getInputs() {
-  auto inputs = m->getAttrOfType<ArrayAttr>(Attr::INPUTS);
+  auto inputs = session().m->getAttrOfType<ArrayAttr>(Attr::INPUTS);
   auto data = std::make_shared<std::vector<StringRef>>();
   for (auto en : llvm::enumerate(inputs)) {
     auto attr = en.value().dyn_cast<StringAttr>();
@@ -1189,11 +1223,12 @@ std::shared_ptr<std::vector<StringRef>> getInputs() {
 }
 
 void setOutputs(ArrayRef<StringRef> outputs) {
-  m->setAttr(Attr::OUTPUTS, Builder(ctx).getStrArrayAttr(outputs));
+  session().m->setAttr(Attr::OUTPUTS,
+                       Builder(session().ctx).getStrArrayAttr(outputs));
 }
 
 std::shared_ptr<std::vector<StringRef>> getOutputs() {
-  auto outputs = m->getAttrOfType<ArrayAttr>(Attr::OUTPUTS);
+  auto outputs = session().m->getAttrOfType<ArrayAttr>(Attr::OUTPUTS);
   auto data = std::make_shared<std::vector<StringRef>>();
   for (auto en : llvm::enumerate(outputs)) {
     auto attr = en.value().dyn_cast<StringAttr>();
@@ -1236,26 +1271,29 @@ bool isInt4Op(Operation *op) {
 }
 
 bool isCV18xx() {
+  auto chip = session().chip;
   return (chip == Chip::CV183x || chip == Chip::CV182x ||
           chip == Chip::CV181x || chip == Chip::CV180x);
 }
-bool isBM1684Family() { return (chip == Chip::BM1684); }
+bool isBM1684Family() { return (session().chip == Chip::BM1684); }
 bool isBM1684XFamily() {
+  auto chip = session().chip;
   return (chip == Chip::BM1684X || chip == Chip::BM1688 ||
           chip == Chip::CV186X || chip == Chip::MARS3 || chip == Chip::SG2380);
 }
-bool isBM1690Family() { return (chip == Chip::BM1690); }
-bool isSG2380() { return (chip == Chip::SG2380); }
+bool isBM1690Family() { return (session().chip == Chip::BM1690); }
+bool isSG2380() { return (session().chip == Chip::SG2380); }
 bool isBM1688() {
+  auto chip = session().chip;
   return (chip == Chip::BM1688 || chip == Chip::CV186X || chip == Chip::MARS3);
 }
-bool isBM1684X() { return (chip == Chip::BM1684X); }
+bool isBM1684X() { return (session().chip == Chip::BM1684X); }
 
-ModuleOp getModuleOp() { return m; }
+ModuleOp getModuleOp() { return session().m; }
 
-Location getLoc() { return m.getLoc(); }
+Location getLoc() { return session().m.getLoc(); }
 
-MLIRContext *getCtx() { return ctx; }
+MLIRContext *getCtx() { return session().ctx; }
 
 double getThreshold(Value v) {
   auto type = getCalibratedType(v);
@@ -1710,11 +1748,12 @@ mlir::Value opSliceAxis(PatternRewriter &rewriter, mlir::Value v, int64_t axis,
 // Helper Functions for weight
 //-----------------------------------------------------------------
 static std::string genWeightFileName(bool &same_name) {
-  auto name = getName(m);
+  auto name = getName(session().m);
   auto state = getState();
   auto chip_ = getChip();
   auto chip = stringifyChip(chip_);
-  auto old_name = m->getAttrOfType<StringAttr>(Attr::WEIGHT_FILE).getValue();
+  auto old_name =
+      session().m->getAttrOfType<StringAttr>(Attr::WEIGHT_FILE).getValue();
   std::string file_name = name.lower() + std::string("_") +
                           stringifyState(state).lower() + std::string("_") +
                           chip.lower();
@@ -1727,10 +1766,15 @@ static std::string genWeightFileName(bool &same_name) {
     auto mode_ = stringifyMode(mode);
     file_name += std::string("_") + mode_.lower() + sym;
   }
-  auto new_name = file_name + "_weight.npz";
+  // stay in the format of the input weights
+  std::string ext = ".npz";
+  if (old_name.endswith(mlir::TensorFile::packExtension)) {
+    ext = mlir::TensorFile::packExtension.str();
+  }
+  auto new_name = file_name + "_weight" + ext;
   same_name = (old_name == new_name);
   if (same_name) {
-    new_name = file_name + "_weight_fix.npz";
+    new_name = file_name + "_weight_fix" + ext;
   }
   return new_name;
 }
@@ -1753,23 +1797,24 @@ void saveWeight() {
       });
     }
   }
+  auto &ss = session();
   bool same_name = true;
   std::string filename_;
-  if (weightFileName == "") {
+  if (ss.weightFileName == "") {
     filename_ = module::genWeightFileName(same_name);
   } else {
     same_name = false;
-    filename_ = weightFileName;
+    filename_ = ss.weightFileName;
   }
   // weight remove unused in npz
-  if (wFile == nullptr) {
+  if (ss.wFile == nullptr) {
     if (!same_name) {
       weightFile().save(filename_);
-      m->setAttr(Attr::WEIGHT_FILE, StringAttr::get(ctx, filename_));
+      ss.m->setAttr(Attr::WEIGHT_FILE, StringAttr::get(ss.ctx, filename_));
     }
     return;
   }
-  if (wFile->changed() == false && same_name) {
+  if (ss.wFile->changed() == false && same_name) {
     return;
   }
   std::set<StringRef> weight_names;
@@ -1781,7 +1826,7 @@ void saveWeight() {
     }
   }
   std::set<StringRef> npz_names;
-  wFile->getAllNames(npz_names);
+  ss.wFile->getAllNames(npz_names);
   std::set<StringRef> dif_names;
   for (auto name : npz_names) {
     if (weight_names.find(name) == weight_names.end()) {
@@ -1789,24 +1834,112 @@ void saveWeight() {
     }
   }
   for (auto &name : dif_names) {
-    wFile->deleteTensor(name);
+    ss.wFile->deleteTensor(name);
   }
-  if (wFile->changed() == false && same_name) {
+  if (ss.wFile->changed() == false && same_name) {
     return;
   }
-  wFile->save(filename_);
-  m->setAttr(Attr::WEIGHT_FILE, StringAttr::get(ctx, filename_));
+  ss.wFile->save(filename_);
+  ss.m->setAttr(Attr::WEIGHT_FILE, StringAttr::get(ss.ctx, filename_));
+}
+
+void setWeightFileName(const std::string &name) {
+  session().weightFileName = name;
+}
+void detachWeightFile() { session().wFile = nullptr; }
+
+std::string getWeightFileId() {
+  auto name =
+      session().m->getAttrOfType<StringAttr>(Attr::WEIGHT_FILE).getValue();
+  llvm::SmallString<256> path;
+  if (llvm::sys::fs::real_path(name, path)) {
+    path = name;
+  }
+  std::string id = path.str().str();
+  llvm::sys::fs::file_status status;
+  if (!llvm::sys::fs::status(path, status)) {
+    id += "@" + std::to_string(status.getLastModificationTime()
+                                   .time_since_epoch()
+                                   .count());
+  }
+  return id;
 }
 
-void setWeightFileName(const std::string &name) { weightFileName = name; }
-void detachWeightFile() { wFile = nullptr; }
+// read only weight files of the sessions, by id and lazy mode
+static std::mutex shared_files_mutex;
+static std::map<std::pair<std::string, bool>, std::weak_ptr<mlir::TensorFile>>
+    shared_files;
 
 mlir::TensorFile &weightFile() {
-  if (wFile == nullptr) {
-    auto name = m->getAttrOfType<StringAttr>(Attr::WEIGHT_FILE).getValue();
-    wFile = std::make_unique<mlir::TensorFile>(name, false);
+  auto &ss = session();
+  if (ss.wFile != nullptr) {
+    return *ss.wFile;
+  }
+  auto name = ss.m->getAttrOfType<StringAttr>(Attr::WEIGHT_FILE).getValue();
+  if (!ss.sharedWeightFile) {
+    ss.wFile = std::make_shared<mlir::TensorFile>(name, false, false,
+                                                  ss.weightFileLazy);
+    return *ss.wFile;
+  }
+  std::lock_guard<std::mutex> lock(shared_files_mutex);
+  auto &file = shared_files[{getWeightFileId(), ss.weightFileLazy}];
+  ss.wFile = file.lock();
+  if (ss.wFile == nullptr) {
+    ss.wFile = std::make_shared<mlir::TensorFile>(name, true, false,
+                                                  ss.weightFileLazy);
+    file = ss.wFile;
+  }
+  return *ss.wFile;
+}
+
+void setWeightFileLazy(Session *session, bool lazy) {
+  session->weightFileLazy = lazy;
+  // reopened in the new mode on next use
+  session->wFile = nullptr;
+}
+
+std::shared_ptr<Session> createSession(ModuleOp module,
+                                       bool share_weight_file) {
+  num_sessions++;
+  auto ss = std::shared_ptr<Session>(new Session(), [](Session *s) {
+    delete s;
+    num_sessions--;
+  });
+  {
+    SessionGuard guard(ss.get());
+    init(module);
+  }
+  ss->sharedWeightFile = share_weight_file;
+  return ss;
+}
+
+// bind s to this thread and to the openmp workers it runs its parallel
+// regions on: ops query the chip from inside them. It relies on the runtime
+// keeping the same workers for a thread, as libgomp and libomp do. The team
+// is as large as any the thread may start later: the current thread limit
+// can be lowered by a ThreadBudget and raised up to get_num_threads() by the
+// next one
+static void bind_session(Session *s) {
+  bound_session = s;
+  if (omp_in_parallel()) {
+    return;
+  }
+  int num_threads = std::max({omp_get_max_threads(), omp_get_num_procs(),
+                               get_num_threads()});
+#pragma omp parallel num_threads(num_threads)
+  bound_session = s;
+}
+
+SessionGuard::SessionGuard(Session *session) : prev(bound_session) {
+  if (session != prev) {
+    bind_session(session);
+  }
+}
+
+SessionGuard::~SessionGuard() {
+  if (bound_session != prev) {
+    bind_session(prev);
   }
-  return *wFile;
 }
 
 //-----------------------------------------------------------------
@@ -8,9 +8,32 @@
 //===----------------------------------------------------------------------===//
 
 #include "tpu_mlir/Support/TensorFile.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/xxhash.h"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 namespace mlir {
 
+static const char pack_magic[8] = {'T', 'P', 'U', 'M', 'L', 'I', 'R', 'W'};
+static const uint32_t pack_version = 2;
+// version 1 has no hash in the index
+static const uint32_t pack_version_nohash = 1;
+// magic, version, number of tensors, index offset
+static const size_t pack_header_size = 8 + 4 + 4 + 8;
+
+static bool is_pack(const std::string &filename) {
+  std::ifstream f(filename, std::ios::binary);
+  char magic[sizeof(pack_magic)];
+  return f.read(magic, sizeof(magic)) &&
+         memcmp(magic, pack_magic, sizeof(magic)) == 0;
+}
+
 template <typename T> static std::string int_to_hex(T i) {
   std::stringstream stream;
   stream << std::setfill('0') << std::setw(sizeof(T) * 2) << std::hex << i;
@@ -58,7 +81,8 @@ template <typename T> static bool check_type(Type eltType) {
   return same;
 }
 
-TensorFile::TensorFile(llvm::StringRef filename, bool readOnly, bool newCreate)
+TensorFile::TensorFile(llvm::StringRef filename, bool readOnly, bool newCreate,
+                       bool lazy)
     : filename(filename), readOnly(readOnly) {
   if (!newCreate) {
     std::ifstream f(filename.str());
@@ -66,7 +90,7 @@ TensorFile::TensorFile(llvm::StringRef filename, bool readOnly, bool newCreate)
       llvm::errs() << "WARNING, " << filename
                    << " doesn't exist, please check\n";
     }
-    auto ret = load();
+    auto ret = lazy ? load_lazy() : load();
     if (!succeeded(ret)) {
       if (readOnly) {
         llvm::errs() << filename << " not exist, failed to read for read\n";
@@ -81,12 +105,24 @@ TensorFile::TensorFile(llvm::StringRef filename, bool readOnly, bool newCreate)
 
 TensorFile::~TensorFile() {}
 
+LogicalResult TensorFile::convert(llvm::StringRef src, llvm::StringRef dst) {
+  if (!llvm::sys::fs::exists(src)) {
+    llvm::errs() << "failed to convert " << src << ", not exist\n";
+    return failure();
+  }
+  // mapped, tensors are copied straight from src to dst
+  TensorFile file(src, false, false, true);
+  file.save(dst.str());
+  return success();
+}
+
 /// update a tensor for weight compress
 /// if the name is not found, return failure()
 template <typename T>
 LogicalResult TensorFile::updateTensorData(llvm::StringRef name, const T *data,
                                            size_t count) {
   assert(!readOnly);
+  materialize(name);
   auto it = map.find(name.str());
   if (it == map.end()) {
     llvm::errs() << "failed to add tensor " << name.str()
@@ -101,8 +137,11 @@ LogicalResult TensorFile::updateTensorData(llvm::StringRef name, const T *data,
     llvm_unreachable("readTensor failed");
     return failure();
   }
+  // the old data may be shared with other tensors
   arr.fortran_order = false;
-  memcpy(arr.data_holder->data(), data, arr.num_bytes());
+  arr.data_holder = std::make_shared<std::vector<char>>(
+      (const char *)data, (const char *)data + arr.num_bytes());
+  share_blob(name.str());
   cnt_update++;
   return success();
 }
@@ -110,20 +149,24 @@ LogicalResult TensorFile::updateTensorData(llvm::StringRef name, const T *data,
 LogicalResult TensorFile::cloneTensor(llvm::StringRef name,
                                       llvm::StringRef suffix) {
   assert(!readOnly);
-  auto it = map.find(name.str());
-  if (it == map.end()) {
-    llvm::errs() << "failed to clone tensor " << name.str() << ", not exist\n";
+  auto new_name = name.str() + "_" + suffix.str();
+  if (map.count(new_name) || lazy_map.count(new_name)) {
+    llvm::errs() << "failed to clone tensor " << new_name << ", exist\n";
     llvm_unreachable("cloneTensor error!");
     return failure();
   }
-  auto new_name = name.str() + "_" + suffix.str();
-  auto new_it = map.find(new_name);
-  if (new_it != map.end()) {
-    llvm::errs() << "failed to clone tensor " << new_name << ", exist\n";
+  // the clone shares the data, in the mapping or in memory
+  auto lazy_it = lazy_map.find(name.str());
+  if (lazy_it != lazy_map.end()) {
+    lazy_map[new_name] = lazy_it->second;
+  } else if (map.count(name.str())) {
+    cnpy::npz_clone_array(map, name.str(), new_name);
+  } else {
+    llvm::errs() << "failed to clone tensor " << name.str() << ", not exist\n";
     llvm_unreachable("cloneTensor error!");
     return failure();
   }
-  cnpy::npz_clone_array(map, name.str(), new_name);
+  cnt_add++;
   return success();
 }
 
@@ -134,6 +177,7 @@ LogicalResult TensorFile::addTensor(llvm::StringRef name, const T *data,
                                     RankedTensorType &type, int64_t length) {
   assert(!readOnly);
   assert(check_type<T>(type.getElementType()) == true);
+  materialize(name);
   auto it = map.find(name.str());
   if (it != map.end()) {
     llvm::errs() << "failed to add tensor " << name.str()
@@ -151,6 +195,7 @@ LogicalResult TensorFile::addTensor(llvm::StringRef name, const T *data,
     }
   }
   cnpy::npz_add_array(map, name.str(), &data[0], shape_npz);
+  share_blob(name.str());
   cnt_add++;
   return success();
 }
@@ -170,6 +215,7 @@ template <typename T>
 LogicalResult TensorFile::addTensor(llvm::StringRef name, const T *data,
                                     std::vector<int64_t> &shape) {
   assert(!readOnly);
+  materialize(name);
   auto it = map.find(name.str());
   if (it != map.end()) {
     llvm::errs() << "failed to add tensor " << name.str()
@@ -182,6 +228,7 @@ LogicalResult TensorFile::addTensor(llvm::StringRef name, const T *data,
     shape_npz.push_back((size_t)*it);
   }
   cnpy::npz_add_array(map, name.str(), &data[0], shape_npz);
+  share_blob(name.str());
   cnt_add++;
   return success();
 }
@@ -242,6 +289,14 @@ template LogicalResult TensorFile::updateTensorData(llvm::StringRef name,
                                                     const unsigned short *data,
                                                     size_t count);
 
+template LogicalResult
+TensorFile::addTensor<float>(llvm::StringRef name, const float *data,
+                             std::vector<int64_t> &shape);
+template LogicalResult TensorFile::readTensor<float>(llvm::StringRef name,
+                                                     float *data, size_t count,
+                                                     bool isINT4,
+                                                     bool do_compress);
+
 template LogicalResult
 TensorFile::readAllTensors(std::vector<std::string> &names,
                            std::vector<std::vector<int> *> &tensors,
@@ -278,13 +333,31 @@ TensorFile::readTensor<unsigned short>(llvm::StringRef name,
 template <typename T>
 LogicalResult TensorFile::readTensor(llvm::StringRef name, T *data,
                                      size_t count, bool isINT4, bool do_compress) {
-  auto it = map.find(name.str());
-  if (it == map.end()) {
-    llvm::errs() << "failed to find tensor " << name.str() << " to read\n";
-    llvm_unreachable("readTensor failed");
-    return failure();
+  auto lazy_it = lazy_map.find(name.str());
+  if (lazy_it != lazy_map.end() && !lazy_it->second.fortran_order) {
+    // copy straight out of the mapping, nothing stays resident here
+    auto &arr = lazy_it->second;
+    if (arr.num_bytes != count * sizeof(T) && !isINT4 && !do_compress) {
+      llvm::errs() << "size does not match for tensor " << name.str() << "\n";
+      llvm_unreachable("readTensor failed");
+      return failure();
+    }
+    memcpy(data, view(name).data(), isINT4 ? count : arr.num_bytes);
+    return success();
+  }
+  // reads leave the file as it is, so that threads can share it
+  cnpy::NpyArray arr;
+  if (lazy_it != lazy_map.end()) {
+    arr = lazy_array(lazy_it->second);
+  } else {
+    auto it = map.find(name.str());
+    if (it == map.end()) {
+      llvm::errs() << "failed to find tensor " << name.str() << " to read\n";
+      llvm_unreachable("readTensor failed");
+      return failure();
+    }
+    arr = it->second;
   }
-  auto arr = it->second;
   if (arr.num_bytes() != count * sizeof(T) && !isINT4 && !do_compress) {
     llvm::errs() << "size does not match for tensor " << name.str() << "\n";
     llvm_unreachable("readTensor failed");
@@ -350,6 +423,7 @@ LogicalResult TensorFile::deleteTensor(const llvm::StringRef name) {
   assert(!readOnly);
   if (readOnly)
     return failure();
+  materialize(name);
   auto it = map.find(name.str());
   if (it == map.end()) {
     llvm::errs() << "failed to find tensor " << name.str() << " to delete\n";
@@ -360,10 +434,75 @@ LogicalResult TensorFile::deleteTensor(const llvm::StringRef name) {
   return success();
 }
 
+uint64_t TensorFile::blob_hash(LazyArray &arr) {
+  if (!arr.hashed) {
+    arr.hash = llvm::xxHash64(
+        StringRef(buffer->getBufferStart() + arr.offset, arr.num_bytes));
+    arr.hashed = true;
+  }
+  return arr.hash;
+}
+
+void TensorFile::share_blob(const std::string &name) {
+  if (blobs_pending) {
+    // hashed on the first add, reads never pay for it
+    for (auto &it : lazy_map) {
+      if (!it.second.fortran_order && !it.second.hashed) {
+        blobs.emplace(blob_hash(it.second), it.first);
+      }
+    }
+    blobs_pending = false;
+  }
+  auto &arr = map.at(name);
+  StringRef data(arr.data_holder->data(), arr.num_bytes());
+  uint64_t hash = llvm::xxHash64(data);
+  auto range = blobs.equal_range(hash);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second == name) {
+      continue;
+    }
+    // names are checked when found, they may be gone or changed since
+    auto lazy_it = lazy_map.find(it->second);
+    if (lazy_it != lazy_map.end()) {
+      auto &lazy = lazy_it->second;
+      if (!lazy.fortran_order && lazy.hashed && lazy.hash == hash &&
+          lazy.num_bytes == data.size() &&
+          memcmp(buffer->getBufferStart() + lazy.offset, data.data(),
+                 data.size()) == 0) {
+        LazyArray same = lazy;
+        same.shape = arr.shape;
+        same.word_size = arr.word_size;
+        same.type = arr.type;
+        map.erase(name);
+        lazy_map[name] = std::move(same);
+        return;
+      }
+      continue;
+    }
+    auto map_it = map.find(it->second);
+    if (map_it != map.end()) {
+      auto &holder = map_it->second.data_holder;
+      if (holder->size() == data.size() &&
+          memcmp(holder->data(), data.data(), data.size()) == 0) {
+        arr.data_holder = holder;
+        return;
+      }
+    }
+  }
+  blobs.emplace(hash, name);
+}
+
 void TensorFile::getAllNames(std::set<StringRef> &names) {
   for (auto &name : map) {
     names.insert(name.first);
   }
+  for (auto &name : lazy_map) {
+    names.insert(name.first);
+  }
+}
+
+bool TensorFile::hasTensor(llvm::StringRef name) const {
+  return map.count(name.str()) || lazy_map.count(name.str());
 }
 
 /// read all tensor from file
@@ -372,6 +511,7 @@ LogicalResult
 TensorFile::readAllTensors(std::vector<std::string> &names,
                            std::vector<std::vector<T> *> &tensors,
                            std::vector<std::vector<int64_t>> &shapes) {
+  materialize();
   for (auto it = map.begin(); it != map.end(); it++) {
     auto arr = it->second;
     assert(arr.type == 'f'); // support float only for now
@@ -422,6 +562,27 @@ void TensorFile::save(const std::string &file) {
   if (cnt_add + cnt_del + cnt_update == 0 && same_name) {
     return;
   }
+  if (llvm::StringRef(filename).endswith(packExtension)) {
+    if (!append_pack()) {
+      save_pack();
+    }
+    cnt_add = 0;
+    cnt_del = 0;
+    cnt_update = 0;
+    // everything is in the file now, map it again
+    map.clear();
+    lazy_map.clear();
+    blobs.clear();
+    blobs_pending = false;
+    buffer.reset();
+    pack_file.clear();
+    if (failed(load_pack())) {
+      llvm_unreachable("TensorFile save failed");
+    }
+    return;
+  }
+  // the target may be the mapped file itself
+  materialize();
   for (auto &it : map) {
     cnpy::NpyArray &array = it.second;
     if (array.fortran_order == true) {
@@ -440,7 +601,328 @@ void TensorFile::save(const std::string &file) {
   return;
 }
 
+void TensorFile::write_pack_tensor(std::ostream &out, uint64_t &pos,
+                                   llvm::StringRef name, std::string &index,
+                                   PackBlobs &written) {
+  cnpy::NpyArray copy;
+  const cnpy::NpyArray *arr = nullptr;
+  const char *data = nullptr;
+  std::vector<size_t> shape;
+  size_t word_size = 0, num_bytes = 0;
+  uint64_t hash = 0;
+  char type = 0;
+  auto it = map.find(name.str());
+  if (it != map.end()) {
+    arr = &it->second;
+  } else {
+    auto &lazy = lazy_map.at(name.str());
+    if (lazy.fortran_order) {
+      copy = lazy_array(lazy);
+      arr = &copy;
+    } else {
+      data = buffer->getBufferStart() + lazy.offset;
+      shape = lazy.shape;
+      word_size = lazy.word_size;
+      num_bytes = lazy.num_bytes;
+      type = lazy.type;
+      hash = blob_hash(lazy);
+    }
+  }
+  std::shared_ptr<std::vector<char>> row_major;
+  if (arr != nullptr) {
+    row_major = arr->data_holder;
+    if (arr->fortran_order) {
+      row_major = std::make_shared<std::vector<char>>(arr->num_bytes());
+      colMajorToRowMajor(*row_major, *arr);
+    }
+    data = row_major->data();
+    shape = arr->shape;
+    word_size = arr->word_size;
+    num_bytes = arr->num_bytes();
+    type = arr->type;
+    hash = llvm::xxHash64(StringRef(data, num_bytes));
+  }
+  // equal data is written once, by every name pointing to it
+  auto range = written.equal_range(hash);
+  for (auto w = range.first; w != range.second; ++w) {
+    if (w->second.num_bytes == num_bytes &&
+        memcmp(w->second.data, data, num_bytes) == 0) {
+      add_pack_entry(index, name, type, word_size, shape, w->second.offset,
+                     num_bytes, hash);
+      return;
+    }
+  }
+  uint64_t offset = llvm::alignTo(pos, packAlignment);
+  std::string pad(offset - pos, '\0');
+  out.write(pad.data(), pad.size());
+  out.write(data, num_bytes);
+  pos = offset + num_bytes;
+  add_pack_entry(index, name, type, word_size, shape, offset, num_bytes, hash);
+  if (row_major == nullptr || row_major == arr->data_holder) {
+    // data lives until the save is done
+    written.emplace(hash, PackBlob{offset, data, num_bytes});
+  }
+}
+
+void TensorFile::add_pack_entry(std::string &index, llvm::StringRef name,
+                                char type, size_t word_size,
+                                const std::vector<size_t> &shape,
+                                uint64_t offset, uint64_t num_bytes,
+                                uint64_t hash) {
+  auto put = [&](const void *data, size_t size) {
+    index.append((const char *)data, size);
+  };
+  uint32_t name_size = name.size();
+  uint8_t type_u8 = type, word_size_u8 = word_size;
+  uint16_t num_dims = shape.size();
+  put(&name_size, sizeof(name_size));
+  put(name.data(), name.size());
+  put(&type_u8, sizeof(type_u8));
+  put(&word_size_u8, sizeof(word_size_u8));
+  put(&num_dims, sizeof(num_dims));
+  for (auto dim : shape) {
+    uint64_t dim_u64 = dim;
+    put(&dim_u64, sizeof(dim_u64));
+  }
+  put(&offset, sizeof(offset));
+  put(&num_bytes, sizeof(num_bytes));
+  put(&hash, sizeof(hash));
+}
+
+static void write_pack_header(std::ostream &out, uint32_t num_tensors,
+                              uint64_t index_offset) {
+  std::string header(pack_header_size, '\0');
+  memcpy(&header[0], pack_magic, sizeof(pack_magic));
+  memcpy(&header[8], &pack_version, sizeof(pack_version));
+  memcpy(&header[12], &num_tensors, sizeof(num_tensors));
+  memcpy(&header[16], &index_offset, sizeof(index_offset));
+  out.seekp(0);
+  out.write(header.data(), header.size());
+}
+
+// copy done by the kernel where it can, shared extents on reflink file
+// systems
+static bool clone_file(const std::string &src, const std::string &dst) {
+#ifdef __linux__
+  int in = open(src.c_str(), O_RDONLY);
+  int out = open(dst.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  bool done = false;
+  struct stat st;
+  if (in >= 0 && out >= 0 && fstat(in, &st) == 0) {
+    off_t left = st.st_size;
+    ssize_t n = 1;
+    while (left > 0 && n > 0) {
+      n = copy_file_range(in, nullptr, out, nullptr, left, 0);
+      left -= n > 0 ? n : 0;
+    }
+    done = left == 0;
+  }
+  if (in >= 0) {
+    close(in);
+  }
+  if (out >= 0) {
+    close(out);
+  }
+  if (done) {
+    return true;
+  }
+#endif
+  return !llvm::sys::fs::copy_file(src, dst);
+}
+
+void TensorFile::save_pack(void) {
+  // the target may be the mapped file itself: written aside then renamed,
+  // the mapping keeps the old file
+  auto tmp = filename + ".tmp";
+  std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+  if (!out) {
+    llvm::errs() << "failed to open " << tmp << " to write\n";
+    llvm_unreachable("TensorFile save failed");
+  }
+  std::set<StringRef> names;
+  getAllNames(names);
+  std::string header(pack_header_size, '\0');
+  out.write(header.data(), header.size());
+  uint64_t pos = pack_header_size;
+  std::string index;
+  PackBlobs written;
+  for (auto name : names) {
+    write_pack_tensor(out, pos, name, index, written);
+  }
+  out.write(index.data(), index.size());
+  write_pack_header(out, names.size(), pos);
+  out.close();
+  if (!out || llvm::sys::fs::rename(tmp, filename)) {
+    llvm::errs() << "failed to write " << filename << "\n";
+    llvm_unreachable("TensorFile save failed");
+  }
+}
+
+bool TensorFile::append_pack(void) {
+  // tensors of lazy_map are in pack_file as they are, those of map are new
+  // or updated, and deleted ones are in neither
+  if (pack_file.empty() || buffer == nullptr) {
+    return false;
+  }
+  llvm::sys::fs::file_status status;
+  if (llvm::sys::fs::status(pack_file, status) ||
+      status.getSize() != pack_size || status.getUniqueID() != pack_id ||
+      status.getLastModificationTime() != pack_mtime) {
+    // replaced or changed by someone else since mapped
+    return false;
+  }
+  std::set<StringRef> names;
+  getAllNames(names);
+  uint64_t live = 0, end = pack_size;
+  std::set<std::pair<uint64_t, uint64_t>> blobs_kept;
+  for (auto &it : lazy_map) {
+    if (blobs_kept.emplace(it.second.offset, it.second.num_bytes).second) {
+      live += it.second.num_bytes;
+    }
+  }
+  for (auto &it : map) {
+    live += it.second.num_bytes();
+    end = llvm::alignTo(end, packAlignment) + it.second.num_bytes();
+  }
+  // the index is rewritten, as garbage are the old ones and what was
+  // replaced or deleted
+  uint64_t garbage = end - pack_header_size - live;
+  if (garbage > (end - pack_header_size) * packGarbageRatio) {
+    return false;
+  }
+  if (filename != pack_file && !clone_file(pack_file, filename)) {
+    return false;
+  }
+  std::fstream out(filename, std::ios::binary | std::ios::in | std::ios::out);
+  if (!out) {
+    llvm::errs() << "failed to open " << filename << " to write\n";
+    llvm_unreachable("TensorFile save failed");
+  }
+  out.seekp(pack_size);
+  uint64_t pos = pack_size;
+  std::string index;
+  // new tensors equal to what the pack has only get an index entry
+  PackBlobs written;
+  for (auto &it : lazy_map) {
+    auto &arr = it.second;
+    written.emplace(blob_hash(arr),
+                    PackBlob{arr.offset, buffer->getBufferStart() + arr.offset,
+                             arr.num_bytes});
+  }
+  for (auto name : names) {
+    auto it = lazy_map.find(name.str());
+    if (it == lazy_map.end()) {
+      write_pack_tensor(out, pos, name, index, written);
+    } else {
+      auto &arr = it->second;
+      add_pack_entry(index, name, arr.type, arr.word_size, arr.shape,
+                     arr.offset, arr.num_bytes, blob_hash(arr));
+    }
+  }
+  out.write(index.data(), index.size());
+  // readers see the new index once all is written
+  out.flush();
+  write_pack_header(out, names.size(), pos);
+  out.close();
+  if (!out) {
+    llvm::errs() << "failed to write " << filename << "\n";
+    llvm_unreachable("TensorFile save failed");
+  }
+  return true;
+}
+
+LogicalResult TensorFile::load_pack(void) {
+  // taken before mapping, a change in between only costs a rewrite
+  llvm::sys::fs::file_status status;
+  if (llvm::sys::fs::status(filename, status)) {
+    return failure();
+  }
+  auto file = llvm::MemoryBuffer::getFile(filename, /*IsText=*/false,
+                                          /*RequiresNullTerminator=*/false);
+  if (!file) {
+    return failure();
+  }
+  auto start = (*file)->getBufferStart();
+  size_t size = (*file)->getBufferSize();
+  uint32_t version, num_tensors;
+  uint64_t pos;
+  if (size < pack_header_size) {
+    return failure();
+  }
+  memcpy(&version, start + 8, sizeof(version));
+  memcpy(&num_tensors, start + 12, sizeof(num_tensors));
+  memcpy(&pos, start + 16, sizeof(pos));
+  if (version != pack_version && version != pack_version_nohash) {
+    llvm::errs() << filename << ": weight pack version " << version
+                 << " not supported\n";
+    return failure();
+  }
+  bool valid = pos <= size;
+  auto get = [&](void *data, size_t n) {
+    valid = valid && pos + n <= size;
+    if (valid) {
+      memcpy(data, start + pos, n);
+      pos += n;
+    }
+  };
+  for (uint32_t i = 0; i < num_tensors && valid; i++) {
+    uint32_t name_size = 0;
+    get(&name_size, sizeof(name_size));
+    valid = valid && pos + name_size <= size;
+    if (!valid) {
+      break;
+    }
+    std::string name(start + pos, name_size);
+    pos += name_size;
+    uint8_t type = 0, word_size = 0;
+    uint16_t num_dims = 0;
+    get(&type, sizeof(type));
+    get(&word_size, sizeof(word_size));
+    get(&num_dims, sizeof(num_dims));
+    LazyArray arr;
+    arr.type = type;
+    arr.word_size = word_size;
+    arr.fortran_order = false;
+    for (uint16_t d = 0; d < num_dims; d++) {
+      uint64_t dim = 0;
+      get(&dim, sizeof(dim));
+      arr.shape.push_back(dim);
+    }
+    uint64_t offset = 0, num_bytes = 0, hash = 0;
+    get(&offset, sizeof(offset));
+    get(&num_bytes, sizeof(num_bytes));
+    valid = valid && offset + num_bytes <= size;
+    arr.offset = offset;
+    arr.num_bytes = num_bytes;
+    if (version == pack_version_nohash) {
+      blobs_pending = true;
+    } else {
+      get(&hash, sizeof(hash));
+      arr.hash = hash;
+      arr.hashed = true;
+      blobs.emplace(hash, name);
+    }
+    lazy_map[name] = std::move(arr);
+  }
+  if (!valid) {
+    llvm::errs() << filename << ": broken weight pack\n";
+    lazy_map.clear();
+    blobs.clear();
+    blobs_pending = false;
+    return failure();
+  }
+  buffer = std::move(*file);
+  pack_file = filename;
+  pack_size = size;
+  pack_id = status.getUniqueID();
+  pack_mtime = status.getLastModificationTime();
+  return success();
+}
+
 LogicalResult TensorFile::load(void) {
+  if (is_pack(filename)) {
+    return load_pack();
+  }
   map = cnpy::npz_load(filename);
   if (map.size() > 0) {
     return success();
@@ -449,6 +931,136 @@ LogicalResult TensorFile::load(void) {
   }
 }
 
+// true if the extra field of a local file header holds a zip64 record
+static bool has_zip64_extra(const unsigned char *extra, size_t len) {
+  size_t pos = 0;
+  while (pos + 4 <= len) {
+    uint16_t id, data_len;
+    memcpy(&id, extra + pos, sizeof(id));
+    memcpy(&data_len, extra + pos + 2, sizeof(data_len));
+    if (id == 0x0001) {
+      return true;
+    }
+    pos += 4 + data_len;
+  }
+  return false;
+}
+
+LogicalResult TensorFile::load_lazy(void) {
+  if (is_pack(filename)) {
+    return load_pack();
+  }
+  auto file = llvm::MemoryBuffer::getFile(filename, /*IsText=*/false,
+                                          /*RequiresNullTerminator=*/false);
+  if (!file) {
+    return failure();
+  }
+  buffer = std::move(*file);
+  auto start = (const unsigned char *)buffer->getBufferStart();
+  size_t size = buffer->getBufferSize();
+  size_t pos = 0;
+  // walk the local file headers, as cnpy::npz_load does
+  while (pos + 30 <= size) {
+    auto header = start + pos;
+    if (header[0] != 'P' || header[1] != 'K' || header[2] != 0x03 ||
+        header[3] != 0x04) {
+      break;
+    }
+    uint16_t compr_method, name_len, extra_len;
+    uint32_t compr_bytes, uncompr_bytes;
+    memcpy(&compr_method, header + 8, sizeof(compr_method));
+    memcpy(&compr_bytes, header + 18, sizeof(compr_bytes));
+    memcpy(&uncompr_bytes, header + 22, sizeof(uncompr_bytes));
+    memcpy(&name_len, header + 26, sizeof(name_len));
+    memcpy(&extra_len, header + 28, sizeof(extra_len));
+    size_t data_pos = pos + 30 + name_len + extra_len;
+    if (compr_bytes == 0xFFFFFFFF || uncompr_bytes == 0xFFFFFFFF ||
+        (data_pos <= size &&
+         has_zip64_extra(header + 30 + name_len, extra_len))) {
+      // the 32-bit sizes above are placeholders, the real ones live in the
+      // zip64 extra field, which is not parsed here
+      llvm::errs() << filename << ": zip64 npz is not supported by lazy "
+                   << "loading, load it without lazy\n";
+      lazy_map.clear();
+      buffer.reset();
+      return failure();
+    }
+    if (compr_method != 0 || name_len < 4 || data_pos + compr_bytes > size) {
+      // compressed npz (e.g. numpy.savez_compressed) can't be mapped
+      lazy_map.clear();
+      buffer.reset();
+      return load();
+    }
+    // erase the lagging .npy
+    std::string name((const char *)header + 30, name_len - 4);
+    LazyArray arr;
+    cnpy::parse_npy_header((unsigned char *)start + data_pos, arr.word_size,
+                           arr.type, arr.shape, arr.fortran_order);
+    arr.num_bytes = arr.word_size;
+    for (auto dim : arr.shape) {
+      arr.num_bytes *= dim;
+    }
+    arr.offset = data_pos + uncompr_bytes - arr.num_bytes;
+    lazy_map[name] = std::move(arr);
+    pos = data_pos + compr_bytes;
+  }
+  if (lazy_map.empty()) {
+    buffer.reset();
+    return failure();
+  }
+  return success();
+}
+
+llvm::ArrayRef<char> TensorFile::view(llvm::StringRef name) const {
+  auto it = lazy_map.find(name.str());
+  if (it == lazy_map.end() || it->second.fortran_order) {
+    return {};
+  }
+  return llvm::ArrayRef<char>(buffer->getBufferStart() + it->second.offset,
+                              it->second.num_bytes);
+}
+
+cnpy::NpyArray TensorFile::lazy_array(const LazyArray &arr) const {
+  cnpy::NpyArray array(arr.shape, arr.word_size, arr.type, arr.fortran_order);
+  memcpy(array.data<char>(), buffer->getBufferStart() + arr.offset,
+         arr.num_bytes);
+  return array;
+}
+
+void TensorFile::materialize(llvm::StringRef name) {
+  if (!name.empty()) {
+    auto it = lazy_map.find(name.str());
+    if (it != lazy_map.end()) {
+      map[it->first] = lazy_array(it->second);
+      lazy_map.erase(it);
+    }
+  } else {
+    // tensors sharing data in the file share it in memory too
+    std::map<std::pair<size_t, size_t>, std::string> loaded;
+    for (auto &it : lazy_map) {
+      auto &arr = it.second;
+      auto first = loaded.emplace(std::make_pair(arr.offset, arr.num_bytes),
+                                  it.first);
+      if (first.second) {
+        map[it.first] = lazy_array(arr);
+        continue;
+      }
+      cnpy::NpyArray same;
+      same.shape = arr.shape;
+      same.word_size = arr.word_size;
+      same.type = arr.type;
+      same.fortran_order = arr.fortran_order;
+      same.num_vals = arr.num_bytes / arr.word_size;
+      same.data_holder = map[first.first->second].data_holder;
+      map[it.first] = std::move(same);
+    }
+    lazy_map.clear();
+  }
+  if (lazy_map.empty()) {
+    buffer.reset();
+  }
+}
+
 std::string filename;
 bool readOnly;
 cnpy::npz_t map;
@@ -155,6 +155,7 @@ class ONNX_IR_TESTER(object):
             "Pad1":         (self.test_Pad1,          Y, Y, Y, Y, Y),
             "PadEdge":      (self.test_PadEdge,       N, Y, Y, Y, Y),
             "PadReflect":   (self.test_PadReflect,    Y, Y, Y, Y, Y), # y = x ^ n
+            "ParallelInvoke": (self.test_ParallelInvoke, Y, Y, Y, Y, Y),
             "Pow1":         (self.test_Pow1,          Y, Y, Y, Y, Y), # y = n ^ x
             "Pow2":         (self.test_Pow2,          Y, Y, Y, N, Y),
             "PRelu":        (self.test_PRelu,         Y, Y, Y, Y, Y),
@@ -2078,6 +2079,57 @@ class ONNX_IR_TESTER(object):
         graph_def.initializer.extend([pad_val])
         self.onnx_and_test(graph_def)
 
+    def test_ParallelInvoke(self, case_name):
+        # independent branches, run concurrently with set_parallel_workers
+        in_shape = [1, 16, 32, 32]
+        weights = {
+            "filter0": [32, 16, 3, 3],
+            "filter1": [32, 16, 1, 1],
+            "filter2": [32, 16, 5, 5],
+            "weight": [32, 32],
+        }
+        graph_txt = """
+            %s (float%s input) => (float[1, 32, 32, 32] output0, float[1, 32, 32, 32] output1,
+                                   float[1, 16, 32, 32] output2, float[1, 16, 16, 16] output3)
+            <float%s filter0, float%s filter1, float%s filter2, float%s weight>
+            {
+                x0 = Conv<kernel_shape=[3, 3], pads=[1, 1, 1, 1]>(input, filter0)
+                x1 = Relu(x0)
+                x2 = Conv<kernel_shape=[1, 1]>(input, filter1)
+                output0 = Add(x1, x2)
+                output1 = Conv<kernel_shape=[5, 5], pads=[2, 2, 2, 2]>(input, filter2)
+                output2 = MatMul(input, weight)
+                output3 = MaxPool<kernel_shape=[2, 2], strides=[2, 2]>(input)
+            }
+            """ % (case_name, in_shape, *weights.values())
+        graph_def = onnx.parser.parse_graph(graph_txt)
+        for name, shape in weights.items():
+            data = np.random.randn(*shape).astype(np.float32)
+            graph_def.initializer.extend([helper.make_tensor(name, TensorProto.FLOAT, shape, data)])
+        input_data = self.create_random_input(graph_def)
+        self.onnx_convert(input_data, graph_def, case_name, [])
+        # every tensor of the parallel invokes must hold the same bytes as
+        # the sequential one
+        import pymlir
+        pymlir.set_mem_mode("value_mem")
+        results = []
+        for workers in [0, 4]:
+            module = pymlir.module()
+            module.set_parallel_workers(workers)
+            module.load("{}.mlir".format(case_name))
+            module.set_tensor(module.input_names[0], input_data["input"])
+            for _ in range(3):
+                module.invoke()
+                results.append({
+                    name: module.get_tensor(name).tobytes()
+                    for name in module.all_tensor_names
+                })
+        for tensors in results[1:]:
+            for name, data in results[0].items():
+                if tensors[name] != data:
+                    raise RuntimeError("{} differs from the sequential invoke".format(name))
+        print("Success: parallel and sequential invokes are equal\n")
+
     def test_DepthToSpace(self, case_name):
         in_shape = [1, 32, 108, 192]
         n, c, h, w = in_shape
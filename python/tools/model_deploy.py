@@ -109,6 +109,7 @@ class DeployTool:
         self.skip_validation = args.skip_validation
         self.model_version = args.model_version
         self.addr_mode = args.addr_mode
+        self.weight_pack = args.weight_pack
         self.cuda = args.cuda
         self.q_group_size = args.q_group_size if self.quantize in ["w4f16", "w4bf16"] else 0
         if self.quantize == "int8" or self.quantize == "int4":
@@ -159,6 +160,7 @@ class DeployTool:
                                      self.q_group_size,
                                      True if self.patterns_count else False,
                                      addr_mode=self.addr_mode,
+                                     weight_pack=self.weight_pack,
                                      mute=self.mute)
             if self.do_validate and self.cache_tool.do_tpu_validate(
                     self.tpu_mlir, self.tpu_npz, self.tolerance, self.embed_debug_info):
@@ -384,6 +386,9 @@ if __name__ == '__main__':
     parser.add_argument("--addr_mode", default="auto", type=str.lower,
                         choices=['auto', 'basic', 'io_alone', 'io_tag', 'io_tag_fuse'],
                         help="set address assign mode, if not set, auto as default")
+    parser.add_argument("--weight_pack", action='store_true',
+                        help="keep tpu weights in a mapped weight pack (.mlirw), later passes "
+                        "append to it instead of rewriting all weights")
     # ========== Debug Options ==============
     parser.add_argument("--debug", action='store_true', help='to keep all intermediate files for debug')
     parser.add_argument("--disable_layer_group", action="store_true", help="Whether to enable layer group pass")
@@ -99,6 +99,7 @@ def mlir_lowering(top_mlir: str,
                   q_group_size: int = 0,
                   count_patterns: bool = False,
                   addr_mode: str = "auto",
+                  weight_pack: bool = False,
                   mute: bool = False):
     cmd = [
         "tpuc-opt", top_mlir,
@@ -118,10 +119,17 @@ def mlir_lowering(top_mlir: str,
             mode, customization_format, aligned_input)
         cmd.extend([fuse_pre_param])
     qtable = ""
+    # later passes save in the format of their input weights, a pack is
+    # appended to instead of rewritten
+    weight_ext = ".mlirw" if weight_pack else ".npz"
     if quantize_table:
         assert (tpu_mlir.endswith(".mlir"))
-        weight_name = tpu_mlir[:-len(".mlir")] + "_qtable_weights.npz"
+        weight_name = tpu_mlir[:-len(".mlir")] + "_qtable_weights" + weight_ext
         qtable = "qtable={} weightFileName={}".format(quantize_table, weight_name)
+    elif weight_pack:
+        assert (tpu_mlir.endswith(".mlir"))
+        weight_name = tpu_mlir[:-len(".mlir")] + "_weights" + weight_ext
+        qtable = "weightFileName={}".format(weight_name)
     lower_param = "--convert-top-to-tpu=\"mode={} {} asymmetric={} doWinograd={} ignore_f16_overflow={} q_group_size={}\"".format(
         mode, qtable, asymmetric, do_winograd, ignore_f16_overflow, q_group_size)
     cmd.extend([
@@ -623,6 +623,139 @@ void npz_save_all(std::string zipname, npz_t &map) {
     }
 }
 
+npz_stream::npz_stream(std::string zipname) : offset(0), nrecs(0) {
+    fp = fopen(zipname.c_str(),"wb");
+    if(!fp)
+        throw std::runtime_error("npz_stream: unable to open " + zipname);
+}
+
+npz_stream::~npz_stream() { close(); }
+
+template<typename T>
+void npz_stream::add(std::string fname, const T* data,
+        const std::vector<size_t>& shape) {
+    assert(fp);
+    fname += ".npy";
+    std::vector<char> npy_header =
+        create_npy_header(shape, sizeof(T), mapType<T>::value);
+    size_t nels = std::accumulate(shape.begin(),shape.end(),(size_t)1,
+                                  std::multiplies<size_t>());
+    size_t nbytes = nels*sizeof(T) + npy_header.size();
+    if (nbytes > max_entry_bytes)
+        throw std::runtime_error("npz_stream: " + fname +
+                                 " is 4GiB or more, not supported");
+
+    uint32_t crc = crc32(0L,(uint8_t*)&npy_header[0],npy_header.size());
+    crc = crc32(crc,(const uint8_t*)data,nels*sizeof(T));
+
+    //local header, same as npz_save
+    std::vector<char> local_header;
+    local_header += "PK"; //first part of sig
+    local_header += (uint16_t) 0x0403; //second part of sig
+    local_header += (uint16_t) 20; //min version to extract
+    local_header += (uint16_t) 0; //general purpose bit flag
+    local_header += (uint16_t) 0; //compression method
+    local_header += (uint16_t) 0; //file last mod time
+    local_header += (uint16_t) 0;     //file last mod date
+    local_header += (uint32_t) crc; //crc
+    local_header += (uint32_t) nbytes; //compressed size
+    local_header += (uint32_t) nbytes; //uncompressed size
+    local_header += (uint16_t) fname.size(); //fname length
+    local_header += (uint16_t) 0; //extra field length
+    local_header += fname;
+
+    fwrite(&local_header[0],sizeof(char),local_header.size(),fp);
+    fwrite(&npy_header[0],sizeof(char),npy_header.size(),fp);
+    fwrite(data,sizeof(T),nels,fp);
+
+    //central directory entry, with a ZIP64 extra field once the offset no
+    //longer fits, as npz_save does
+    global_header += "PK"; //first part of sig
+    global_header += (uint16_t) 0x0201; //second part of sig
+    if (offset >= ZIP64_LIMIT) {
+      global_header += (uint8_t) 45; //create_version
+      global_header += (uint8_t) 3; //zinfo.create_system
+      global_header += (uint8_t) 45; //extract_version
+      global_header += (uint8_t) 0; //zinfo.reserved
+      global_header.insert(global_header.end(),local_header.begin()+6,
+                           local_header.begin()+28);
+      global_header += (uint16_t) 12; //extran data length
+    } else {
+      global_header += (uint16_t) 20; //version made by
+      global_header.insert(global_header.end(),local_header.begin()+4,
+                           local_header.begin()+30);
+    }
+    global_header += (uint16_t) 0; //file comment length
+    global_header += (uint16_t) 0; //disk number where file starts
+    global_header += (uint16_t) 0; //internal file attributes
+    global_header += (uint32_t) 0; //external file attributes
+    global_header += (offset >= ZIP64_LIMIT) ?
+                     (uint32_t) 0xFFFFFFFF : (uint32_t) offset;
+    global_header += fname;
+    if (offset >= ZIP64_LIMIT) {
+      global_header += (uint16_t) 0x01;
+      global_header += (uint16_t) 0x08;
+      global_header += (uint64_t) offset;
+    }
+
+    offset += local_header.size() + nbytes;
+    nrecs++;
+}
+
+template void npz_stream::add<float>(std::string, const float*,
+        const std::vector<size_t>&);
+template void npz_stream::add<int8_t>(std::string, const int8_t*,
+        const std::vector<size_t>&);
+template void npz_stream::add<uint8_t>(std::string, const uint8_t*,
+        const std::vector<size_t>&);
+template void npz_stream::add<int32_t>(std::string, const int32_t*,
+        const std::vector<size_t>&);
+
+void npz_stream::close() {
+    if (!fp)
+        return;
+    fwrite(global_header.data(),sizeof(char),global_header.size(),fp);
+    bool zip64 = offset >= ZIP64_LIMIT || nrecs >= 0xFFFF;
+    if (zip64) {
+      //zip64 end of central directory record, read by parse_zip_footer
+      std::vector<char> zip64endrec_header;
+      zip64endrec_header += "PK";
+      zip64endrec_header += (uint16_t) 0x0606;
+      zip64endrec_header += (uint64_t) 44; //size of the rest of the record
+      zip64endrec_header += (uint16_t) 45; //version made by
+      zip64endrec_header += (uint16_t) 45; //version needed
+      zip64endrec_header += (uint32_t) 0x0;
+      zip64endrec_header += (uint32_t) 0x0;
+      zip64endrec_header += (uint64_t) nrecs; //centDirCount
+      zip64endrec_header += (uint64_t) nrecs; //centDirCount
+      zip64endrec_header += (uint64_t) global_header.size(); //centDirSize
+      zip64endrec_header += (uint64_t) offset; //centDirOffset
+      fwrite(&zip64endrec_header[0],sizeof(char),zip64endrec_header.size(),fp);
+
+      std::vector<char> zip64locrec_header;
+      zip64locrec_header += "PK";
+      zip64locrec_header += (uint16_t) 0x0706;
+      zip64locrec_header += (uint32_t) 0x0;
+      zip64locrec_header += (uint64_t) (offset + global_header.size());
+      zip64locrec_header += (uint32_t) 0x1;
+      fwrite(&zip64locrec_header[0],sizeof(char),zip64locrec_header.size(),fp);
+    }
+    std::vector<char> footer;
+    footer += "PK"; //first part of sig
+    footer += (uint16_t) 0x0605; //second part of sig
+    footer += (uint16_t) 0; //number of this disk
+    footer += (uint16_t) 0; //disk where footer starts
+    footer += zip64 ? (uint16_t) 0xFFFF : (uint16_t) nrecs;
+    footer += zip64 ? (uint16_t) 0xFFFF : (uint16_t) nrecs;
+    footer += (uint32_t) global_header.size(); //nbytes of global headers
+    footer += zip64 ? (uint32_t) 0xFFFFFFFF : (uint32_t) offset;
+    footer += (uint16_t) 0; //zip file comment length
+    fwrite(&footer[0],sizeof(char),footer.size(),fp);
+    fclose(fp);
+    fp = NULL;
+    global_header.clear();
+}
+
 static NpyArray load_the_npy_file(FILE* fp) {
     std::vector<size_t> shape;
     size_t word_size;
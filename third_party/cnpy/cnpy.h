@@ -115,6 +115,30 @@ void npz_clone_array(npz_t &map, std::string fname, std::string new_name);
 
 void npz_save_all(std::string zipname, npz_t &map);
 
+// writes arrays one after another into a new npz, keeping the central
+// directory in memory until close(). npz_save(..., "a") instead rereads and
+// rewrites the directory for every array.
+class npz_stream {
+public:
+    npz_stream(std::string zipname);
+    ~npz_stream();
+
+    // local headers hold 32-bit sizes, larger arrays (with their npy
+    // header) are refused rather than written as zip64 entries
+    static constexpr size_t max_entry_bytes = 0xFFFFFFFE;
+
+    template<typename T>
+    void add(std::string fname, const T* data,
+            const std::vector<size_t>& shape);
+    void close();
+
+private:
+    FILE* fp;
+    size_t offset;
+    size_t nrecs;
+    std::vector<char> global_header;
+};
+
 } // namespace cnpy
 
 #endif
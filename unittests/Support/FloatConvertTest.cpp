@@ -0,0 +1,118 @@
+//===----------------------------------------------------------------------===//
+//
+// Copyright (C) 2022 Sophgo Technologies Inc.  All rights reserved.
+//
+// TPU-MLIR is licensed under the 2-Clause BSD License except for the
+// third-party components.
+//
+//===----------------------------------------------------------------------===//
+
+#include "tpu_mlir/Support/FloatConvert.h"
+#include "gtest/gtest.h"
+#include <cstring>
+#include <random>
+
+using namespace tpu_mlir;
+
+static const RoundingMode round_modes[] = {
+    ROUNDING_HALF_AWAY_FROM_ZERO, ROUNDING_HALF_UP,
+    ROUNDING_HALF_DOWN,           ROUNDING_HALF_TO_EVEN,
+    ROUNDING_HALF_TO_ODD,         ROUNDING_HALF_TOWARDS_ZERO,
+    ROUNDING_TOWARDS_ZERO,        ROUNDING_AWAY_FROM_ZERO,
+    ROUNDING_UP,                  ROUNDING_DOWN};
+
+static uint32_t to_bits(float v) {
+  uint32_t bits;
+  memcpy(&bits, &v, sizeof(bits));
+  return bits;
+}
+
+// random bit patterns, with every exponent and the rounding boundaries
+static std::vector<float> test_data(int num) {
+  std::mt19937 gen(0);
+  std::vector<float> data(num);
+  for (int i = 0; i < num; i++) {
+    uint32_t bits = gen();
+    switch (i % 4) {
+    case 1: // ties and neighbours of ties for f16/bf16/f8
+      bits = (bits & ~0xfffffu) | ((0x1000u << (gen() % 9)) + (gen() % 3) - 1);
+      break;
+    case 2: // zero, denormal and inf/nan exponents
+      bits = (bits & 0x807fffffu) | ((gen() % 2 ? 0xffu : 0u) << 23);
+      break;
+    }
+    memcpy(&data[i], &bits, sizeof(bits));
+  }
+  return data;
+}
+
+TEST(FloatConvert, MatchScalar) {
+  const int num = 1 << 16;
+  auto src = test_data(num);
+  std::vector<float> dst(num);
+  for (int isa = CONVERT_GENERIC; isa <= supported_convert_isa(); isa++) {
+    set_convert_isa((ConvertISA)isa);
+    for (auto mode : round_modes) {
+      F16(src.data(), dst.data(), num, mode);
+      for (int i = 0; i < num; i++) {
+        ASSERT_EQ(to_bits(dst[i]), to_bits(F16(src[i], mode)))
+            << "F16 isa " << isa << " mode " << mode << " src " << std::hex
+            << to_bits(src[i]);
+      }
+      BF16(src.data(), dst.data(), num, mode);
+      for (int i = 0; i < num; i++) {
+        ASSERT_EQ(to_bits(dst[i]), to_bits(BF16(src[i], mode)))
+            << "BF16 isa " << isa << " mode " << mode << " src " << std::hex
+            << to_bits(src[i]);
+      }
+      for (bool satu : {false, true}) {
+        F8E4M3(src.data(), dst.data(), num, 0.5f, satu, mode);
+        for (int i = 0; i < num; i++) {
+          ASSERT_EQ(to_bits(dst[i]), to_bits(F8E4M3(src[i], 0.5f, satu, mode)))
+              << "F8E4M3 isa " << isa << " mode " << mode << " src "
+              << std::hex << to_bits(src[i]);
+        }
+        F8E5M2(src.data(), dst.data(), num, 1.0f, satu, mode);
+        for (int i = 0; i < num; i++) {
+          ASSERT_EQ(to_bits(dst[i]), to_bits(F8E5M2(src[i], 1.0f, satu, mode)))
+              << "F8E5M2 isa " << isa << " mode " << mode << " src "
+              << std::hex << to_bits(src[i]);
+        }
+      }
+    }
+  }
+  set_convert_isa(supported_convert_isa());
+}
+
+// entries of Float16.h and Float8.h against their per element versions
+TEST(FloatConvert, MatchLegacy) {
+  const int num = 1 << 16;
+  auto src = test_data(num);
+  std::vector<float> dst(num);
+  for (int isa = CONVERT_GENERIC; isa <= supported_convert_isa(); isa++) {
+    set_convert_isa((ConvertISA)isa);
+    F16(src.data(), dst.data(), num);
+    for (int i = 0; i < num; i++) {
+      ASSERT_EQ(to_bits(dst[i]), to_bits(F16(src[i])))
+          << "F16 isa " << isa << " src " << std::hex << to_bits(src[i]);
+    }
+    BF16(src.data(), dst.data(), num);
+    for (int i = 0; i < num; i++) {
+      ASSERT_EQ(to_bits(dst[i]), to_bits(BF16(src[i])))
+          << "BF16 isa " << isa << " src " << std::hex << to_bits(src[i]);
+    }
+    for (bool satu : {false, true}) {
+      F8E4M3(src.data(), dst.data(), num, 0.5f, satu);
+      for (int i = 0; i < num; i++) {
+        ASSERT_EQ(to_bits(dst[i]), to_bits(F8E4M3(src[i], 0.5f, satu)))
+            << "F8E4M3 isa " << isa << " src " << std::hex << to_bits(src[i]);
+      }
+      F8E5M2(src.data(), dst.data(), num, 1.0f, satu);
+      for (int i = 0; i < num; i++) {
+        ASSERT_EQ(to_bits(dst[i]), to_bits(F8E5M2(src[i], 1.0f, satu)))
+            << "F8E5M2 isa " << isa << " src " << std::hex << to_bits(src[i]);
+      }
+    }
+  }
+  set_convert_isa(supported_convert_isa());
+}
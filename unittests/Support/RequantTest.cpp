@@ -0,0 +1,101 @@
+//===----------------------------------------------------------------------===//
+//
+// Copyright (C) 2022 Sophgo Technologies Inc.  All rights reserved.
+//
+// TPU-MLIR is licensed under the 2-Clause BSD License except for the
+// third-party components.
+//
+//===----------------------------------------------------------------------===//
+
+#include "tpu_mlir/Support/MathUtils.h"
+#include "gtest/gtest.h"
+#include <random>
+
+using namespace tpu_mlir;
+
+// get_requant_kernel against the scalar applyMultiplierAndRShift and
+// MultiplyByQuantizedMultiplier, which stay the reference.
+TEST(Requant, MatchScalar) {
+  mlir::MLIRContext ctx;
+  auto si = mlir::IntegerType::Signed;
+  auto ui = mlir::IntegerType::Unsigned;
+  std::vector<mlir::Type> types = {
+      mlir::IntegerType::get(&ctx, 8, si), mlir::IntegerType::get(&ctx, 8, ui),
+      mlir::IntegerType::get(&ctx, 16, si), mlir::IntegerType::get(&ctx, 4),
+      mlir::IntegerType::get(&ctx, 32, si)};
+  std::vector<tpu::RequantMode> qmodes = {
+      tpu::RequantMode::MultiplierShift, tpu::RequantMode::OnlyShift,
+      tpu::RequantMode::QDM, tpu::RequantMode::TFLite,
+      tpu::RequantMode::TFLite_LShift};
+  std::vector<RoundingMode> rmodes = {
+      ROUNDING_HALF_AWAY_FROM_ZERO, ROUNDING_HALF_UP,    ROUNDING_HALF_DOWN,
+      ROUNDING_HALF_TO_EVEN,        ROUNDING_TOWARDS_ZERO, ROUNDING_UP,
+      ROUNDING_DOWN};
+
+  std::mt19937 gen(0);
+  const int len = 257;
+  std::vector<float> src(len), dst(len);
+  std::uniform_int_distribution<int> value(-(1 << 20), 1 << 20);
+  for (auto &v : src) {
+    v = value(gen);
+  }
+
+  for (auto qmode : qmodes) {
+    bool is_tf = qmode != tpu::RequantMode::MultiplierShift &&
+                 qmode != tpu::RequantMode::OnlyShift;
+    std::uniform_int_distribution<int64_t> multiplier(
+        0, is_tf ? (1ll << 31) - 1 : 1 << 15);
+    std::uniform_int_distribution<int> shift(is_tf ? -40 : -4,
+                                             is_tf ? 8 : 40);
+    for (auto rmode : rmodes) {
+      for (auto type : types) {
+        for (bool do_relu : {false, true}) {
+          int64_t multi = multiplier(gen);
+          int64_t rshift = shift(gen);
+          int64_t in_zp = value(gen) % 128;
+          int64_t out_zp = value(gen) % 8;
+          auto requant =
+              get_requant_kernel(qmode, rmode, type, do_relu, out_zp);
+          requant(src.data(), dst.data(), len, -(float)in_zp, multi, rshift,
+                  out_zp);
+          for (int i = 0; i < len; i++) {
+            int64_t x = src[i] - in_zp;
+            int64_t v = applyMultiplierAndRShift(x, multi, rshift, qmode,
+                                                 rmode) +
+                        out_zp;
+            if (do_relu && v < out_zp) {
+              v = out_zp;
+            }
+            ASSERT_EQ(dst[i], (float)saturate(v, type))
+                << "qmode " << (int)qmode << " rmode " << (int)rmode
+                << " multi " << multi << " shift " << rshift << " x " << x;
+          }
+        }
+      }
+    }
+  }
+}
+
+// s32 sums of the integer conv/matmul path, beyond the ints exact in f32
+TEST(Requant, Int32Source) {
+  mlir::MLIRContext ctx;
+  auto type = mlir::IntegerType::get(&ctx, 8, mlir::IntegerType::Signed);
+  std::mt19937 gen(0);
+  const int len = 257;
+  std::vector<int32_t> src(len);
+  std::vector<float> dst(len);
+  std::uniform_int_distribution<int32_t> value(-(1 << 30), 1 << 30);
+  for (auto &v : src) {
+    v = value(gen);
+  }
+  int32_t bias = 12345;
+  int64_t multi = 19, rshift = 28, out_zp = 3;
+  auto requant = get_requant_kernel(tpu::RequantMode::MultiplierShift,
+                                    ROUNDING_HALF_UP, type, false, out_zp);
+  requant(src.data(), dst.data(), len, bias, multi, rshift, out_zp);
+  for (int i = 0; i < len; i++) {
+    int64_t x = (int64_t)src[i] + bias;
+    int64_t v = applyMultiplierAndRShift(x, multi, rshift) + out_zp;
+    ASSERT_EQ(dst[i], (float)saturate(v, type)) << "x " << x;
+  }
+}
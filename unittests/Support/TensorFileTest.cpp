@@ -0,0 +1,286 @@
+//===----------------------------------------------------------------------===//
+//
+// Copyright (C) 2022 Sophgo Technologies Inc.  All rights reserved.
+//
+// TPU-MLIR is licensed under the 2-Clause BSD License except for the
+// third-party components.
+//
+//===----------------------------------------------------------------------===//
+
+#include "tpu_mlir/Support/TensorFile.h"
+#include "llvm/Support/FileSystem.h"
+#include "gtest/gtest.h"
+#include <fstream>
+
+using namespace mlir;
+
+static std::string temp_file(const char *suffix) {
+  llvm::SmallString<128> path;
+  auto ec = llvm::sys::fs::createTemporaryFile("tensor_file", suffix, path);
+  EXPECT_FALSE(ec);
+  return path.str().str();
+}
+
+TEST(TensorFile, WeightPack) {
+  auto pack = temp_file("mlirw");
+  auto npz = temp_file("npz");
+  auto back = temp_file("mlirw");
+  // large enough to be mapped
+  std::vector<float> a(8192);
+  for (size_t i = 0; i < a.size(); i++) {
+    a[i] = i * 0.5f;
+  }
+  std::vector<float> b = {-1.f, 0.5f, 7.f};
+  std::vector<int64_t> a_shape = {64, 128}, b_shape = {3};
+  {
+    TensorFile file(pack, false, true);
+    ASSERT_TRUE(succeeded(file.addTensor("a", a.data(), a_shape)));
+    ASSERT_TRUE(succeeded(file.addTensor("b", b.data(), b_shape)));
+    file.save();
+  }
+  auto check = [&](const std::string &filename) {
+    TensorFile file(filename, true);
+    std::vector<float> out(a.size());
+    ASSERT_TRUE(succeeded(
+        file.readTensor("a", out.data(), out.size(), false, false)));
+    EXPECT_EQ(out, a);
+    out.resize(b.size());
+    ASSERT_TRUE(succeeded(
+        file.readTensor("b", out.data(), out.size(), false, false)));
+    EXPECT_EQ(out, b);
+  };
+  check(pack);
+  {
+    TensorFile file(pack, true);
+    auto view = file.view("a");
+    ASSERT_EQ(view.size(), a.size() * sizeof(float));
+    EXPECT_EQ((uintptr_t)view.data() % TensorFile::packAlignment, 0u);
+    EXPECT_EQ(memcmp(view.data(), a.data(), view.size()), 0);
+  }
+  ASSERT_TRUE(succeeded(TensorFile::convert(pack, npz)));
+  check(npz);
+  ASSERT_TRUE(succeeded(TensorFile::convert(npz, back)));
+  check(back);
+  {
+    // appends to the file it maps
+    TensorFile file(back, false);
+    std::vector<float> c = {9.f, 8.f, 7.f};
+    ASSERT_TRUE(succeeded(file.updateTensorData("b", c.data(), c.size())));
+    file.save();
+    b = c;
+  }
+  check(back);
+  llvm::sys::fs::remove(pack);
+  llvm::sys::fs::remove(npz);
+  llvm::sys::fs::remove(back);
+}
+
+TEST(TensorFile, WeightPackAppend) {
+  auto pack = temp_file("mlirw");
+  auto copy = temp_file("mlirw");
+  std::vector<float> a(8192, 1.f), b(8192, 2.f), c = {3.f};
+  std::vector<int64_t> shape = {8192}, c_shape = {1};
+  auto file_size = [](const std::string &filename) {
+    uint64_t size = 0;
+    EXPECT_FALSE(llvm::sys::fs::file_size(filename, size));
+    return size;
+  };
+  {
+    TensorFile file(pack, false, true);
+    ASSERT_TRUE(succeeded(file.addTensor("a", a.data(), shape)));
+    ASSERT_TRUE(succeeded(file.addTensor("b", b.data(), shape)));
+    file.save();
+  }
+  auto size = file_size(pack);
+  {
+    // c and the new index go to the end, a and b stay where they are
+    TensorFile file(pack, false);
+    auto view = file.view("a");
+    ASSERT_TRUE(succeeded(file.addTensor("c", c.data(), c_shape)));
+    file.save();
+    EXPECT_GT(file_size(pack), size);
+    EXPECT_EQ(memcmp(file.view("a").data(), a.data(), view.size()), 0);
+    size = file_size(pack);
+    // to another name, a copy of the pack is appended to
+    ASSERT_TRUE(succeeded(file.deleteTensor("c")));
+    file.save(copy);
+    EXPECT_EQ(file_size(pack), size);
+    EXPECT_GT(file_size(copy), size);
+  }
+  {
+    TensorFile file(copy, true);
+    std::set<llvm::StringRef> names;
+    file.getAllNames(names);
+    EXPECT_EQ(names, (std::set<llvm::StringRef>{"a", "b"}));
+    std::vector<float> out(b.size());
+    ASSERT_TRUE(succeeded(
+        file.readTensor("b", out.data(), out.size(), false, false)));
+    EXPECT_EQ(out, b);
+  }
+  {
+    // b is half of the pack, compacted once its replacements pile up
+    TensorFile file(pack, false);
+    for (int i = 0; i < 3; i++) {
+      b.assign(b.size(), 4.f + i);
+      ASSERT_TRUE(succeeded(file.updateTensorData("b", b.data(), b.size())));
+      file.save();
+    }
+    EXPECT_LT(file_size(pack), size + 2 * b.size() * sizeof(float));
+  }
+  {
+    TensorFile file(pack, true);
+    std::vector<float> out(b.size());
+    ASSERT_TRUE(succeeded(
+        file.readTensor("b", out.data(), out.size(), false, false)));
+    EXPECT_EQ(out, b);
+  }
+  llvm::sys::fs::remove(pack);
+  llvm::sys::fs::remove(copy);
+}
+
+TEST(TensorFile, WeightPackReplaced) {
+  auto pack = temp_file("mlirw");
+  auto other = temp_file("mlirw");
+  std::vector<float> a(8192, 1.f), b(8192, 2.f), c = {3.f};
+  std::vector<int64_t> shape = {8192}, c_shape = {1};
+  for (auto &it : {std::make_pair(pack, &a), std::make_pair(other, &b)}) {
+    TensorFile file(it.first, false, true);
+    ASSERT_TRUE(succeeded(file.addTensor("a", it.second->data(), shape)));
+    file.save();
+  }
+  {
+    TensorFile file(pack, false);
+    // replaced by a pack of the same size while mapped
+    ASSERT_FALSE(llvm::sys::fs::rename(other, pack));
+    ASSERT_TRUE(succeeded(file.addTensor("c", c.data(), c_shape)));
+    file.save();
+  }
+  // rewritten from what was mapped, not appended to the other pack
+  TensorFile file(pack, true);
+  std::vector<float> out(a.size());
+  ASSERT_TRUE(succeeded(
+      file.readTensor("a", out.data(), out.size(), false, false)));
+  EXPECT_EQ(out, a);
+  out.resize(c.size());
+  ASSERT_TRUE(succeeded(
+      file.readTensor("c", out.data(), out.size(), false, false)));
+  EXPECT_EQ(out, c);
+  llvm::sys::fs::remove(pack);
+}
+
+TEST(TensorFile, WeightPackDedup) {
+  auto pack = temp_file("mlirw");
+  std::vector<float> a(8192, 1.f), b(8192, 2.f);
+  std::vector<int64_t> shape = {8192}, shape_2d = {64, 128};
+  auto file_size = [](const std::string &filename) {
+    uint64_t size = 0;
+    EXPECT_FALSE(llvm::sys::fs::file_size(filename, size));
+    return size;
+  };
+  {
+    TensorFile file(pack, false, true);
+    ASSERT_TRUE(succeeded(file.addTensor("a", a.data(), shape)));
+    ASSERT_TRUE(succeeded(file.addTensor("a_copy", a.data(), shape_2d)));
+    ASSERT_TRUE(succeeded(file.cloneTensor("a", "clone")));
+    file.save();
+  }
+  // one copy of the data for the three of them
+  auto size = file_size(pack);
+  EXPECT_LT(size, 2 * a.size() * sizeof(float));
+  {
+    TensorFile file(pack, false);
+    EXPECT_EQ(file.view("a").data(), file.view("a_copy").data());
+    EXPECT_EQ(file.view("a").data(), file.view("a_clone").data());
+    // equal to what the pack has, only a name is appended
+    ASSERT_TRUE(succeeded(file.addTensor("a_again", a.data(), shape)));
+    ASSERT_TRUE(succeeded(file.addTensor("b", b.data(), shape)));
+    file.save();
+    EXPECT_EQ(file.view("a").data(), file.view("a_again").data());
+    EXPECT_LT(file_size(pack), size + 2 * a.size() * sizeof(float));
+    // the clone keeps its data
+    ASSERT_TRUE(succeeded(file.updateTensorData("a", b.data(), b.size())));
+    file.save();
+    EXPECT_EQ(file.view("a").data(), file.view("b").data());
+  }
+  {
+    TensorFile file(pack, true);
+    std::vector<float> out(a.size());
+    ASSERT_TRUE(succeeded(
+        file.readTensor("a_clone", out.data(), out.size(), false, false)));
+    EXPECT_EQ(out, a);
+    ASSERT_TRUE(succeeded(
+        file.readTensor("a", out.data(), out.size(), false, false)));
+    EXPECT_EQ(out, b);
+  }
+  llvm::sys::fs::remove(pack);
+}
+
+TEST(TensorFile, WeightPackV1) {
+  auto pack = temp_file("mlirw");
+  std::vector<float> a(8192, 1.f);
+  {
+    // one tensor, index entries without hash
+    std::ofstream f(pack, std::ios::binary);
+    uint64_t offset = TensorFile::packAlignment;
+    uint64_t num_bytes = a.size() * sizeof(float);
+    uint64_t index_offset = offset + num_bytes, dim = a.size();
+    uint32_t version = 1, num_tensors = 1, name_size = 1;
+    uint8_t type = 'f', word_size = sizeof(float);
+    uint16_t num_dims = 1;
+    f.write("TPUMLIRW", 8);
+    f.write((const char *)&version, sizeof(version));
+    f.write((const char *)&num_tensors, sizeof(num_tensors));
+    f.write((const char *)&index_offset, sizeof(index_offset));
+    std::string pad(offset - 24, '\0');
+    f.write(pad.data(), pad.size());
+    f.write((const char *)a.data(), num_bytes);
+    f.write((const char *)&name_size, sizeof(name_size));
+    f.write("a", 1);
+    f.write((const char *)&type, sizeof(type));
+    f.write((const char *)&word_size, sizeof(word_size));
+    f.write((const char *)&num_dims, sizeof(num_dims));
+    f.write((const char *)&dim, sizeof(dim));
+    f.write((const char *)&offset, sizeof(offset));
+    f.write((const char *)&num_bytes, sizeof(num_bytes));
+  }
+  {
+    TensorFile file(pack, false);
+    ASSERT_EQ(file.view("a").size(), a.size() * sizeof(float));
+    // still found equal once hashed
+    std::vector<int64_t> shape = {8192};
+    ASSERT_TRUE(succeeded(file.addTensor("a_again", a.data(), shape)));
+    file.save();
+    EXPECT_EQ(file.view("a").data(), file.view("a_again").data());
+  }
+  TensorFile file(pack, true);
+  std::vector<float> out(a.size());
+  ASSERT_TRUE(succeeded(
+      file.readTensor("a_again", out.data(), out.size(), false, false)));
+  EXPECT_EQ(out, a);
+  llvm::sys::fs::remove(pack);
+}
+
+TEST(TensorFile, LazyZip64) {
+  auto npz = temp_file("npz");
+  std::vector<float> a(8192, 1.f);
+  std::vector<int64_t> shape = {8192};
+  {
+    TensorFile file(npz, false, true);
+    ASSERT_TRUE(succeeded(file.addTensor("a", a.data(), shape)));
+    file.save();
+  }
+  {
+    // mark the sizes of the first entry as held in a zip64 extra field
+    std::fstream f(npz, std::ios::in | std::ios::out | std::ios::binary);
+    uint32_t zip64_size = 0xFFFFFFFF;
+    f.seekp(18);
+    f.write((const char *)&zip64_size, sizeof(zip64_size));
+    f.write((const char *)&zip64_size, sizeof(zip64_size));
+  }
+  TensorFile file(npz, false, false, true);
+  std::set<llvm::StringRef> names;
+  file.getAllNames(names);
+  EXPECT_TRUE(names.empty());
+  EXPECT_TRUE(file.view("a").empty());
+  llvm::sys::fs::remove(npz);
+}